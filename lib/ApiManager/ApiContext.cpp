@@ -11,7 +11,7 @@ void sendCorsHeaders() {
 
   api.sendHeader("Access-Control-Allow-Origin", "*");
   api.sendHeader("Access-Control-Allow-Methods",
-                 "GET, POST, PATCH, DELETE, OPTIONS");
+                 "GET, POST, PUT, PATCH, DELETE, OPTIONS");
   api.sendHeader("Access-Control-Allow-Headers",
                  "Content-Type, X-Nonce, X-Auth");
 }
@@ -30,19 +30,21 @@ void sendError(const char *msg, int code) {
   sendJSON(doc, code);
 }
 
-bool checkAuth(const JsonDocument &doc) {
+bool authorizeRequest(const char *payload) {
   if (!getAuthEnabled())
     return true; // Authentication disabled
 
-  if (!api.hasHeader("X-Nonce") || !api.hasHeader("X-Auth")) {
-    sendError("unauthorized", 401);
+  if (!api.hasHeader("X-Nonce") || !api.hasHeader("X-Auth"))
     return false;
-  }
 
   IPAddress ip = api.client().remoteIP();
   uint32_t nonce = api.header("X-Nonce").toInt();
-  const char *sig = api.header("X-Auth").c_str();
+  String sig = api.header("X-Auth");
 
+  return authVerify(ip, nonce, api.uri().c_str(), payload, sig.c_str());
+}
+
+bool checkAuth(const JsonDocument &doc) {
   String payload;
 
   // serializza solo se il JSON NON è vuoto
@@ -52,7 +54,7 @@ bool checkAuth(const JsonDocument &doc) {
     payload = ""; // GET / body assente
   }
 
-  if (!authVerify(ip, nonce, api.uri().c_str(), payload.c_str(), sig)) {
+  if (!authorizeRequest(payload.c_str())) {
     sendError("unauthorized", 401);
     return false;
   }
@@ -46,6 +46,17 @@ void sendJSON(JsonDocument &doc, int statusCode);
  */
 void sendError(const char *msg, int code = 400);
 
+/**
+ * @brief Verifies API authentication without sending a response.
+ *
+ * Same checks as checkAuth(), for handlers that cannot answer yet, e.g.
+ * while a request body is still being received. The nonce is consumed.
+ *
+ * @param payload Signed request payload ("" for none)
+ * @return true if authentication is disabled or the request is authorized
+ */
+bool authorizeRequest(const char *payload);
+
 /**
  * @brief Verifies API authentication for the current request.
  *
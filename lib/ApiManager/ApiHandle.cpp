@@ -1,11 +1,31 @@
 #include "ApiHandle.h"
 #include "ApiContext.h"
+#include "ApiManager.h"
+#include <AtScheduler.h>
 #include <Auth.h>
+#include <BinaryStorage.h>
+#include <Clock.h>
+#include <CronLog.h>
 #include <CronScheduler.h>
 #include <Crypto.h>
 #include <Debug.h>
 #include <DeviceController.h>
-#include <EepromConfig.h>
+#include <Discovery.h>
+#include <HttpQueue.h>
+#include <KvStore.h>
+#include <LinkMonitor.h>
+#include <PowerManager.h>
+#include <Snapshot.h>
+#include <Solar.h>
+#include <WifiManager.h>
+
+/* Page size of the GET /api/cron listing (each job is read from flash) */
+#define CRON_LIST_DEFAULT_LIMIT 16
+#define CRON_LIST_MAX_LIMIT 32
+
+/* Number of fire times returned by GET /api/cron/preview */
+#define CRON_PREVIEW_DEFAULT_N 10
+#define CRON_PREVIEW_MAX_N 50
 
 void handleAuthChallenge() {
   ESP8266WebServer &api = apiServer();
@@ -50,9 +70,9 @@ void handleSetup() {
   bool authFlag = obj["auth"].as<bool>();
   bool debugFlag = obj["serialDebug"].as<bool>();
 
-  // Persist flags
-  setSerialDebugFlag(debugFlag);
-  debugSetEnabled(debugFlag);
+  // Persist flags (and the new key) with a single config store commit
+  kvBegin();
+  debugSaveEnabled(debugFlag);
   authFlag ? enableAuth() : disableAuth();
 
   JsonDocument resp;
@@ -68,6 +88,11 @@ void handleSetup() {
     resp["authKey"] = hex;
   }
 
+  if (!kvCommit()) {
+    sendError("storage error", 500);
+    return;
+  }
+
   sendJSON(resp, 200);
 }
 
@@ -80,24 +105,44 @@ void handleGetState() {
 
   JsonObject device = doc["device"].to<JsonObject>();
   device["device"] = "ESP8266";
+  device["firmware"] = FIRMWARE_VERSION;
+  device["hostname"] = discoveryHostname();
+  device["stateVersion"] = discoveryStateVersion();
   device["ip"] = WiFi.localIP().toString();
   device["chip"] = ESP.getChipId();
   device["rssi"] = WiFi.RSSI();
   device["auth"] = getAuthEnabled();
   device["serialDebug"] = debugEnabled();
   device["uptime"] = millis() / 1000;
-
-  // Cron jobs
-  CronJob *cronJobs = cronGetAll();
-  JsonObject crons = doc["cronJobs"].to<JsonObject>();
-  for (int i = 0; i < MAX_CRON_JOBS; i++) {
-    JsonObject cron = crons[String(i)].to<JsonObject>();
-    cron["state"] = cronJobs[i].active ? "Active" : "Disabled";
-    cron["cron"] = cronJobs[i].cron;
-    cron["action"] = cronActionToString(cronJobs[i].action);
-    cron["pin"] = gpioApiKey(cronJobs[i].pin);
-    cron["value"] = cronJobs[i].value;
-  }
+  device["apiReadyMs"] = apiReadyMs();
+
+  // Output restore at the last boot (RTC mirror or flash)
+  const DeviceBootInfo &boot = deviceBootInfo();
+  device["outputsFrom"] = boot.fromRtc ? "rtc" : "flash";
+  device["outputsRestoredUs"] = boot.restoredUs;
+
+  // Cron summary (jobs are listed by GET /api/cron)
+  JsonObject crons = doc["cron"].to<JsonObject>();
+  crons["slots"] = MAX_CRON_JOBS;
+  crons["active"] = cronActiveCount();
+
+  // Deferred flash writes: flushes performed vs. merged
+  const StorageDeferStats &st = storageDeferStats();
+  JsonObject storage = doc["storage"].to<JsonObject>();
+  storage["requested"] = st.requested;
+  storage["writes"] = st.written;
+  storage["avoided"] = st.avoided;
+  storage["failed"] = st.failed;
+  storage["pending"] = storagePending();
+
+  // Link health summary (details on GET /api/wifi/health)
+  const LinkStats &ls = linkStats();
+  JsonObject link = doc["link"].to<JsonObject>();
+  link["state"] = wifiStateToString(wifiState());
+  link["disconnects"] = ls.disconnects;
+  link["reconnects"] = ls.reconnects;
+  link["lastReconnectMs"] = ls.lastReconnectMs;
+  link["proactive"] = ls.proactive;
 
   // GPIO 0..16
   JsonObject pins = doc["pins"].to<JsonObject>();
@@ -111,6 +156,10 @@ void handleGetState() {
     p["mode"] = pinModeToString(pinStates[pin].mode);
     p["state"] = pinStates[pin].state;
 
+    uint32_t pulseLeft = devicePulseRemaining(pin);
+    if (pulseLeft > 0)
+      p["pulseRemaining"] = pulseLeft;
+
     JsonArray caps = p["capabilities"].to<JsonArray>();
     caps.add("Input");
 
@@ -363,6 +412,41 @@ void handlePatchPin() {
     newCfg.state = value;
   }
 
+  // Optional "duration": pulse the new state, then revert automatically
+  if (!obj["duration"].isNull()) {
+
+    uint32_t duration = obj["duration"] | 0UL;
+
+    if (obj["state"].isNull() || !obj["mode"].isNull()) {
+      sendError("duration requires state only");
+      return;
+    }
+
+    if (newCfg.mode != PinMode::Output && newCfg.mode != PinMode::Pwm) {
+      sendError("pin is not an output");
+      return;
+    }
+
+    if (duration == 0 || duration > PULSE_MAX_DURATION_MS) {
+      sendError("invalid duration");
+      return;
+    }
+
+    if (!devicePulse(pin, newCfg.state, duration)) {
+      sendError("pulse failed", 500);
+      return;
+    }
+
+    JsonDocument resp;
+    resp["id"] = id;
+    resp["mode"] = pinModeToString(newCfg.mode);
+    resp["state"] = newCfg.state;
+    resp["duration"] = duration;
+
+    sendJSON(resp, 200);
+    return;
+  }
+
   if (!deviceSet(newCfg)) {
     sendError("apply failed", 500);
     return;
@@ -388,11 +472,76 @@ void handleReboot() {
   sendJSON(doc, 200);
 
   debugPrintln(F("[API]"), F("Rebooting - /api/reboot"));
+  storageFlush();
   api.client().flush();
   delay(100);
   ESP.restart();
 }
 
+/**
+ * @brief Serializes a cron job definition.
+ */
+static void cronJobToJson(JsonObject out, const CronJob &job) {
+  out["state"] = job.active ? "Active" : "Disabled";
+  out["cron"] = job.cron;
+  out["action"] = cronActionToString(job.action);
+  out["pin"] = gpioApiKey(job.pin);
+  out["value"] = job.value;
+  out["misfire"] = cronMisfireToString(job.misfirePolicy);
+  out["misfireLimit"] = job.misfireLimit;
+  out["lastExec"] = job.lastExecEpoch;
+  if (job.action == HttpRequest) {
+    out["method"] = job.httpMethod == HttpPost ? "POST" : "GET";
+    out["url"] = job.url;
+  }
+  if (job.action == PulsePinState)
+    out["duration"] = job.pulseMs;
+}
+
+/**
+ * @brief Lists active jobs starting at slot `offset`, one page at a time.
+ */
+static void sendCronList() {
+  ESP8266WebServer &api = apiServer();
+
+  int offset = api.hasArg("offset") ? api.arg("offset").toInt() : 0;
+  int limit = api.hasArg("limit") ? api.arg("limit").toInt()
+                                  : CRON_LIST_DEFAULT_LIMIT;
+
+  if (offset < 0 || limit < 1 || limit > CRON_LIST_MAX_LIMIT) {
+    sendError("invalid offset or limit");
+    return;
+  }
+
+  JsonDocument doc;
+  doc["total"] = cronActiveCount();
+  JsonArray jobs = doc["jobs"].to<JsonArray>();
+
+  int i = offset;
+  for (; i < MAX_CRON_JOBS && (int)jobs.size() < limit; i++) {
+    if (!cronIsActive(i))
+      continue;
+
+    CronJob job;
+    if (!cronGet(i, job)) {
+      sendError("read failed", 500);
+      return;
+    }
+
+    JsonObject item = jobs.add<JsonObject>();
+    item["id"] = i;
+    cronJobToJson(item, job);
+  }
+
+  // Cursor for the next page (absent on the last page)
+  while (i < MAX_CRON_JOBS && !cronIsActive(i))
+    i++;
+  if (i < MAX_CRON_JOBS)
+    doc["next"] = i;
+
+  sendJSON(doc, 200);
+}
+
 void handleGetCron() {
   ESP8266WebServer &api = apiServer();
 
@@ -400,24 +549,103 @@ void handleGetCron() {
     return;
 
   if (!api.hasArg("id")) {
-    sendError("missing id");
+    sendCronList();
     return;
   }
 
   int id = api.arg("id").toInt();
-  CronJob *job = cronGet(id);
-
-  if (!job) {
+  if (id < 0 || id >= MAX_CRON_JOBS) {
     sendError("invalid id");
     return;
   }
 
+  CronJob job;
+  if (!cronGet(id, job)) {
+    sendError("read failed", 500);
+    return;
+  }
+
+  JsonDocument doc;
+  cronJobToJson(doc.to<JsonObject>(), job);
+  sendJSON(doc, 200);
+}
+
+/**
+ * @brief Parses an unsigned decimal epoch (digits only, up to 2^32 - 1).
+ */
+static bool parseEpoch(const String &text, uint32_t &out) {
+  if (text.length() == 0 || text.length() > 10)
+    return false;
+
+  uint64_t value = 0;
+  for (unsigned int i = 0; i < text.length(); i++) {
+    if (!isDigit(text[i]))
+      return false;
+    value = value * 10 + (text[i] - '0');
+  }
+
+  if (value > UINT32_MAX)
+    return false;
+
+  out = (uint32_t)value;
+  return true;
+}
+
+void handleCronPreview() {
+  ESP8266WebServer &api = apiServer();
+
+  if (!checkAuth(JsonDocument()))
+    return;
+
+  if (!api.hasArg("expr")) {
+    sendError("missing expr");
+    return;
+  }
+
+  CronSchedule sched;
+  if (!cronCompile(api.arg("expr").c_str(), sched)) {
+    sendError("invalid cron");
+    return;
+  }
+
+  int n = api.hasArg("n") ? api.arg("n").toInt() : CRON_PREVIEW_DEFAULT_N;
+  if (n < 1 || n > CRON_PREVIEW_MAX_N) {
+    sendError("n range 1-50");
+    return;
+  }
+
+  // Start from "from" (epoch) or from the current time
+  uint32_t t = clockNow();
+  if (api.hasArg("from") && !parseEpoch(api.arg("from"), t)) {
+    sendError("invalid from");
+    return;
+  }
+
+  if (t == 0) {
+    sendError("clock not synchronized");
+    return;
+  }
+
   JsonDocument doc;
-  doc["state"] = job->active ? "Active" : "Disabled";
-  doc["cron"] = job->cron;
-  doc["action"] = cronActionToString(job->action);
-  doc["pin"] = gpioApiKey(job->pin);
-  doc["value"] = job->value;
+  doc["expr"] = api.arg("expr");
+  doc["tz"] = clockTimezone();
+  JsonArray fires = doc["fires"].to<JsonArray>();
+
+  for (int i = 0; i < n; i++) {
+    t = cronNextFire(sched, t);
+    if (t == 0)
+      break;
+
+    struct tm lt;
+    clockToLocal(t, lt);
+
+    char local[20];
+    strftime(local, sizeof(local), "%Y-%m-%d %H:%M", &lt);
+
+    JsonObject f = fires.add<JsonObject>();
+    f["epoch"] = t;
+    f["local"] = local;
+  }
 
   sendJSON(doc, 200);
 }
@@ -452,6 +680,23 @@ void handleCronSet() {
 
   strlcpy(job.cron, obj["cron"].as<const char *>(), sizeof(job.cron));
 
+  CronSchedule sched;
+  if (!cronCompile(job.cron, sched)) {
+    sendError("invalid cron");
+    return;
+  }
+
+  if (sched.solar != SolarNone && !solarHasLocation()) {
+    sendError("solar location not set");
+    return;
+  }
+
+  // "0 0 30 2 *" compiles but matches no date
+  if (!cronCanFire(sched)) {
+    sendError("cron never fires");
+    return;
+  }
+
   String action = obj["action"].as<String>();
   action.toLowerCase();
 
@@ -459,14 +704,19 @@ void handleCronSet() {
     job.action = SetPinState;
   } else if (action == "toggle") {
     job.action = TogglePinState;
+  } else if (action == "http") {
+    job.action = HttpRequest;
   } else if (action == "reboot") {
     job.action = Reboot;
+  } else if (action == "pulse") {
+    job.action = PulsePinState;
   } else {
     sendError("invalid action");
     return;
   }
 
-  if (job.action == SetPinState || job.action == TogglePinState) {
+  if (job.action == SetPinState || job.action == TogglePinState ||
+      job.action == PulsePinState) {
 
     if (obj["pin"].isNull()) {
       sendError("missing pin");
@@ -483,24 +733,127 @@ void handleCronSet() {
     job.value = obj["value"] | 0;
   }
 
+  if (job.action == PulsePinState) {
+
+    job.value = obj["value"] | 1;
+    job.pulseMs = obj["duration"] | 0UL;
+
+    if (job.pulseMs == 0 || job.pulseMs > PULSE_MAX_DURATION_MS) {
+      sendError("invalid duration");
+      return;
+    }
+  }
+
+  if (job.action == HttpRequest) {
+
+    if (obj["url"].isNull()) {
+      sendError("missing url");
+      return;
+    }
+
+    const char *url = obj["url"].as<const char *>();
+    if (strncmp(url, "http://", 7) != 0 || strlen(url) >= sizeof(job.url)) {
+      sendError("invalid url");
+      return;
+    }
+    strlcpy(job.url, url, sizeof(job.url));
+
+    String method = obj["method"] | "GET";
+    method.toUpperCase();
+
+    if (method == "GET") {
+      job.httpMethod = HttpGet;
+    } else if (method == "POST") {
+      job.httpMethod = HttpPost;
+    } else {
+      sendError("invalid method");
+      return;
+    }
+
+    job.value = obj["value"] | 0;
+  }
+
+  if (!obj["misfire"].isNull()) {
+    String misfire = obj["misfire"].as<String>();
+    misfire.toLowerCase();
+
+    if (misfire == "skip") {
+      job.misfirePolicy = MisfireSkip;
+    } else if (misfire == "once") {
+      job.misfirePolicy = MisfireRunOnce;
+    } else if (misfire == "all") {
+      job.misfirePolicy = MisfireRunAll;
+    } else {
+      sendError("invalid misfire");
+      return;
+    }
+  }
+
+  int misfireLimit = obj["misfireLimit"] | 0;
+  if (misfireLimit < 0 || misfireLimit > 255) {
+    sendError("misfireLimit range 0-255");
+    return;
+  }
+  job.misfireLimit = misfireLimit;
+
   // trova slot libero
-  for (int i = 0; i < MAX_CRON_JOBS; i++) {
-    CronJob *c = cronGet(i);
-    if (!c->active) {
-      if (!setCronJob(i, job)) {
-        sendError("save failed", 500);
-        return;
-      }
+  int slot = cronFindFreeSlot();
+  if (slot < 0) {
+    sendError("no free job slot");
+    return;
+  }
 
-      JsonDocument resp;
-      resp["success"] = true;
-      resp["id"] = i;
-      sendJSON(resp, 200);
+  if (!setCronJob(slot, job)) {
+    sendError("save failed", 500);
+    return;
+  }
+
+  JsonDocument resp;
+  resp["success"] = true;
+  resp["id"] = slot;
+  sendJSON(resp, 200);
+}
+
+void handleGetCronHistory() {
+  ESP8266WebServer &api = apiServer();
+
+  if (!checkAuth(JsonDocument()))
+    return;
+
+  int job = -1;
+  JsonDocument doc;
+
+  if (api.hasArg("id")) {
+    job = api.arg("id").toInt();
+    if (job < 0 || job >= MAX_CRON_JOBS) {
+      sendError("invalid id");
       return;
     }
+
+    const CronJobStats *st = cronLogJobStats(job);
+    doc["id"] = job;
+    doc["runs"] = st->runs;
+    doc["failures"] = st->failures;
+    doc["misses"] = st->misses;
+    doc["maxLatenessMs"] = st->maxLatenessMs;
+  }
+
+  JsonArray items = doc["history"].to<JsonArray>();
+  for (size_t i = 0; i < cronLogCount(); i++) {
+    const CronLogEntry *e = cronLogEntry(i);
+    if (job >= 0 && e->job != job)
+      continue;
+
+    JsonObject o = items.add<JsonObject>();
+    o["job"] = e->job;
+    o["scheduled"] = e->scheduledEpoch;
+    o["actual"] = e->scheduledEpoch + e->latenessMs / 1000;
+    o["latenessMs"] = e->latenessMs;
+    o["action"] = cronActionToString((CronAction)e->action);
+    o["result"] = cronRunResultToString(e->result);
   }
 
-  sendError("no free job slot");
+  sendJSON(doc, 200);
 }
 
 void handleDeleteCron() {
@@ -515,32 +868,826 @@ void handleDeleteCron() {
   }
 
   int id = api.arg("id").toInt();
-  CronJob *job = cronGet(id);
-
-  if (!job) {
+  if (id < 0 || id >= MAX_CRON_JOBS) {
     sendError("invalid id");
     return;
   }
 
-  job->active = false;
-  setCronJob(id, *job);
+  CronJob disabled;
+  if (!cronGet(id, disabled)) {
+    sendError("read failed", 500);
+    return;
+  }
+  disabled.active = false;
+
+  bool ok = setCronJob(id, disabled);
 
   JsonDocument doc;
-  doc["success"] = true;
-  sendJSON(doc, 200);
+  doc["success"] = ok;
+  sendJSON(doc, ok ? 200 : 500);
 }
 
 void handleClearCron() {
   if (!checkAuth(JsonDocument()))
     return;
 
-  for (int i = 0; i < MAX_CRON_JOBS; i++) {
-    CronJob *job = cronGet(i);
-    job->active = false;
-    setCronJob(i, *job);
+  bool ok = cronClearAll();
+
+  JsonDocument doc;
+  doc["success"] = ok;
+  sendJSON(doc, ok ? 200 : 500);
+}
+
+void handleGetHttpStats() {
+  if (!checkAuth(JsonDocument()))
+    return;
+
+  const HttpQueueStats &stats = httpQueueStats();
+
+  JsonDocument doc;
+  doc["pending"] = httpQueuePending();
+  doc["enqueued"] = stats.enqueued;
+  doc["dropped"] = stats.dropped;
+  doc["completed"] = stats.completed;
+  doc["failed"] = stats.failed;
+  doc["reused"] = stats.reused;
+  doc["retried"] = stats.retried;
+  doc["dnsLookups"] = stats.dnsLookups;
+  doc["maxLatencyMs"] = stats.maxLatencyMs;
+
+  JsonArray recent = doc["recent"].to<JsonArray>();
+  for (size_t i = 0; i < HTTP_RESULT_HISTORY; i++) {
+    const HttpResult *r = httpQueueResult(i);
+    if (!r)
+      break;
+
+    JsonObject o = recent.add<JsonObject>();
+    o["id"] = r->id;
+    if (r->tag >= 0)
+      o["job"] = r->tag;
+    o["status"] = r->status;
+    o["error"] = httpErrorToString(r->error);
+    o["latencyMs"] = r->latencyMs;
+    o["reused"] = r->reused;
+    o["age"] = (millis() - r->doneAt) / 1000;
+  }
+
+  sendJSON(doc, 200);
+}
+
+/* State of the snapshot upload, set while the body is received */
+static bool snapshotUploaded = false;
+static bool snapshotAuthorized = false;
+static SnapshotResult snapshotUploadResult = SnapshotOk;
+
+/**
+ * @brief Hands a piece of the exported snapshot to the HTTP client.
+ */
+static void sendSnapshotChunk(const uint8_t *data, size_t length) {
+  apiServer().sendContent((const char *)data, length);
+}
+
+void handleGetSnapshot() {
+  ESP8266WebServer &api = apiServer();
+
+  if (!checkAuth(JsonDocument()))
+    return;
+
+  // Chunked response: the document is never held in RAM
+  sendCorsHeaders();
+  api.sendHeader("Content-Disposition",
+                 "attachment; filename=\"snapshot.bin\"");
+  api.setContentLength(CONTENT_LENGTH_UNKNOWN);
+  api.send(200, "application/octet-stream", "");
+
+  snapshotExport(sendSnapshotChunk);
+  api.sendContent("");
+}
+
+void handleSnapshotUpload() {
+  HTTPRaw &raw = apiServer().raw();
+
+  switch (raw.status) {
+  case RAW_START:
+    // Nothing reaches flash before the request is authenticated
+    snapshotUploaded = true;
+    snapshotAuthorized = authorizeRequest("");
+    snapshotUploadResult = SnapshotOk;
+    if (snapshotAuthorized && !snapshotImportBegin())
+      snapshotUploadResult = SnapshotStorageError;
+    break;
+
+  case RAW_WRITE:
+    if (snapshotAuthorized && snapshotUploadResult == SnapshotOk)
+      snapshotUploadResult = snapshotImportWrite(raw.buf, raw.currentSize);
+    break;
+
+  case RAW_ABORTED:
+    snapshotImportAbort();
+    snapshotUploaded = false;
+    break;
+
+  default:
+    break;
+  }
+}
+
+void handlePutSnapshot() {
+  bool uploaded = snapshotUploaded;
+  snapshotUploaded = false;
+
+  if (!uploaded) {
+    sendError("missing body");
+    return;
+  }
+
+  if (!snapshotAuthorized) {
+    sendError("unauthorized", 401);
+    return;
+  }
+
+  SnapshotResult result = snapshotUploadResult;
+  SnapshotSummary summary = {};
+
+  if (result == SnapshotOk)
+    result = snapshotImportCommit(summary);
+  else
+    snapshotImportAbort();
+
+  if (result != SnapshotOk) {
+    JsonDocument err;
+    err["error"] = "snapshot rejected";
+    err["reason"] = snapshotResultToString(result);
+
+    int code = 400;
+    if (result == SnapshotTooLarge)
+      code = 413;
+    else if (result == SnapshotStorageError)
+      code = 500;
+
+    sendJSON(err, code);
+    return;
   }
 
   JsonDocument doc;
   doc["success"] = true;
+  doc["pins"] = summary.pins;
+  doc["cronJobs"] = summary.cronJobs;
+  doc["timezone"] = summary.timezone;
+  doc["solar"] = summary.solar;
+  doc["flags"] = summary.flags;
+  sendJSON(doc, 200);
+}
+
+void handleGetClock() {
+  if (!checkAuth(JsonDocument()))
+    return;
+
+  const ClockStats &stats = clockStats();
+
+  JsonDocument doc;
+  doc["quality"] = clockQualityToString(clockQuality());
+  doc["epochMs"] = clockNowMs();
+  doc["tz"] = clockTimezone();
+  if (clockValid())
+    doc["utcOffset"] = clockUtcOffset(clockNow());
+  doc["syncs"] = stats.syncs;
+  doc["steps"] = stats.steps;
+  if (stats.lastSyncEpoch)
+    doc["lastSyncAge"] = clockNow() - stats.lastSyncEpoch;
+  doc["lastOffsetMs"] = stats.lastOffsetMs;
+  doc["maxOffsetMs"] = stats.maxOffsetMs;
+  doc["avgOffsetMs"] = stats.avgOffsetMs;
+  doc["driftPpb"] = stats.driftPpb;
+
+  sendJSON(doc, 200);
+}
+
+void handleSetClock() {
+  ESP8266WebServer &api = apiServer();
+
+  if (!checkAuth(JsonDocument()))
+    return;
+
+  if (!api.hasArg("plain")) {
+    sendError("missing body");
+    return;
+  }
+
+  JsonDocument doc;
+  if (deserializeJson(doc, api.arg("plain"))) {
+    sendError("invalid json");
+    return;
+  }
+
+  const char *tz = doc["tz"];
+  if (!tz) {
+    sendError("missing tz");
+    return;
+  }
+
+  if (!clockSetTimezone(tz)) {
+    sendError("invalid tz");
+    return;
+  }
+
+  // Local times moved: every schedule has to be recomputed
+  cronReschedule();
+
+  JsonDocument resp;
+  resp["success"] = true;
+  resp["tz"] = clockTimezone();
+  sendJSON(resp, 200);
+}
+
+void handleGetSolar() {
+  if (!checkAuth(JsonDocument()))
+    return;
+
+  JsonDocument doc;
+  doc["configured"] = solarHasLocation();
+
+  if (solarHasLocation()) {
+    doc["lat"] = solarLatitude();
+    doc["lon"] = solarLongitude();
+
+    // Today's events (local date)
+    uint32_t now = clockNow();
+    if (now != 0) {
+      int32_t today = ((int64_t)now + clockUtcOffset(now)) / 86400;
+      uint32_t t;
+
+      if (solarEventTime(today, SolarSunrise, t))
+        doc["sunrise"] = t;
+      if (solarEventTime(today, SolarSunset, t))
+        doc["sunset"] = t;
+    }
+  }
+
   sendJSON(doc, 200);
 }
+
+void handleSetSolar() {
+  ESP8266WebServer &api = apiServer();
+
+  if (!checkAuth(JsonDocument()))
+    return;
+
+  if (!api.hasArg("plain")) {
+    sendError("missing body");
+    return;
+  }
+
+  JsonDocument doc;
+  if (deserializeJson(doc, api.arg("plain"))) {
+    sendError("invalid json");
+    return;
+  }
+
+  if (!doc["lat"].is<float>() || !doc["lon"].is<float>()) {
+    sendError("missing lat or lon");
+    return;
+  }
+
+  if (!solarSetLocation(doc["lat"].as<float>(), doc["lon"].as<float>())) {
+    sendError("invalid lat or lon");
+    return;
+  }
+
+  // Solar jobs move with the new location (see cronSchedulerLoop())
+  JsonDocument resp;
+  resp["success"] = true;
+  sendJSON(resp, 200);
+}
+
+/**
+ * @brief Adds the pins of a mask to a JSON object as "GPIOn": state.
+ */
+static void atPinsToJson(JsonObject out, uint32_t mask, uint32_t setMask) {
+  for (uint8_t pin = 0; pin <= 16; pin++) {
+    if (mask & (1UL << pin))
+      out[gpioApiKey(pin)] = (setMask >> pin) & 1;
+  }
+}
+
+/**
+ * @brief Serializes a one-shot job.
+ */
+static void atJobToJson(JsonObject out, const AtJob &job) {
+  out["id"] = job.id;
+  out["state"] = atStateToString(job.state);
+  out["at"] = job.deadlineMs;
+  atPinsToJson(out["pins"].to<JsonObject>(), job.setMask | job.clearMask,
+               job.setMask);
+
+  if (job.state == AtDone) {
+    out["latenessMs"] = job.latenessMs;
+    atPinsToJson(out["applied"].to<JsonObject>(), job.appliedMask,
+                 job.setMask);
+  }
+}
+
+void handleAtSchedule() {
+  ESP8266WebServer &api = apiServer();
+
+  if (!checkAuth(JsonDocument()))
+    return;
+
+  if (!api.hasArg("plain")) {
+    sendError("missing body");
+    return;
+  }
+
+  JsonDocument doc;
+  if (deserializeJson(doc, api.arg("plain"))) {
+    sendError("invalid json");
+    return;
+  }
+
+  if (!doc["at"].is<uint64_t>() || !doc["pins"].is<JsonObject>()) {
+    sendError("missing at or pins");
+    return;
+  }
+
+  if (!clockValid()) {
+    sendError("clock not synchronized", 503);
+    return;
+  }
+
+  uint32_t setMask = 0;
+  uint32_t clearMask = 0;
+
+  for (JsonPair kv : doc["pins"].as<JsonObject>()) {
+    int pin = apiToGpio(kv.key().c_str());
+    GpioConfig *cfg = pin >= 0 ? deviceGet(pin) : nullptr;
+
+    if (!cfg || pin > 16) {
+      sendError("invalid pin");
+      return;
+    }
+
+    if (cfg->mode != PinMode::Output) {
+      sendError("pin is not an output");
+      return;
+    }
+
+    if (!kv.value().is<int>()) {
+      sendError("invalid value type");
+      return;
+    }
+
+    if (kv.value().as<int>())
+      setMask |= 1UL << pin;
+    else
+      clearMask |= 1UL << pin;
+  }
+
+  if (!(setMask | clearMask)) {
+    sendError("missing pins");
+    return;
+  }
+
+  uint64_t at = doc["at"].as<uint64_t>();
+  uint64_t now = clockNowMs();
+
+  if (at + AT_MAX_PAST_MS < now || at > now + AT_MAX_HORIZON_MS) {
+    sendError("at out of range");
+    return;
+  }
+
+  uint32_t id = atSchedule(at, setMask, clearMask);
+  if (!id) {
+    sendError("queue full", 503);
+    return;
+  }
+
+  JsonDocument resp;
+  resp["id"] = id;
+  resp["inMs"] = at > now ? at - now : 0;
+  sendJSON(resp, 200);
+}
+
+void handleGetAt() {
+  ESP8266WebServer &api = apiServer();
+
+  if (!checkAuth(JsonDocument()))
+    return;
+
+  JsonDocument doc;
+
+  if (api.hasArg("id")) {
+    const AtJob *job = atGet(api.arg("id").toInt());
+    if (!job) {
+      sendError("unknown id", 404);
+      return;
+    }
+
+    atJobToJson(doc.to<JsonObject>(), *job);
+    sendJSON(doc, 200);
+    return;
+  }
+
+  doc["now"] = clockNowMs();
+  doc["pending"] = atPendingCount();
+
+  JsonArray items = doc["jobs"].to<JsonArray>();
+  for (size_t i = 0; i < AT_MAX_JOBS; i++) {
+    const AtJob *job = atSlot(i);
+    if (job->state != AtFree)
+      atJobToJson(items.add<JsonObject>(), *job);
+  }
+
+  sendJSON(doc, 200);
+}
+
+void handleDeleteAt() {
+  ESP8266WebServer &api = apiServer();
+
+  if (!checkAuth(JsonDocument()))
+    return;
+
+  if (!api.hasArg("id")) {
+    sendError("missing id");
+    return;
+  }
+
+  bool ok = atCancel(api.arg("id").toInt());
+
+  JsonDocument doc;
+  doc["success"] = ok;
+  sendJSON(doc, ok ? 200 : 404);
+}
+
+/**
+ * @brief Adds a static IP configuration to a JSON object.
+ */
+static void staticIpToJson(JsonObject out, const WifiStaticIp &cfg) {
+  out["ip"] = IPAddress(cfg.ip).toString();
+  out["mask"] = IPAddress(cfg.mask).toString();
+  out["gateway"] = IPAddress(cfg.gateway).toString();
+  out["dns"] = IPAddress(cfg.dns).toString();
+}
+
+void handleGetWifi() {
+  if (!checkAuth(JsonDocument()))
+    return;
+
+  JsonDocument doc;
+  doc["state"] = wifiStateToString(wifiState());
+  doc["connected"] = wifiIsConnected();
+
+  if (wifiIsConnected()) {
+    doc["ssid"] = WiFi.SSID();
+    doc["bssid"] = WiFi.BSSIDstr();
+    doc["channel"] = WiFi.channel();
+    doc["rssi"] = WiFi.RSSI();
+    doc["ip"] = WiFi.localIP().toString();
+  }
+
+  // How the boot connection was made and how long it took
+  const WifiConnectInfo &info = wifiConnectInfo();
+  JsonObject connect = doc["connect"].to<JsonObject>();
+  connect["path"] = wifiConnectPathToString(info.path);
+  connect["ipMode"] = wifiIpModeToString(info.ipMode);
+  connect["fastFailed"] = info.fastFailed;
+  connect["connectMs"] = info.connectMs;
+  connect["scanMs"] = info.scanMs;
+  connect["candidates"] = info.candidates;
+  connect["apiReadyMs"] = apiReadyMs();
+  connect["failures"] = info.failures;
+  connect["disconnects"] = info.disconnects;
+
+  if (wifiIsConnected())
+    connect["upSec"] = (millis() - info.connectAt) / 1000;
+
+  WifiStaticIp cfg;
+  if (wifiGetStaticIp(cfg))
+    staticIpToJson(doc["static"].to<JsonObject>(), cfg);
+  else
+    doc["static"] = nullptr;
+
+  sendJSON(doc, 200);
+}
+
+void handleSetWifi() {
+  ESP8266WebServer &api = apiServer();
+
+  if (!checkAuth(JsonDocument()))
+    return;
+
+  if (!api.hasArg("plain")) {
+    sendError("missing body");
+    return;
+  }
+
+  JsonDocument doc;
+  if (deserializeJson(doc, api.arg("plain"))) {
+    sendError("invalid json");
+    return;
+  }
+
+  if (doc["dhcp"] | false) {
+    if (!wifiSetStaticIp(nullptr)) {
+      sendError("storage error", 500);
+      return;
+    }
+
+    JsonDocument resp;
+    resp["success"] = true;
+    resp["static"] = nullptr;
+    sendJSON(resp, 200);
+    return;
+  }
+
+  IPAddress ip, mask, gateway, dns;
+  if (!ip.fromString(doc["ip"] | "") || !mask.fromString(doc["mask"] | "") ||
+      !gateway.fromString(doc["gateway"] | "")) {
+    sendError("missing or invalid ip, mask or gateway");
+    return;
+  }
+
+  // DNS defaults to the gateway
+  if (!doc["dns"].isNull() && !dns.fromString(doc["dns"] | "")) {
+    sendError("invalid dns");
+    return;
+  }
+
+  WifiStaticIp cfg;
+  cfg.ip = ip;
+  cfg.mask = mask;
+  cfg.gateway = gateway;
+  cfg.dns = doc["dns"].isNull() ? (uint32_t)gateway : (uint32_t)dns;
+
+  if (cfg.ip == 0 || cfg.mask == 0) {
+    sendError("invalid ip or mask");
+    return;
+  }
+
+  if (!wifiSetStaticIp(&cfg)) {
+    sendError("storage error", 500);
+    return;
+  }
+
+  JsonDocument resp;
+  resp["success"] = true;
+  staticIpToJson(resp["static"].to<JsonObject>(), cfg);
+  sendJSON(resp, 200);
+}
+
+void handleGetWifiNetworks() {
+  if (!checkAuth(JsonDocument()))
+    return;
+
+  JsonDocument doc;
+  doc["max"] = WIFI_MAX_NETWORKS;
+
+  // Passwords are never returned
+  JsonArray items = doc["networks"].to<JsonArray>();
+  for (size_t i = 0; i < wifiNetworkCount(); i++) {
+    const WifiNetwork *net = wifiNetwork(i);
+    JsonObject o = items.add<JsonObject>();
+
+    o["ssid"] = net->ssid;
+    o["primary"] = i == 0;
+    o["successes"] = net->successes;
+    o["failStreak"] = net->failStreak;
+    if (net->lastRssi != 0)
+      o["rssi"] = net->lastRssi;
+    else
+      o["rssi"] = nullptr;
+  }
+
+  sendJSON(doc, 200);
+}
+
+void handleAddWifiNetwork() {
+  ESP8266WebServer &api = apiServer();
+
+  if (!checkAuth(JsonDocument()))
+    return;
+
+  if (!api.hasArg("plain")) {
+    sendError("missing body");
+    return;
+  }
+
+  JsonDocument doc;
+  if (deserializeJson(doc, api.arg("plain"))) {
+    sendError("invalid json");
+    return;
+  }
+
+  if (!doc["ssid"].is<const char *>()) {
+    sendError("missing ssid");
+    return;
+  }
+
+  String ssid = doc["ssid"].as<const char *>();
+  String pass = doc["pass"] | "";
+
+  if (ssid.length() == 0 || ssid.length() > WIFI_SSID_MAX ||
+      pass.length() > WIFI_PASS_MAX) {
+    sendError("invalid ssid or pass");
+    return;
+  }
+
+  bool stored = false;
+  for (size_t i = 0; i < wifiNetworkCount(); i++)
+    stored |= ssid == wifiNetwork(i)->ssid;
+
+  if (wifiNetworkCount() > 0 && ssid == wifiNetwork(0)->ssid) {
+    sendError("primary network is set through the portal");
+    return;
+  }
+
+  if (!stored && wifiNetworkCount() >= WIFI_MAX_NETWORKS) {
+    sendError("network list full", 409);
+    return;
+  }
+
+  if (!wifiAddNetwork(ssid, pass)) {
+    sendError("storage error", 500);
+    return;
+  }
+
+  JsonDocument resp;
+  resp["success"] = true;
+  resp["count"] = wifiNetworkCount();
+  sendJSON(resp, 200);
+}
+
+void handleDeleteWifiNetwork() {
+  ESP8266WebServer &api = apiServer();
+
+  if (!checkAuth(JsonDocument()))
+    return;
+
+  if (!api.hasArg("ssid")) {
+    sendError("missing ssid");
+    return;
+  }
+
+  bool ok = wifiRemoveNetwork(api.arg("ssid"));
+
+  JsonDocument doc;
+  doc["success"] = ok;
+  sendJSON(doc, ok ? 200 : 404);
+}
+
+void handleGetWifiHealth() {
+  if (!checkAuth(JsonDocument()))
+    return;
+
+  JsonDocument doc;
+  const LinkStats &ls = linkStats();
+
+  doc["state"] = wifiStateToString(wifiState());
+  doc["intervalSec"] = LINK_SAMPLE_INTERVAL_MS / 1000;
+  doc["weakRssi"] = LINK_RSSI_WEAK;
+  doc["weakStreak"] = ls.weakStreak;
+
+  // RSSI history, newest first (null without a link)
+  int32_t sum = 0;
+  uint16_t linked = 0;
+  int8_t minRssi = 0, maxRssi = -127;
+
+  JsonArray history = doc["history"].to<JsonArray>();
+  for (size_t i = 0; i < linkHistoryCount(); i++) {
+    const LinkSample *s = linkHistoryEntry(i);
+
+    if (s->rssi == LINK_NO_RSSI) {
+      history.add(nullptr);
+      continue;
+    }
+
+    history.add(s->rssi);
+    sum += s->rssi;
+    linked++;
+    if (s->rssi < minRssi)
+      minRssi = s->rssi;
+    if (s->rssi > maxRssi)
+      maxRssi = s->rssi;
+  }
+
+  JsonObject rssi = doc["rssi"].to<JsonObject>();
+  if (linked > 0) {
+    rssi["min"] = minRssi;
+    rssi["max"] = maxRssi;
+    rssi["avg"] = sum / (int32_t)linked;
+  }
+  rssi["linkedSamples"] = linked;
+
+  JsonObject disc = doc["disconnects"].to<JsonObject>();
+  disc["total"] = ls.disconnects;
+
+  size_t count;
+  const LinkReasonCount *reasons = linkReasons(count);
+  JsonArray byReason = disc["reasons"].to<JsonArray>();
+  for (size_t i = 0; i < count; i++) {
+    JsonObject r = byReason.add<JsonObject>();
+    r["code"] = reasons[i].reason;
+    r["name"] = linkReasonToString(reasons[i].reason);
+    r["count"] = reasons[i].count;
+  }
+  disc["other"] = ls.otherReasons;
+
+  JsonObject rec = doc["reconnects"].to<JsonObject>();
+  rec["count"] = ls.reconnects;
+  rec["lastMs"] = ls.lastReconnectMs;
+  rec["maxMs"] = ls.maxReconnectMs;
+  if (ls.reconnects > 0)
+    rec["avgMs"] = ls.totalReconnectMs / ls.reconnects;
+
+  JsonObject pro = doc["proactive"].to<JsonObject>();
+  pro["scans"] = ls.scans;
+  pro["count"] = ls.proactive;
+  if (ls.proactive > 0)
+    pro["agoSec"] = (millis() - ls.lastProactive) / 1000;
+
+  sendJSON(doc, 200);
+}
+
+static const char *sleepTypeToString(uint8_t type) {
+  switch (type) {
+  case WIFI_LIGHT_SLEEP:
+    return "Light";
+  case WIFI_MODEM_SLEEP:
+    return "Modem";
+  default:
+    return "None";
+  }
+}
+
+void handleGetPower() {
+  if (!checkAuth(JsonDocument()))
+    return;
+
+  JsonDocument doc;
+  uint8_t current = powerProfile();
+  doc["profile"] = powerProfileToString(current);
+
+  // Settings and nominal figures of every profile
+  JsonObject list = doc["profiles"].to<JsonObject>();
+  for (uint8_t p = 0; p < PowerProfileCount; p++) {
+    const PowerProfileInfo *info = powerProfileInfo(p);
+    JsonObject o = list[powerProfileToString(p)].to<JsonObject>();
+
+    o["sleep"] = sleepTypeToString(info->sleepType);
+    o["listenInterval"] = info->listenInterval;
+    o["idleMs"] = info->idleMs;
+    o["activeMa"] = info->activeMa;
+    o["idleMa"] = info->idleMa;
+  }
+
+  // Measured since the profile was applied
+  const PowerStats &st = powerStats();
+  uint32_t elapsed = millis() - st.sinceMs;
+
+  JsonObject measured = doc["measured"].to<JsonObject>();
+  measured["sinceSec"] = elapsed / 1000;
+  measured["loops"] = st.loops;
+  measured["idlePct"] = elapsed > 0 ? (uint64_t)st.idleMs * 100 / elapsed : 0;
+  measured["estimatedMa"] = powerEstimatedMa();
+
+  JsonObject gap = measured["loopGapMs"].to<JsonObject>();
+  gap["p50"] = powerGapPercentile(50);
+  gap["p90"] = powerGapPercentile(90);
+  gap["p99"] = powerGapPercentile(99);
+  gap["max"] = st.maxGapMs;
+
+  sendJSON(doc, 200);
+}
+
+void handleSetPower() {
+  ESP8266WebServer &api = apiServer();
+
+  if (!checkAuth(JsonDocument()))
+    return;
+
+  if (!api.hasArg("plain")) {
+    sendError("missing body");
+    return;
+  }
+
+  JsonDocument doc;
+  if (deserializeJson(doc, api.arg("plain"))) {
+    sendError("invalid json");
+    return;
+  }
+
+  uint8_t profile = powerProfileFromString(doc["profile"] | "");
+  if (profile >= PowerProfileCount) {
+    sendError("invalid profile");
+    return;
+  }
+
+  if (!powerSetProfile(profile)) {
+    sendError("storage error", 500);
+    return;
+  }
+
+  JsonDocument resp;
+  resp["success"] = true;
+  resp["profile"] = powerProfileToString(profile);
+  sendJSON(resp, 200);
+}
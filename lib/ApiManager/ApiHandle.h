@@ -22,8 +22,8 @@ void handleAuthChallenge();
  *
  * Behavior:
  * - When authentication is enabled and no key is present, a new random
- *   shared secret is generated, stored in EEPROM, and returned once
- *   in the response.
+ *   shared secret is generated, stored in the key-value store, and
+ *   returned once in the response.
  * - When authentication is disabled, any stored authentication key
  *   is cleared from persistent storage.
  * - Serial debug settings are stored persistently and take effect
@@ -54,9 +54,11 @@ void handleSetup();
  * Endpoint: GET /api/state
  *
  * Returns a JSON document containing:
- * - Device information (IP, chip ID, RSSI, uptime, settings)
+ * - Device information (IP, chip ID, firmware, mDNS hostname, state
+ *   version, RSSI, uptime, settings)
  * - All configured GPIO pins with state and capabilities
- * - All configured cron jobs
+ * - Cron summary (slot count and active jobs)
+ * - Deferred flash writes (flushes requested, performed, merged, failed)
  *
  * Requires authentication if enabled.
  */
@@ -117,17 +119,38 @@ void handlePatchPin();
 void handleReboot();
 
 /**
- * @brief Returns a specific cron job configuration.
+ * @brief Returns a specific cron job configuration, or a page of jobs.
  *
  * Endpoint: GET /api/cron?id=N
  *
  * Returns the cron expression, action, target pin and value
  * for the specified cron job slot.
  *
+ * Endpoint: GET /api/cron?offset=N&limit=M
+ *
+ * Lists up to `limit` active jobs (default 16, max 32) starting at slot
+ * `offset`. The response carries the number of active jobs (`total`) and,
+ * unless this is the last page, the slot to pass as the next `offset`
+ * (`next`).
+ *
  * Requires authentication if enabled.
  */
 void handleGetCron();
 
+/**
+ * @brief Lists the next fire times of a cron expression.
+ *
+ * Endpoint: GET /api/cron/preview?expr=...&n=20[&from=EPOCH]
+ *
+ * Uses the scheduler's own next-fire search and the configured timezone,
+ * so the result is exactly when a job with this expression would run.
+ * `n` defaults to 10 (max 50); the search starts after `from` (an
+ * unsigned epoch, 400 otherwise) or, by default, the current time.
+ *
+ * Requires authentication if enabled.
+ */
+void handleCronPreview();
+
 /**
  * @brief Creates or updates a cron job.
  *
@@ -135,8 +158,10 @@ void handleGetCron();
  *
  * Accepts a JSON body describing:
  * - Cron expression
- * - Action (set, toggle, reboot)
+ * - Action (set, toggle, http, reboot)
  * - Optional pin and value
+ * - url and optional method ("GET" or "POST") for http jobs
+ * - Optional misfire policy ("skip", "once", "all") and misfireLimit
  *
  * The job is stored persistently and activated immediately.
  *
@@ -144,6 +169,20 @@ void handleGetCron();
  */
 void handleCronSet();
 
+/**
+ * @brief Returns the cron execution log.
+ *
+ * Endpoint: GET /api/cron/history[?id=N]
+ *
+ * Lists the most recent occurrences (newest first) with scheduled time,
+ * lateness in milliseconds, action and result (Ok, Failed, Missed,
+ * Unreadable). With an id, only that job's occurrences are listed,
+ * together with its aggregates (runs, failures, misses, max lateness).
+ *
+ * Requires authentication if enabled.
+ */
+void handleGetCronHistory();
+
 /**
  * @brief Disables a cron job.
  *
@@ -166,3 +205,242 @@ void handleDeleteCron();
  * Requires authentication if enabled.
  */
 void handleClearCron();
+
+/**
+ * @brief Returns outbound HTTP request statistics.
+ *
+ * Endpoint: GET /api/http
+ *
+ * Returns the queue counters (enqueued, dropped, completed, failed,
+ * reused connections, max latency) and the most recent request results
+ * with status code, transport error and latency.
+ *
+ * Requires authentication if enabled.
+ */
+void handleGetHttpStats();
+
+/**
+ * @brief Exports the device configuration as one binary document.
+ *
+ * Endpoint: GET /api/snapshot
+ *
+ * Streams pins, cron jobs, flags, timezone and solar location (see
+ * Snapshot.h for the format) with a chunked response, so the RAM used
+ * does not depend on the number of cron jobs. The authentication key and
+ * flag are not included.
+ *
+ * Requires authentication if enabled.
+ */
+void handleGetSnapshot();
+
+/**
+ * @brief Receives the body of PUT /api/snapshot into a staging file.
+ *
+ * Upload handler of the endpoint: authentication is checked when the body
+ * starts, and an unauthorized body is discarded without touching flash.
+ */
+void handleSnapshotUpload();
+
+/**
+ * @brief Imports a document produced by GET /api/snapshot.
+ *
+ * Endpoint: PUT /api/snapshot
+ *
+ * Body: the binary snapshot (Content-Type: application/octet-stream).
+ * The whole document is validated before anything is changed, then
+ * applied with one storage commit per backing file. Pins and cron jobs
+ * are replaced as a whole.
+ *
+ * Requires authentication if enabled.
+ */
+void handlePutSnapshot();
+
+/**
+ * @brief Returns the clock state and SNTP sync statistics.
+ *
+ * Endpoint: GET /api/clock
+ *
+ * Returns the clock quality, the current epoch in milliseconds, the
+ * timezone and its current UTC offset, the sync and step counters, the
+ * age of the last sync, the offsets measured at syncs (last, max,
+ * average) and the drift correction in use.
+ *
+ * Requires authentication if enabled.
+ */
+void handleGetClock();
+
+/**
+ * @brief Sets the timezone.
+ *
+ * Endpoint: PATCH /api/clock
+ *
+ * Body: {"tz": "<POSIX TZ string>"}. The timezone is persisted and all
+ * cron schedules are recomputed in the new local time.
+ *
+ * Requires authentication if enabled.
+ */
+void handleSetClock();
+
+/**
+ * @brief Returns the solar location and today's sunrise and sunset.
+ *
+ * Endpoint: GET /api/solar
+ *
+ * Event times are UTC epochs; they are omitted on days without the event
+ * (polar day or night) and while the clock is not synchronized.
+ *
+ * Requires authentication if enabled.
+ */
+void handleGetSolar();
+
+/**
+ * @brief Sets the location used by sunrise/sunset cron jobs.
+ *
+ * Endpoint: PATCH /api/solar
+ *
+ * Body: {"lat": <degrees>, "lon": <degrees>}. The location is persisted
+ * and solar jobs are rescheduled.
+ *
+ * Requires authentication if enabled.
+ */
+void handleSetSolar();
+
+/**
+ * @brief Schedules a one-shot pin update at an absolute time.
+ *
+ * Endpoint: POST /api/at
+ *
+ * Body: {"at": <UTC epoch ms>, "pins": {"GPIO12": 1, "GPIO4": 0}}. All
+ * pins must be digital outputs; they switch together at the deadline.
+ * Returns the job id. Requires a synchronized clock.
+ *
+ * Requires authentication if enabled.
+ */
+void handleAtSchedule();
+
+/**
+ * @brief Returns one-shot jobs.
+ *
+ * Endpoint: GET /api/at[?id=N]
+ *
+ * With an id, returns that job; otherwise all pending and recently
+ * finished jobs. Finished jobs report their lateness in milliseconds
+ * and the pins actually switched.
+ *
+ * Requires authentication if enabled.
+ */
+void handleGetAt();
+
+/**
+ * @brief Cancels a pending one-shot job.
+ *
+ * Endpoint: DELETE /api/at?id=N
+ *
+ * Requires authentication if enabled.
+ */
+void handleDeleteAt();
+
+/**
+ * @brief Returns the WiFi link and how it was established at boot.
+ *
+ * Endpoint: GET /api/wifi
+ *
+ * Returns the connection state, the SSID, BSSID, channel, RSSI and IP
+ * address, the connect path ("Fast" to the cached access point, or
+ * "Scan"), the source of the IP configuration ("Dhcp", "Lease" or
+ * "Static"), the time spent connecting, the time from boot until the API
+ * was serving, the failed attempts and lost links, and the static IP
+ * configuration (null when DHCP is used).
+ *
+ * Requires authentication if enabled.
+ */
+void handleGetWifi();
+
+/**
+ * @brief Sets or clears the static IP configuration.
+ *
+ * Endpoint: PATCH /api/wifi
+ *
+ * Body: {"ip": "...", "mask": "...", "gateway": "...", "dns": "..."}
+ * (dns defaults to the gateway), or {"dhcp": true} to go back to DHCP.
+ * Takes effect at the next connection.
+ *
+ * Requires authentication if enabled.
+ */
+void handleSetWifi();
+
+/**
+ * @brief Lists the stored networks.
+ *
+ * Endpoint: GET /api/wifi/networks
+ *
+ * Returns every stored network (the primary one first) with its join
+ * counters and the RSSI seen by the last scan (null if not seen).
+ * Passwords are never returned.
+ *
+ * Requires authentication if enabled.
+ */
+void handleGetWifiNetworks();
+
+/**
+ * @brief Adds a network, or changes the password of a stored one.
+ *
+ * Endpoint: POST /api/wifi/networks
+ *
+ * Body: {"ssid": "...", "pass": "..."}. Used from the next connection
+ * attempt. The primary network is set through the captive portal.
+ *
+ * Requires authentication if enabled.
+ */
+void handleAddWifiNetwork();
+
+/**
+ * @brief Removes a network added through the API.
+ *
+ * Endpoint: DELETE /api/wifi/networks?ssid=...
+ *
+ * Requires authentication if enabled.
+ */
+void handleDeleteWifiNetwork();
+
+/**
+ * @brief Returns the link health history and reconnect metrics.
+ *
+ * Endpoint: GET /api/wifi/health
+ *
+ * Returns the RSSI samples kept by the link monitor (newest first, null
+ * without a link) with their min/max/average, disconnects by reason code,
+ * reconnect durations (last, max, average), the background scans made
+ * for a weak link and the reconnects they started.
+ *
+ * Requires authentication if enabled.
+ */
+void handleGetWifiHealth();
+
+/**
+ * @brief Returns the power profile and its measurements.
+ *
+ * Endpoint: GET /api/power
+ *
+ * Returns the current profile, the settings and nominal current figures
+ * of every profile, and, since the profile was applied: the loop gap
+ * percentiles (the longest a request or local event waits for the loop),
+ * the share of time spent in the idle delay and the estimated average
+ * current.
+ *
+ * Requires authentication if enabled.
+ */
+void handleGetPower();
+
+/**
+ * @brief Selects the power profile.
+ *
+ * Endpoint: PATCH /api/power
+ *
+ * Body: {"profile": "Performance" | "Balanced" | "LowPower"}. The profile
+ * is persisted and applied at once (the DTIM listen interval from the
+ * next connection).
+ *
+ * Requires authentication if enabled.
+ */
+void handleSetPower();
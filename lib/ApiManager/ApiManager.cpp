@@ -9,6 +9,9 @@
 #include <ESP8266WebServer.h>
 #include <EepromConfig.h>
 
+/* millis() when the API started serving */
+static uint32_t readyMs = 0;
+
 bool apiInit() {
   ESP8266WebServer &api = apiServer();
 
@@ -26,8 +29,28 @@ bool apiInit() {
   api.on("/api/reboot", HTTP_POST, handleReboot);
   api.on("/api/cron/set", HTTP_PATCH, handleCronSet);
   api.on("/api/cron", HTTP_GET, handleGetCron);
+  api.on("/api/cron/preview", HTTP_GET, handleCronPreview);
+  api.on("/api/cron/history", HTTP_GET, handleGetCronHistory);
   api.on("/api/cron", HTTP_DELETE, handleDeleteCron);
   api.on("/api/cron/clear", HTTP_DELETE, handleClearCron);
+  api.on("/api/http", HTTP_GET, handleGetHttpStats);
+  api.on("/api/snapshot", HTTP_GET, handleGetSnapshot);
+  api.on("/api/snapshot", HTTP_PUT, handlePutSnapshot, handleSnapshotUpload);
+  api.on("/api/clock", HTTP_GET, handleGetClock);
+  api.on("/api/clock", HTTP_PATCH, handleSetClock);
+  api.on("/api/solar", HTTP_GET, handleGetSolar);
+  api.on("/api/solar", HTTP_PATCH, handleSetSolar);
+  api.on("/api/at", HTTP_POST, handleAtSchedule);
+  api.on("/api/at", HTTP_GET, handleGetAt);
+  api.on("/api/at", HTTP_DELETE, handleDeleteAt);
+  api.on("/api/wifi", HTTP_GET, handleGetWifi);
+  api.on("/api/wifi", HTTP_PATCH, handleSetWifi);
+  api.on("/api/wifi/networks", HTTP_GET, handleGetWifiNetworks);
+  api.on("/api/wifi/networks", HTTP_POST, handleAddWifiNetwork);
+  api.on("/api/wifi/networks", HTTP_DELETE, handleDeleteWifiNetwork);
+  api.on("/api/wifi/health", HTTP_GET, handleGetWifiHealth);
+  api.on("/api/power", HTTP_GET, handleGetPower);
+  api.on("/api/power", HTTP_PATCH, handleSetPower);
 
   api.onNotFound([]() {
     ESP8266WebServer &api = apiServer();
@@ -41,9 +64,14 @@ bool apiInit() {
     api.send(404, "application/json", "{\"error\":\"not found\"}");
   });
 
+  readyMs = millis();
+  debugPrintln(F("[API]"), "API ready " + String(readyMs) + " ms after boot");
+
   return true;
 }
 
+uint32_t apiReadyMs() { return readyMs; }
+
 void apiLoop() {
   ESP8266WebServer &api = apiServer();
 
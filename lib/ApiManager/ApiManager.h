@@ -18,3 +18,10 @@ bool apiInit();
  * to process incoming client requests and keep the API responsive.
  */
 void apiLoop();
+
+/**
+ * @brief Time from boot until the API was serving requests.
+ *
+ * @return Milliseconds since boot at the end of apiInit(), 0 before it
+ */
+uint32_t apiReadyMs();
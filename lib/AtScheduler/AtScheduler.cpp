@@ -0,0 +1,294 @@
+#include "AtScheduler.h"
+
+#include <Clock.h>
+#include <Debug.h>
+#include <DeviceController.h>
+
+#define AT_NONE 0xFF
+#define AT_SLOT_MASK (AT_WHEEL_SLOTS - 1)
+#define AT_BUCKETS (AT_WHEEL_LEVELS * AT_WHEEL_SLOTS + 1)
+#define AT_OVERFLOW (AT_BUCKETS - 1)
+
+/* Pins that can be scheduled (GPIO0-16) */
+#define AT_PIN_MASK 0x1FFFFUL
+
+static_assert(AT_MAX_JOBS < AT_NONE, "AT_MAX_JOBS must fit a uint8_t link");
+
+static AtJob jobs[AT_MAX_JOBS];
+static uint32_t nextId = 1;
+static size_t pendingCount = 0;
+
+/* Wheel links of pending jobs (doubly linked lists per bucket) */
+static uint64_t jobMono[AT_MAX_JOBS]; // deadline on the monotonic clock
+static uint8_t jobNext[AT_MAX_JOBS];
+static uint8_t jobPrev[AT_MAX_JOBS];
+static uint16_t jobBucket[AT_MAX_JOBS];
+static uint8_t bucketHead[AT_BUCKETS];
+
+/* Next monotonic millisecond to be processed */
+static uint64_t wheelTick = 0;
+
+/* SNTP sync counter at the last re-anchoring */
+static uint32_t lastSyncs = 0;
+
+/**
+ * @brief Bucket holding a deadline, relative to the current tick.
+ */
+static uint16_t bucketFor(uint64_t due) {
+  if (due < wheelTick)
+    due = wheelTick;
+
+  uint64_t delta = due - wheelTick;
+
+  for (uint8_t level = 0; level < AT_WHEEL_LEVELS; level++) {
+    uint8_t shift = level * AT_WHEEL_BITS;
+    if (delta < (1ULL << (shift + AT_WHEEL_BITS)))
+      return level * AT_WHEEL_SLOTS + ((due >> shift) & AT_SLOT_MASK);
+  }
+  return AT_OVERFLOW;
+}
+
+static void wheelLink(uint8_t i) {
+  uint16_t b = bucketFor(jobMono[i]);
+
+  jobBucket[i] = b;
+  jobPrev[i] = AT_NONE;
+  jobNext[i] = bucketHead[b];
+  if (bucketHead[b] != AT_NONE)
+    jobPrev[bucketHead[b]] = i;
+  bucketHead[b] = i;
+}
+
+static void wheelUnlink(uint8_t i) {
+  if (jobPrev[i] != AT_NONE)
+    jobNext[jobPrev[i]] = jobNext[i];
+  else
+    bucketHead[jobBucket[i]] = jobNext[i];
+
+  if (jobNext[i] != AT_NONE)
+    jobPrev[jobNext[i]] = jobPrev[i];
+}
+
+/**
+ * @brief Redistributes a bucket of a higher level into the lower ones.
+ */
+static void cascade(uint16_t b) {
+  uint8_t i = bucketHead[b];
+  bucketHead[b] = AT_NONE;
+
+  while (i != AT_NONE) {
+    uint8_t next = jobNext[i];
+    wheelLink(i);
+    i = next;
+  }
+}
+
+/**
+ * @brief Recomputes the monotonic deadlines from the wall-clock ones.
+ *
+ * Called after an SNTP sync moved the wall clock relative to the
+ * monotonic one.
+ */
+static void reanchor() {
+  uint64_t mono = clockMonoMs();
+  uint64_t wall = clockNowMs();
+
+  for (uint8_t i = 0; i < AT_MAX_JOBS; i++) {
+    if (jobs[i].state != AtPending)
+      continue;
+
+    int64_t remaining = (int64_t)(jobs[i].deadlineMs - wall);
+    wheelUnlink(i);
+    jobMono[i] = remaining > 0 ? mono + remaining : mono;
+    wheelLink(i);
+  }
+}
+
+/**
+ * @brief Finds a free slot, recycling the oldest finished job if needed.
+ */
+static int allocSlot() {
+  int oldest = -1;
+
+  for (uint8_t i = 0; i < AT_MAX_JOBS; i++) {
+    if (jobs[i].state == AtFree)
+      return i;
+
+    if (jobs[i].state != AtPending &&
+        (oldest < 0 || jobs[i].id < jobs[oldest].id))
+      oldest = i;
+  }
+  return oldest;
+}
+
+static int findJob(uint32_t id) {
+  if (id == 0)
+    return -1;
+
+  for (uint8_t i = 0; i < AT_MAX_JOBS; i++) {
+    if (jobs[i].state != AtFree && jobs[i].id == id)
+      return i;
+  }
+  return -1;
+}
+
+bool atSchedulerInit() {
+  memset(jobs, 0, sizeof(jobs));
+  memset(bucketHead, AT_NONE, sizeof(bucketHead));
+
+  pendingCount = 0;
+  wheelTick = clockMonoMs();
+  lastSyncs = clockStats().syncs;
+
+  debugPrintln(F("[AT]"), "One-shot scheduler ready, " +
+                              String(AT_MAX_JOBS) + " slots");
+  return true;
+}
+
+void atSchedulerLoop() {
+  uint64_t now = clockMonoMs();
+
+  if (pendingCount == 0) {
+    wheelTick = now + 1;
+    return;
+  }
+
+  if (clockStats().syncs != lastSyncs) {
+    lastSyncs = clockStats().syncs;
+    reanchor();
+  }
+
+  uint8_t fired[AT_MAX_JOBS];
+  uint8_t firedCount = 0;
+  uint32_t setAcc = 0;
+  uint32_t clearAcc = 0;
+
+  while (wheelTick <= now) {
+    uint64_t t = wheelTick;
+
+    // Pull the next span of every level down, highest level first
+    if ((t & AT_SLOT_MASK) == 0) {
+      uint64_t s1 = t >> AT_WHEEL_BITS;
+      uint64_t s2 = s1 >> AT_WHEEL_BITS;
+      uint64_t s3 = s2 >> AT_WHEEL_BITS;
+
+      if ((s1 & AT_SLOT_MASK) == 0) {
+        if ((s2 & AT_SLOT_MASK) == 0) {
+          if ((s3 & AT_SLOT_MASK) == 0)
+            cascade(AT_OVERFLOW);
+          cascade(3 * AT_WHEEL_SLOTS + (s3 & AT_SLOT_MASK));
+        }
+        cascade(2 * AT_WHEEL_SLOTS + (s2 & AT_SLOT_MASK));
+      }
+      cascade(AT_WHEEL_SLOTS + (s1 & AT_SLOT_MASK));
+    }
+
+    // Expire level 0; a later deadline wins on the same pin
+    uint8_t i = bucketHead[t & AT_SLOT_MASK];
+    bucketHead[t & AT_SLOT_MASK] = AT_NONE;
+
+    while (i != AT_NONE) {
+      setAcc = (setAcc & ~jobs[i].clearMask) | jobs[i].setMask;
+      clearAcc = (clearAcc & ~jobs[i].setMask) | jobs[i].clearMask;
+      fired[firedCount++] = i;
+      i = jobNext[i];
+    }
+
+    wheelTick++;
+  }
+
+  if (firedCount == 0)
+    return;
+
+  // Every job due in this pass switches in one coalesced update
+  uint64_t wall = clockNowMs();
+  uint32_t applied = deviceWriteOutputs(setAcc, clearAcc);
+
+  for (uint8_t k = 0; k < firedCount; k++) {
+    AtJob &job = jobs[fired[k]];
+
+    job.state = AtDone;
+    job.latenessMs = (int32_t)(int64_t)(wall - job.deadlineMs);
+    job.appliedMask = (job.setMask | job.clearMask) & applied;
+    pendingCount--;
+
+    debugPrintf(F("[AT]"), "#%u done, late %ld ms, pins 0x%05lx",
+                (unsigned)job.id, (long)job.latenessMs,
+                (unsigned long)job.appliedMask);
+  }
+}
+
+uint32_t atSchedule(uint64_t deadlineMs, uint32_t setMask,
+                    uint32_t clearMask) {
+  if (!clockValid())
+    return 0;
+
+  if (((setMask | clearMask) & ~AT_PIN_MASK) || !(setMask | clearMask) ||
+      (setMask & clearMask))
+    return 0;
+
+  uint64_t wall = clockNowMs();
+  if (deadlineMs + AT_MAX_PAST_MS < wall ||
+      deadlineMs > wall + AT_MAX_HORIZON_MS)
+    return 0;
+
+  int slot = allocSlot();
+  if (slot < 0)
+    return 0;
+
+  AtJob &job = jobs[slot];
+  job.id = nextId++;
+  job.state = AtPending;
+  job.deadlineMs = deadlineMs;
+  job.setMask = setMask;
+  job.clearMask = clearMask;
+  job.appliedMask = 0;
+  job.latenessMs = 0;
+
+  // The wheel runs on the monotonic clock: convert once, re-anchor on sync
+  uint64_t mono = clockMonoMs();
+  jobMono[slot] = deadlineMs > wall ? mono + (deadlineMs - wall) : mono;
+
+  if (pendingCount == 0)
+    wheelTick = mono;
+
+  wheelLink(slot);
+  pendingCount++;
+
+  return job.id;
+}
+
+bool atCancel(uint32_t id) {
+  int i = findJob(id);
+  if (i < 0 || jobs[i].state != AtPending)
+    return false;
+
+  wheelUnlink(i);
+  jobs[i].state = AtCancelled;
+  pendingCount--;
+  return true;
+}
+
+const AtJob *atGet(uint32_t id) {
+  int i = findJob(id);
+  return i < 0 ? nullptr : &jobs[i];
+}
+
+const AtJob *atSlot(size_t index) {
+  return index < AT_MAX_JOBS ? &jobs[index] : nullptr;
+}
+
+size_t atPendingCount() { return pendingCount; }
+
+String atStateToString(uint8_t state) {
+  switch (state) {
+  case AtPending:
+    return "Pending";
+  case AtDone:
+    return "Done";
+  case AtCancelled:
+    return "Cancelled";
+  default:
+    return "Free";
+  }
+}
@@ -0,0 +1,128 @@
+#pragma once
+
+#include <Arduino.h>
+
+/**
+ * @brief Maximum number of one-shot jobs (pending and completed).
+ *
+ * When the table is full, the oldest completed job is recycled.
+ */
+#ifndef AT_MAX_JOBS
+#define AT_MAX_JOBS 32
+#endif
+
+/**
+ * @brief Furthest deadline accepted, in milliseconds from now (7 days).
+ */
+#define AT_MAX_HORIZON_MS 604800000ULL
+
+/**
+ * @brief Deadlines up to this far in the past (in milliseconds) are still
+ * accepted and run at once; older ones are rejected.
+ */
+#define AT_MAX_PAST_MS 5000
+
+/**
+ * @brief Timer wheel geometry: AT_WHEEL_LEVELS levels of AT_WHEEL_SLOTS
+ * slots, level 0 ticking every millisecond.
+ *
+ * Each level covers AT_WHEEL_SLOTS times the span of the one below:
+ * 64 ms, 4.1 s, 4.4 min and 4.7 h. Later deadlines wait in an overflow
+ * list that is redistributed once per level-3 revolution.
+ */
+#define AT_WHEEL_BITS 6
+#define AT_WHEEL_SLOTS (1 << AT_WHEEL_BITS)
+#define AT_WHEEL_LEVELS 4
+
+/**
+ * @brief State of a one-shot job.
+ *
+ * - AtFree: Unused slot
+ * - AtPending: Waiting for its deadline
+ * - AtDone: Executed; `latenessMs` and `appliedMask` are set
+ * - AtCancelled: Cancelled before its deadline
+ */
+enum AtJobState { AtFree = 0, AtPending, AtDone, AtCancelled };
+
+/**
+ * @brief A one-shot pin update at an absolute time.
+ *
+ * All pins of a job, and of every other job due on the same millisecond,
+ * are switched together (see deviceWriteOutputs()).
+ */
+struct AtJob {
+  uint32_t id;          // > 0, assigned by atSchedule()
+  uint8_t state;        // AtJobState
+  uint64_t deadlineMs;  // UTC epoch milliseconds
+  uint32_t setMask;     // bit n = drive GPIOn high
+  uint32_t clearMask;   // bit n = drive GPIOn low
+  uint32_t appliedMask; // pins actually switched (Output mode at deadline)
+  int32_t latenessMs;   // wall time of execution minus deadline
+};
+
+/**
+ * @brief Initializes the job table and the timer wheel.
+ *
+ * Jobs are kept in RAM only; a reboot drops them.
+ *
+ * @return true if initialization was successful
+ */
+bool atSchedulerInit();
+
+/**
+ * @brief Advances the timer wheel and executes due jobs.
+ *
+ * Call it as often as possible: the loop interval bounds the lateness.
+ * After an SNTP sync the pending deadlines are re-anchored to the
+ * corrected wall clock.
+ */
+void atSchedulerLoop();
+
+/**
+ * @brief Schedules a pin update at an absolute time.
+ *
+ * A deadline already in the past (by at most AT_MAX_PAST_MS, e.g. due
+ * to transfer latency) is executed on the next loop and reports its
+ * lateness.
+ *
+ * @param deadlineMs UTC epoch milliseconds
+ * @param setMask Pins to drive high
+ * @param clearMask Pins to drive low
+ * @return Job id (> 0), or 0 if the clock is not synchronized, the
+ * deadline is out of range or no slot is free
+ */
+uint32_t atSchedule(uint64_t deadlineMs, uint32_t setMask, uint32_t clearMask);
+
+/**
+ * @brief Cancels a pending job.
+ *
+ * @return false if the job does not exist or is no longer pending
+ */
+bool atCancel(uint32_t id);
+
+/**
+ * @brief Looks up a job by id.
+ *
+ * @return nullptr if the id is unknown (never used or recycled)
+ */
+const AtJob *atGet(uint32_t id);
+
+/**
+ * @brief Returns the job in table slot `index` (any state).
+ *
+ * @return nullptr if index >= AT_MAX_JOBS
+ */
+const AtJob *atSlot(size_t index);
+
+/**
+ * @brief Number of jobs waiting for their deadline.
+ */
+size_t atPendingCount();
+
+/**
+ * @brief Converts an AtJobState value to its string representation.
+ *
+ * @param state The AtJobState value
+ * @return "Pending", "Done", "Cancelled" or "Free"
+ */
+String atStateToString(uint8_t state);
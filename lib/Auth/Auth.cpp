@@ -1,8 +1,10 @@
 #include "Auth.h"
 
+#include <Clock.h>
 #include <Crypto.h>
 #include <Debug.h>
 #include <EepromConfig.h>
+#include <KvStore.h>
 #include <string.h>
 
 #define AUTH_KEY_LEN 32
@@ -39,7 +41,7 @@ static int findFreeSlot() {
 
 static int findOldestSlot() {
   int idx = 0;
-  uint32_t oldest = authSlots[0].timestamp;
+  uint64_t oldest = authSlots[0].timestamp;
 
   for (int i = 1; i < MAX_AUTH_SLOTS; i++) {
     if (authSlots[i].timestamp < oldest) {
@@ -50,19 +52,45 @@ static int findOldestSlot() {
   return idx;
 }
 
+/**
+ * @brief Moves the flag and key of older firmware from EEPROM to the
+ * config store, in one batch, and clears them in EEPROM.
+ */
+static void migrateFromEeprom() {
+  bool flag = false;
+  uint8_t key[AUTH_KEY_LEN];
+
+  loadAuthFlag(&flag);
+  bool hasKey = loadAuthKey(key, AUTH_KEY_LEN);
+
+  kvBegin();
+  kvSetBool(KvKeyAuthFlag, flag);
+  if (hasKey)
+    kvSet(KvKeyAuthKey, KvBlob, key, AUTH_KEY_LEN);
+
+  if (kvCommit()) {
+    clearAuthKey();
+    debugPrintln(F("[AUTH]"), F("Settings moved from EEPROM"));
+  }
+}
+
 bool authInit() {
 
   // Clear all authentication slots
   for (int i = 0; i < MAX_AUTH_SLOTS; i++)
     clearSlot(authSlots[i]);
 
-  loadAuthFlag(&authEnabled);
+  if (!kvHas(KvKeyAuthFlag))
+    migrateFromEeprom();
 
-  // Try loading authentication key from EEPROM
-  if (authEnabled && loadAuthKey(authKey, AUTH_KEY_LEN)) {
+  authEnabled = false;
+  kvGetBool(KvKeyAuthFlag, authEnabled);
+
+  // Try loading authentication key from the config store
+  if (authEnabled && kvGet(KvKeyAuthKey, KvBlob, authKey, AUTH_KEY_LEN)) {
 
     debugPrintln(F("[AUTH]"),
-                 F("Authentication enabled (key loaded from EEPROM)"));
+                 F("Authentication enabled (key loaded from config store)"));
 
     // Convert key to hex string for debug
     char keyHex[AUTH_KEY_LEN * 2 + 1];
@@ -72,7 +100,7 @@ bool authInit() {
 
   } else {
     authEnabled = false;
-    debugPrintln(F("[AUTH]"), F("Authentication disabled (no key in EEPROM)"));
+    debugPrintln(F("[AUTH]"), F("Authentication disabled (no key stored)"));
   }
 
   return true;
@@ -90,7 +118,7 @@ uint32_t authGenerateChallenge(const IPAddress &clientIp) {
 
   authSlots[idx].ip = clientIp;
   authSlots[idx].nonce = os_random();
-  authSlots[idx].timestamp = millis();
+  authSlots[idx].timestamp = clockMonoMs();
   authSlots[idx].active = true;
 
   return authSlots[idx].nonce;
@@ -110,7 +138,7 @@ bool authVerify(const IPAddress &clientIp, uint32_t nonce, const char *uri,
   if (!slot.active || slot.nonce != nonce)
     return false;
 
-  if (millis() - slot.timestamp > NONCE_TIMEOUT_MS) {
+  if (clockMonoMs() - slot.timestamp > NONCE_TIMEOUT_MS) {
     clearSlot(slot);
     return false;
   }
@@ -158,18 +186,22 @@ bool generateAuthKey(uint8_t *out) {
     return false;
 
   randomBytes(out, AUTH_KEY_LEN);
-  setAuthKey(out, AUTH_KEY_LEN);
+
+  // Storing a key enables authentication (as before)
+  if (!kvSet(KvKeyAuthKey, KvBlob, out, AUTH_KEY_LEN) ||
+      !kvSetBool(KvKeyAuthFlag, true))
+    return false;
 
   debugPrintln(F("[AUTH]"), F("New authentication key generated and stored"));
   return true;
 }
 
 void enableAuth() {
-  setAuthFlag(true);
+  kvSetBool(KvKeyAuthFlag, true);
   authEnabled = true;
 }
 
 void disableAuth() {
-  setAuthFlag(false);
+  kvSetBool(KvKeyAuthFlag, false);
   authEnabled = false;
 }
@@ -20,7 +20,7 @@
 struct AuthSlot {
   IPAddress ip;       ///< Client IP address
   uint32_t nonce;     ///< One-time nonce associated with the client
-  uint32_t timestamp; ///< Timestamp of nonce generation (millis)
+  uint64_t timestamp; ///< Nonce generation time (clockMonoMs)
   bool active;        ///< Slot active flag
 };
 
@@ -81,7 +81,7 @@ bool getAuthEnabled();
  * @brief Generates and persists a new authentication shared secret.
  *
  * - Generates a cryptographically secure 32-byte random key
- * - Stores the key in EEPROM
+ * - Stores the key in the key-value store (KvStore)
  * - Enables authentication flag
  * - Returns the generated key for one-time provisioning use
  *
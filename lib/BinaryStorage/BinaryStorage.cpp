@@ -1,55 +1,209 @@
 #include "BinaryStorage.h"
 #include <LittleFS.h>
+#include <coredecls.h>
 
 #include "Debug.h"
 
 bool storageInit() { return LittleFS.begin(); }
 
+/* Framed file written by storageWrite(): header followed by the payload */
+#define STORAGE_MAGIC 0x31465342 // "BSF1"
+#define STORAGE_TMP_SUFFIX ".tmp"
+#define STORAGE_PATH_MAX 48
+
+/**
+ * @brief A module with a deferred flush.
+ */
+struct DeferEntry {
+  StorageFlushFn flush; // nullptr = unused
+  unsigned long firstDirty; // millis() of the first pending request
+  unsigned long lastDirty;  // millis() of the latest request
+};
+
+static DeferEntry deferred[STORAGE_DEFER_SLOTS];
+static StorageDeferStats deferStats;
+
+struct StorageHeader {
+  uint32_t magic;
+  uint32_t seq;    // incremented on every write of the file
+  uint32_t length; // payload bytes
+  uint32_t crc;    // CRC32 of seq, length and payload
+};
+
+/**
+ * @brief CRC32 of a payload chained onto the header fields.
+ */
+static uint32_t frameCrc(const StorageHeader &hdr, const uint8_t *data,
+                         size_t length) {
+  uint32_t crc = crc32(&hdr.seq, sizeof(hdr.seq) + sizeof(hdr.length));
+  return crc32(data, length, crc);
+}
+
+static bool tmpPath(const char *path, char *out) {
+  return snprintf(out, STORAGE_PATH_MAX, "%s" STORAGE_TMP_SUFFIX, path) <
+         STORAGE_PATH_MAX;
+}
+
+/**
+ * @brief Reads the header of a framed file.
+ *
+ * @return false if the file is missing or not framed
+ */
+static bool readHeader(const char *path, StorageHeader &hdr) {
+  if (!LittleFS.exists(path))
+    return false;
+
+  File f = LittleFS.open(path, "r");
+  if (!f)
+    return false;
+
+  bool ok = f.read((uint8_t *)&hdr, sizeof(hdr)) == sizeof(hdr) &&
+            hdr.magic == STORAGE_MAGIC &&
+            f.size() == sizeof(hdr) + hdr.length;
+  f.close();
+  return ok;
+}
+
 /**
- * Write binary data to storage using LittleFS.
- * The file at 'path' will be overwritten if it exists.
+ * @brief Reads and verifies the payload of a framed file.
+ */
+static bool readFramed(const char *path, uint8_t *buffer, size_t length) {
+  File f = LittleFS.open(path, "r");
+  if (!f)
+    return false;
+
+  StorageHeader hdr;
+  bool ok = f.read((uint8_t *)&hdr, sizeof(hdr)) == sizeof(hdr) &&
+            hdr.magic == STORAGE_MAGIC && hdr.length == length &&
+            f.read(buffer, length) == length;
+  f.close();
+
+  return ok && hdr.crc == frameCrc(hdr, buffer, length);
+}
+
+/**
+ * @brief Verifies the CRC of a framed file, reading it in small chunks.
+ */
+static bool frameIsValid(const char *path) {
+  File f = LittleFS.open(path, "r");
+  if (!f)
+    return false;
+
+  StorageHeader hdr;
+  bool ok = f.read((uint8_t *)&hdr, sizeof(hdr)) == sizeof(hdr) &&
+            hdr.magic == STORAGE_MAGIC &&
+            f.size() == sizeof(hdr) + hdr.length;
+
+  uint32_t crc = crc32(&hdr.seq, sizeof(hdr.seq) + sizeof(hdr.length));
+  uint8_t chunk[64];
+  for (size_t left = hdr.length; ok && left > 0;) {
+    size_t n = left < sizeof(chunk) ? left : sizeof(chunk);
+    ok = f.read(chunk, n) == n;
+    crc = crc32(chunk, n, crc);
+    left -= n;
+  }
+  f.close();
+
+  return ok && crc == hdr.crc;
+}
+
+/**
+ * Write binary data atomically.
+ *
+ * The framed data goes to "<path>.tmp" first and replaces the file with a
+ * rename (atomic on LittleFS): after a power cut the file holds either
+ * the old or the new content, never a truncated one.
  */
 bool storageWrite(const char *path, const uint8_t *data, size_t length) {
+  char tmp[STORAGE_PATH_MAX];
+  if (!tmpPath(path, tmp))
+    return false;
 
-  debugPrintln(F("[STORAGE]"), "Writing file: " + String(path));
-  debugPrintln(F("[STORAGE]"), "Requested length: " + String(length));
+  debugPrintln(F("[STORAGE]"),
+               "Writing file: " + String(path) + " (" + String(length) +
+                   " bytes)");
 
-  File f = LittleFS.open(path, "w");
+  // Continue the sequence of the newest copy (including a leftover tmp)
+  StorageHeader hdr = {STORAGE_MAGIC, 0, (uint32_t)length, 0};
+  StorageHeader prev;
+  if (readHeader(path, prev))
+    hdr.seq = prev.seq;
+  if (readHeader(tmp, prev) && prev.seq > hdr.seq) {
+    hdr.seq = prev.seq;
+    // storageRead() returns this copy: commit it before the tmp file is
+    // reused, or a cut during this write would go back to the older one
+    if (frameIsValid(tmp) && !LittleFS.rename(tmp, path))
+      return false;
+  }
+  hdr.seq++;
+  hdr.crc = frameCrc(hdr, data, length);
+
+  File f = LittleFS.open(tmp, "w");
   if (!f) {
     debugPrintln(F("[STORAGE]"), F("ERROR: Failed to open file for writing."));
     return false;
   }
 
-  size_t writtenBytes = f.write(data, length);
+  size_t writtenBytes = f.write((const uint8_t *)&hdr, sizeof(hdr));
+  writtenBytes += f.write(data, length);
   f.close();
 
-  debugPrintln(F("[STORAGE]"), "Bytes written: " + String(writtenBytes));
-
-  if (writtenBytes != length) {
+  if (writtenBytes != sizeof(hdr) + length) {
     debugPrintln(
         F("[STORAGE]"),
         F("ERROR: Incomplete write — storage full or filesystem error."));
+    LittleFS.remove(tmp);
+    return false;
+  }
+
+  // Commit point
+  if (!LittleFS.rename(tmp, path)) {
+    debugPrintln(F("[STORAGE]"), F("ERROR: Failed to commit file."));
     return false;
   }
 
-  debugPrintln(F("[STORAGE]"), F("Write completed successfully."));
   return true;
 }
 
 /**
- * Read binary data from storage using LittleFS.
- * Returns false if the file does not exist or if the size does not match.
+ * Read binary data written by storageWrite().
+ *
+ * The payload must match the requested length and its CRC. If the file is
+ * damaged, a complete "<path>.tmp" left by an interrupted commit is used
+ * instead. Files written before framing was introduced are read raw.
  */
 bool storageRead(const char *path, uint8_t *buffer, size_t length) {
+  char tmp[STORAGE_PATH_MAX];
+  if (!tmpPath(path, tmp))
+    return false;
+
+  StorageHeader mainHdr, tmpHdr;
+  bool hasMain = readHeader(path, mainHdr);
+  bool hasTmp = readHeader(tmp, tmpHdr);
+
+  // Newest valid copy first
+  if (hasTmp && (!hasMain || tmpHdr.seq > mainHdr.seq)) {
+    if (readFramed(tmp, buffer, length))
+      return true;
+    debugPrintln(F("[STORAGE]"), "Ignoring damaged " + String(tmp));
+  }
+
+  if (hasMain) {
+    if (readFramed(path, buffer, length))
+      return true;
 
-  debugPrintln(F("[STORAGE]"), "Reading file: " + String(path) +
-                                   " into buffer of length " + String(length));
+    debugPrintln(F("[STORAGE]"), "ERROR: CRC or size mismatch: " +
+                                     String(path));
+    return hasTmp && tmpHdr.seq <= mainHdr.seq &&
+           readFramed(tmp, buffer, length);
+  }
 
   if (!LittleFS.exists(path)) {
-    debugPrintln(F("[STORAGE]"), F("File does not exist."));
+    debugPrintln(F("[STORAGE]"), "File does not exist: " + String(path));
     return false;
   }
 
+  // Legacy unframed file
   File f = LittleFS.open(path, "r");
   if (!f) {
     debugPrintln(F("[STORAGE]"), F("ERROR: Failed to open file."));
@@ -59,9 +213,6 @@ bool storageRead(const char *path, uint8_t *buffer, size_t length) {
   size_t readBytes = f.read(buffer, length);
   f.close();
 
-  debugPrintln(F("[STORAGE]"), "Requested length: " + String(length));
-  debugPrintln(F("[STORAGE]"), "Bytes read:      " + String(readBytes));
-
   if (readBytes != length) {
     debugPrintln(
         F("[STORAGE]"),
@@ -69,6 +220,249 @@ bool storageRead(const char *path, uint8_t *buffer, size_t length) {
     return false;
   }
 
-  debugPrintln(F("[STORAGE]"), F("Read completed successfully."));
+  debugPrintln(F("[STORAGE]"), "Read legacy file: " + String(path));
   return true;
 }
+
+/**
+ * @brief Writes one chunk at its offset, zero-filling any gap past EOF.
+ */
+static bool writeChunk(File &f, const StorageChunk &chunk) {
+  size_t size = f.size();
+
+  if (chunk.offset > size) {
+    static const uint8_t zeros[32] = {0};
+
+    if (!f.seek(size, SeekSet))
+      return false;
+
+    size_t gap = chunk.offset - size;
+    while (gap > 0) {
+      size_t n = gap < sizeof(zeros) ? gap : sizeof(zeros);
+      if (f.write(zeros, n) != n)
+        return false;
+      gap -= n;
+    }
+  } else if (!f.seek(chunk.offset, SeekSet)) {
+    return false;
+  }
+
+  return f.write(chunk.data, chunk.length) == chunk.length;
+}
+
+/**
+ * Overwrite byte ranges of a file in place ("r+" keeps the content),
+ * creating the file if needed. All chunks share one open/close, so the
+ * filesystem commits them together.
+ */
+bool storageWriteChunks(const char *path, const StorageChunk *chunks,
+                        size_t count) {
+
+  debugPrintln(F("[STORAGE]"), "Updating " + String(count) +
+                                   " chunk(s) in " + String(path));
+
+  File f = LittleFS.open(path, LittleFS.exists(path) ? "r+" : "w+");
+  if (!f) {
+    debugPrintln(F("[STORAGE]"), F("ERROR: Failed to open file for update."));
+    return false;
+  }
+
+  bool ok = true;
+  for (size_t i = 0; i < count && ok; i++)
+    ok = writeChunk(f, chunks[i]);
+
+  f.close();
+
+  if (!ok) {
+    debugPrintln(
+        F("[STORAGE]"),
+        F("ERROR: Incomplete write — storage full or filesystem error."));
+  }
+
+  return ok;
+}
+
+/**
+ * Overwrite a single byte range of a file.
+ */
+bool storageWriteAt(const char *path, size_t offset, const uint8_t *data,
+                    size_t length) {
+  StorageChunk chunk = {offset, data, length};
+  return storageWriteChunks(path, &chunk, 1);
+}
+
+/**
+ * Append to the end of a file.
+ */
+bool storageAppend(const char *path, const uint8_t *data, size_t length) {
+  File f = LittleFS.open(path, "a");
+  if (!f) {
+    debugPrintln(F("[STORAGE]"), F("ERROR: Failed to open file for append."));
+    return false;
+  }
+
+  size_t writtenBytes = f.write(data, length);
+  f.close();
+
+  return writtenBytes == length;
+}
+
+/**
+ * Read a byte range of a file.
+ */
+bool storageReadAt(const char *path, size_t offset, uint8_t *buffer,
+                   size_t length) {
+
+  File f = LittleFS.open(path, "r");
+  if (!f) {
+    debugPrintln(F("[STORAGE]"), "File does not exist: " + String(path));
+    return false;
+  }
+
+  if (!f.seek(offset, SeekSet)) {
+    f.close();
+    return false;
+  }
+
+  size_t readBytes = f.read(buffer, length);
+  f.close();
+
+  if (readBytes != length) {
+    debugPrintln(F("[STORAGE]"),
+                 F("ERROR: Incomplete read — record beyond end of file."));
+    return false;
+  }
+
+  return true;
+}
+
+/**
+ * Delete a file (and a leftover temporary copy); a missing file is not an
+ * error.
+ */
+bool storageRemove(const char *path) {
+  char tmp[STORAGE_PATH_MAX];
+  if (tmpPath(path, tmp) && LittleFS.exists(tmp))
+    LittleFS.remove(tmp);
+
+  if (!LittleFS.exists(path))
+    return true;
+
+  debugPrintln(F("[STORAGE]"), "Removing file: " + String(path));
+  return LittleFS.remove(path);
+}
+
+/**
+ * Rename a file; an existing destination is replaced.
+ */
+bool storageRename(const char *from, const char *to) {
+  return LittleFS.rename(from, to);
+}
+
+/**
+ * Size of a file in bytes (0 if it does not exist).
+ */
+size_t storageSize(const char *path) {
+  if (!LittleFS.exists(path))
+    return 0;
+
+  File f = LittleFS.open(path, "r");
+  if (!f)
+    return 0;
+
+  size_t size = f.size();
+  f.close();
+  return size;
+}
+
+/**
+ * Runs one deferred flush; a failed one stays pending and is retried
+ * after the quiet period.
+ */
+static bool deferRun(DeferEntry &e) {
+  if (e.flush()) {
+    deferStats.written++;
+    memset(&e, 0, sizeof(DeferEntry));
+    return true;
+  }
+
+  deferStats.failed++;
+  e.firstDirty = e.lastDirty = millis();
+  return false;
+}
+
+/**
+ * Mark the data of a module dirty; the flush runs from storageLoop().
+ */
+bool storageDefer(StorageFlushFn flush) {
+  deferStats.requested++;
+
+  DeferEntry *e = nullptr;
+  DeferEntry *slot = nullptr;
+  for (size_t i = 0; i < STORAGE_DEFER_SLOTS && !e; i++) {
+    if (deferred[i].flush == flush)
+      e = &deferred[i];
+    else if (!deferred[i].flush && !slot)
+      slot = &deferred[i];
+  }
+
+  unsigned long now = millis();
+
+  if (e) {
+    deferStats.avoided++;
+    e->lastDirty = now;
+    return true;
+  }
+
+  if (!slot) {
+    bool ok = flush();
+    if (ok)
+      deferStats.written++;
+    else
+      deferStats.failed++;
+    return ok;
+  }
+
+  slot->flush = flush;
+  slot->firstDirty = slot->lastDirty = now;
+  return true;
+}
+
+/**
+ * Run the deferred flushes that have been quiet long enough or have
+ * waited for the maximum delay.
+ */
+void storageLoop() {
+  unsigned long now = millis();
+
+  for (size_t i = 0; i < STORAGE_DEFER_SLOTS; i++) {
+    DeferEntry &e = deferred[i];
+    if (!e.flush)
+      continue;
+
+    if (now - e.lastDirty >= STORAGE_FLUSH_QUIET_MS ||
+        now - e.firstDirty >= STORAGE_FLUSH_MAX_DELAY_MS)
+      deferRun(e);
+  }
+}
+
+bool storageFlush() {
+  bool ok = true;
+
+  for (size_t i = 0; i < STORAGE_DEFER_SLOTS; i++) {
+    if (deferred[i].flush)
+      ok = deferRun(deferred[i]) && ok;
+  }
+  return ok;
+}
+
+size_t storagePending() {
+  size_t n = 0;
+  for (size_t i = 0; i < STORAGE_DEFER_SLOTS; i++) {
+    if (deferred[i].flush)
+      n++;
+  }
+  return n;
+}
+
+const StorageDeferStats &storageDeferStats() { return deferStats; }
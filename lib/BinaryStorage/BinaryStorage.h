@@ -2,6 +2,49 @@
 
 #include <Arduino.h>
 
+/**
+ * @brief Number of modules that can have a deferred flush pending.
+ */
+#define STORAGE_DEFER_SLOTS 4
+
+/**
+ * @brief A deferred flush runs once its data has not changed for this long
+ * (milliseconds)...
+ */
+#define STORAGE_FLUSH_QUIET_MS 2000
+
+/**
+ * @brief ...or at the latest this long after the first pending change,
+ * even if the data keeps changing.
+ */
+#define STORAGE_FLUSH_MAX_DELAY_MS 30000
+
+/**
+ * @brief Writes the dirty data of a module to flash.
+ *
+ * @return false if the write failed (the flush is retried later)
+ */
+typedef bool (*StorageFlushFn)();
+
+/**
+ * @brief Deferred flush counters since boot.
+ */
+struct StorageDeferStats {
+  uint32_t requested; // storageDefer() calls
+  uint32_t written;   // flushes performed
+  uint32_t avoided;   // requests merged into a pending flush
+  uint32_t failed;    // flushes that failed (retried later)
+};
+
+/**
+ * @brief A byte range to write at a fixed file offset.
+ */
+struct StorageChunk {
+  size_t offset;
+  const uint8_t *data;
+  size_t length;
+};
+
 /**
  * @brief Initialize filesystem.
  * @return true if successful.
@@ -9,9 +52,16 @@
 bool storageInit();
 
 /**
- * @brief Write raw bytes to a file.
+ * @brief Write bytes to a file atomically.
+ *
+ * The file is stored with a header (sequence number, length, CRC32) and
+ * written to "<path>.tmp" first, then renamed over the old file. A power
+ * cut at any point leaves either the previous or the new content.
+ *
+ * Files written this way must be read with storageRead(), not with the
+ * offset-based functions below.
  *
- * @param path File path (ex: "/config.bin")
+ * @param path File path (ex: "/config.bin", at most 27 characters)
  * @param data Pointer to bytes to store
  * @param length Number of bytes to write
  *
@@ -20,12 +70,145 @@ bool storageInit();
 bool storageWrite(const char *path, const uint8_t *data, size_t length);
 
 /**
- * @brief Read raw bytes from a file.
+ * @brief Read bytes written by storageWrite().
+ *
+ * The stored length and CRC must match. The newest valid copy is used, so
+ * a complete temporary file left by an interrupted commit is picked up.
+ * Files from before the framed format are read raw, without a check.
  *
  * @param path File path
  * @param buffer Destination buffer (must be preallocated)
  * @param length Number of bytes to read
  *
- * @return true if read successfully and size matches
+ * @return true if read successfully and size and CRC match
  */
 bool storageRead(const char *path, uint8_t *buffer, size_t length);
+
+/**
+ * @brief Overwrite part of a raw file in place.
+ *
+ * Only the given byte range is rewritten; the rest of the file is left
+ * untouched. Not atomic: record files written this way carry their own
+ * per-record checks. Writing past the end of the file extends it, zero-filling
+ * any gap. A missing file is created. Used for fixed-size record files.
+ *
+ * @param path File path
+ * @param offset Byte offset of the first byte to write
+ * @param data Pointer to bytes to store
+ * @param length Number of bytes to write
+ *
+ * @return true if written successfully
+ */
+bool storageWriteAt(const char *path, size_t offset, const uint8_t *data,
+                    size_t length);
+
+/**
+ * @brief Overwrite several byte ranges of a file in one operation.
+ *
+ * Same semantics as storageWriteAt(), but the file is opened and closed
+ * once for all chunks.
+ *
+ * @param path File path
+ * @param chunks Byte ranges to write
+ * @param count Number of chunks
+ *
+ * @return true if every chunk was written successfully
+ */
+bool storageWriteChunks(const char *path, const StorageChunk *chunks,
+                        size_t count);
+
+/**
+ * @brief Append bytes to the end of a raw file (created if missing).
+ *
+ * Not atomic: an interrupted append may leave a partial record at the
+ * end, so journal files must carry per-record checks.
+ *
+ * @param path File path
+ * @param data Pointer to bytes to append
+ * @param length Number of bytes
+ *
+ * @return true if all bytes were appended
+ */
+bool storageAppend(const char *path, const uint8_t *data, size_t length);
+
+/**
+ * @brief Read part of a file.
+ *
+ * @param path File path
+ * @param offset Byte offset of the first byte to read
+ * @param buffer Destination buffer (must be preallocated)
+ * @param length Number of bytes to read
+ *
+ * @return true if the whole range was read
+ */
+bool storageReadAt(const char *path, size_t offset, uint8_t *buffer,
+                   size_t length);
+
+/**
+ * @brief Delete a file if it exists (and its leftover temporary copy).
+ *
+ * @param path File path
+ *
+ * @return true if the file no longer exists
+ */
+bool storageRemove(const char *path);
+
+/**
+ * @brief Rename a file, replacing the destination (atomic on LittleFS).
+ *
+ * @param from Current path
+ * @param to New path
+ *
+ * @return true if renamed
+ */
+bool storageRename(const char *from, const char *to);
+
+/**
+ * @brief Size of a file in bytes.
+ *
+ * @param path File path
+ *
+ * @return File size, or 0 if the file does not exist
+ */
+size_t storageSize(const char *path);
+
+/**
+ * @brief Schedule a flush of data a module keeps dirty in RAM.
+ *
+ * The module tracks what changed and writes it in `flush`; this layer
+ * only decides when. The flush runs from storageLoop() once no request
+ * came for STORAGE_FLUSH_QUIET_MS, or STORAGE_FLUSH_MAX_DELAY_MS after
+ * the first pending request. Requests in between are merged into one
+ * write.
+ *
+ * A power loss drops at most the last STORAGE_FLUSH_MAX_DELAY_MS of
+ * changes; call storageFlush() before any intentional restart.
+ *
+ * @param flush Flush function of the module (identifies the data)
+ *
+ * @return true if the flush was scheduled; without a free slot it runs
+ * immediately and its result is returned
+ */
+bool storageDefer(StorageFlushFn flush);
+
+/**
+ * @brief Runs the deferred flushes that are due. Call from the main loop.
+ */
+void storageLoop();
+
+/**
+ * @brief Runs every pending deferred flush now.
+ *
+ * @return true if nothing is left pending
+ */
+bool storageFlush();
+
+/**
+ * @brief Number of deferred flushes waiting to run.
+ */
+size_t storagePending();
+
+/**
+ * @brief Deferred flush counters since boot.
+ */
+const StorageDeferStats &storageDeferStats();
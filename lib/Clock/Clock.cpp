@@ -0,0 +1,428 @@
+#include "Clock.h"
+#include <coredecls.h>
+#include <ctype.h>
+#include <sys/time.h>
+#include <time.h>
+
+#include <BinaryStorage.h>
+#include <Debug.h>
+#include <KvStore.h>
+
+/* Timezone file of older firmware, migrated to KvKeyClockTz */
+#define CLOCK_TZ_LEGACY_PATH "/clock_tz.bin"
+
+/*
+ * The wall clock is an anchor (NTP time and monotonic time of the last
+ * sync) plus the monotonic time elapsed since, scaled by the estimated
+ * drift of the local oscillator. Each sync measures how far the estimate
+ * was off; that offset over the sync interval is the residual rate error,
+ * folded into the drift correction.
+ */
+static bool anchored = false;
+static int64_t anchorWallUs = 0;
+static uint64_t anchorMonoUs = 0;
+static int32_t driftPpb = 0;
+
+/* Sync sample captured by the SNTP callback, processed in clockLoop() */
+static volatile bool samplePending = false;
+static int64_t sampleWallUs = 0;
+static uint64_t sampleMonoUs = 0;
+
+static ClockStats stats;
+
+/*
+ * Timezone: the UTC offset periods of the current and next year, found
+ * once by probing localtime_r(). Conversions within [tzRangeStart,
+ * tzRangeEnd) are a binary search plus an add.
+ */
+struct TzSpan {
+  int64_t start;  // first UTC second of the period
+  int32_t offset; // local = UTC + offset
+  bool isDst;
+};
+
+static char tzString[CLOCK_TZ_MAX_LEN] = CLOCK_DEFAULT_TZ;
+static TzSpan tzSpans[CLOCK_TZ_MAX_SPANS];
+static uint8_t tzSpanCount = 0;
+static int64_t tzRangeStart = 0;
+static int64_t tzRangeEnd = 0;
+static int64_t tzRebuildAt = 0; // first second of the next year
+
+/**
+ * @brief Sync interval requested from the SDK's SNTP client.
+ *
+ * Weak hook of the ESP8266 core (the minimum it accepts is 15 s).
+ */
+uint32_t sntp_update_delay_MS_rfc_not_less_than_15000() {
+  return CLOCK_SYNC_INTERVAL_MS;
+}
+
+/**
+ * @brief Drift-corrected wall time (us) at a given monotonic time.
+ */
+static int64_t estimateWallUs(uint64_t monoUs) {
+  int64_t elapsedUs = (int64_t)(monoUs - anchorMonoUs);
+  // Scale in milliseconds first so that long gaps cannot overflow
+  return anchorWallUs + elapsedUs + (elapsedUs / 1000) * driftPpb / 1000000;
+}
+
+/**
+ * @brief Called by the core right after SNTP has set the system time.
+ *
+ * Runs outside the main loop: only the sample is stored.
+ */
+static void onTimeSet(bool fromSntp) {
+  if (!fromSntp)
+    return;
+
+  struct timeval tv;
+  gettimeofday(&tv, nullptr);
+
+  sampleMonoUs = micros64();
+  sampleWallUs = (int64_t)tv.tv_sec * 1000000 + tv.tv_usec;
+  samplePending = true;
+}
+
+/**
+ * @brief Days since 1970-01-01 of a proleptic Gregorian date.
+ */
+static int64_t daysFromCivil(int64_t y, int m, int d) {
+  y -= m <= 2;
+  int64_t era = (y >= 0 ? y : y - 399) / 400;
+  int64_t yoe = y - era * 400;
+  int64_t doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+  int64_t doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+  return era * 146097 + doe - 719468;
+}
+
+/**
+ * @brief Seconds since the epoch of a broken-down time read as UTC
+ * (out-of-range fields are normalized).
+ */
+static int64_t tmToSeconds(const struct tm &t) {
+  int64_t year = t.tm_year + 1900 + t.tm_mon / 12;
+  int mon = t.tm_mon % 12;
+  if (mon < 0) {
+    mon += 12;
+    year--;
+  }
+
+  int64_t days = daysFromCivil(year, mon + 1, 1) + t.tm_mday - 1;
+  return days * 86400 + t.tm_hour * 3600 + t.tm_min * 60 + t.tm_sec;
+}
+
+/**
+ * @brief UTC offset at an instant, evaluated by the C library.
+ */
+static int32_t probeOffset(int64_t t, bool *isDst = nullptr) {
+  time_t tt = (time_t)t;
+  struct tm lt;
+  localtime_r(&tt, &lt);
+
+  if (isDst)
+    *isDst = lt.tm_isdst > 0;
+  return (int32_t)(tmToSeconds(lt) - t);
+}
+
+/**
+ * @brief Precomputes the offset periods of a year and the next one.
+ *
+ * Offsets are probed once per day; each change is then located to the
+ * second by bisection. Runs when the timezone changes and once a year.
+ */
+static void buildTzTable(int year) {
+  int64_t start = (daysFromCivil(year, 1, 1) - 1) * 86400;
+  int64_t end = (daysFromCivil(year + 2, 1, 1) + 1) * 86400;
+
+  tzSpanCount = 1;
+  tzSpans[0].start = start;
+  tzSpans[0].offset = probeOffset(start, &tzSpans[0].isDst);
+
+  for (int64_t t = start; t < end; t += 86400) {
+    int64_t next = t + 86400;
+    if (probeOffset(next) == tzSpans[tzSpanCount - 1].offset)
+      continue;
+
+    // Transition in (t, next]: find its first second
+    int64_t lo = t, hi = next;
+    while (hi - lo > 1) {
+      int64_t mid = lo + (hi - lo) / 2;
+      if (probeOffset(mid) == tzSpans[tzSpanCount - 1].offset)
+        lo = mid;
+      else
+        hi = mid;
+    }
+
+    if (tzSpanCount == CLOCK_TZ_MAX_SPANS) {
+      // Unusual zone: cover as much as fits
+      end = hi;
+      break;
+    }
+
+    TzSpan &span = tzSpans[tzSpanCount++];
+    span.start = hi;
+    span.offset = probeOffset(hi, &span.isDst);
+  }
+
+  tzRangeStart = start;
+  tzRangeEnd = end;
+  tzRebuildAt = daysFromCivil(year + 1, 1, 1) * 86400;
+
+  debugPrintln(F("[CLOCK]"), "Timezone table for " + String(year) + ": " +
+                                 String(tzSpanCount) + " period(s)");
+}
+
+/**
+ * @brief Index of the offset period containing a UTC instant.
+ *
+ * @return Span index, or -1 outside the precomputed range
+ */
+static int findSpan(int64_t t) {
+  if (tzSpanCount == 0 || t < tzRangeStart || t >= tzRangeEnd)
+    return -1;
+
+  int lo = 0, hi = tzSpanCount - 1;
+  while (lo < hi) {
+    int mid = (lo + hi + 1) / 2;
+    if (tzSpans[mid].start <= t)
+      lo = mid;
+    else
+      hi = mid - 1;
+  }
+  return lo;
+}
+
+/**
+ * @brief Applies the current TZ string to the C library and rebuilds the
+ * offset table (once the year is known).
+ */
+static void applyTimezone() {
+  setenv("TZ", tzString, 1);
+  tzset();
+
+  tzSpanCount = 0;
+  if (anchored) {
+    time_t now = (time_t)(anchorWallUs / 1000000);
+    struct tm utc;
+    gmtime_r(&now, &utc);
+    buildTzTable(utc.tm_year + 1900);
+  }
+}
+
+/**
+ * @brief Rough sanity check of a POSIX TZ string.
+ */
+static bool timezoneIsValid(const char *tz) {
+  size_t len = tz ? strlen(tz) : 0;
+  if (len < 3 || len >= CLOCK_TZ_MAX_LEN)
+    return false;
+
+  if (!isalpha((unsigned char)tz[0]) && tz[0] != '<')
+    return false;
+
+  for (size_t i = 0; i < len; i++) {
+    if (!isprint((unsigned char)tz[i]) || tz[i] == ' ')
+      return false;
+  }
+  return true;
+}
+
+bool clockInit() {
+  char stored[CLOCK_TZ_MAX_LEN];
+
+  if (kvGetString(KvKeyClockTz, stored, sizeof(stored))) {
+    if (timezoneIsValid(stored))
+      strlcpy(tzString, stored, sizeof(tzString));
+  } else if (storageRead(CLOCK_TZ_LEGACY_PATH, (uint8_t *)stored,
+                         sizeof(stored))) {
+    // Move the timezone of older firmware into the config store
+    stored[sizeof(stored) - 1] = '\0';
+    if (timezoneIsValid(stored) && kvSetString(KvKeyClockTz, stored)) {
+      strlcpy(tzString, stored, sizeof(tzString));
+      storageRemove(CLOCK_TZ_LEGACY_PATH);
+    }
+  }
+
+  settimeofday_cb(onTimeSet);
+  configTime(tzString, CLOCK_NTP_SERVER_1, CLOCK_NTP_SERVER_2);
+
+  debugPrintln(F("[CLOCK]"), "SNTP started, TZ " + String(tzString));
+  return true;
+}
+
+bool clockSetTimezone(const char *tz) {
+  if (!timezoneIsValid(tz))
+    return false;
+
+  if (!kvSetString(KvKeyClockTz, tz))
+    return false;
+
+  strlcpy(tzString, tz, sizeof(tzString));
+  applyTimezone();
+
+  debugPrintln(F("[CLOCK]"), "Timezone set to " + String(tzString));
+  return true;
+}
+
+const char *clockTimezone() { return tzString; }
+
+int32_t clockUtcOffset(uint32_t epoch) {
+  int i = findSpan(epoch);
+  return i >= 0 ? tzSpans[i].offset : probeOffset(epoch);
+}
+
+void clockToLocal(uint32_t epoch, struct tm &out) {
+  int i = findSpan(epoch);
+
+  if (i < 0) {
+    time_t t = (time_t)epoch;
+    localtime_r(&t, &out);
+    return;
+  }
+
+  time_t local = (time_t)epoch + tzSpans[i].offset;
+  gmtime_r(&local, &out);
+  out.tm_isdst = tzSpans[i].isDst;
+}
+
+uint32_t clockFromLocal(const struct tm &local) {
+  int64_t l = tmToSeconds(local);
+
+  // Last period whose local start is not after l
+  int j = -1;
+  if (tzSpanCount > 0 && l - tzSpans[0].offset >= tzRangeStart) {
+    int lo = 0, hi = tzSpanCount - 1;
+    while (lo < hi) {
+      int mid = (lo + hi + 1) / 2;
+      if (tzSpans[mid].start + tzSpans[mid].offset <= l)
+        lo = mid;
+      else
+        hi = mid - 1;
+    }
+    j = lo;
+  }
+
+  if (j < 0 || l - tzSpans[j].offset >= tzRangeEnd) {
+    struct tm t = local;
+    t.tm_isdst = -1;
+    return (uint32_t)mktime(&t);
+  }
+
+  // Repeated hour (DST end): still inside the previous period
+  if (j > 0 && l < tzSpans[j].start + tzSpans[j - 1].offset)
+    return (uint32_t)(l - tzSpans[j - 1].offset);
+
+  int64_t t = l - tzSpans[j].offset;
+
+  // Skipped hour (DST start): resolve to the transition
+  if (j + 1 < tzSpanCount && t >= tzSpans[j + 1].start)
+    return (uint32_t)tzSpans[j + 1].start;
+
+  return (uint32_t)t;
+}
+
+/**
+ * @brief Measures the offset of the local estimate and re-anchors.
+ */
+static void applySample(int64_t wallUs, uint64_t monoUs) {
+  if (anchored) {
+    int64_t offsetUs = wallUs - estimateWallUs(monoUs);
+    int64_t intervalUs = (int64_t)(monoUs - anchorMonoUs);
+    uint32_t absOffsetMs = (uint32_t)(llabs(offsetUs) / 1000);
+
+    stats.lastOffsetMs = (int32_t)(offsetUs / 1000);
+
+    if (absOffsetMs > CLOCK_STEP_THRESHOLD_MS) {
+      stats.steps++;
+      debugPrintln(F("[CLOCK]"), "Clock stepped by " +
+                                     String(stats.lastOffsetMs) + " ms");
+    } else {
+      if (absOffsetMs > stats.maxOffsetMs)
+        stats.maxOffsetMs = absOffsetMs;
+      stats.avgOffsetMs = stats.avgOffsetMs == 0
+                              ? absOffsetMs
+                              : (stats.avgOffsetMs * 7 + absOffsetMs) / 8;
+
+      if (intervalUs >= (int64_t)CLOCK_DRIFT_MIN_INTERVAL_SEC * 1000000) {
+        // Residual rate error; damped so one noisy sample cannot dominate
+        int64_t errPpb = offsetUs * 1000000000LL / intervalUs;
+        int64_t drift = driftPpb + errPpb / 2;
+        int64_t limit = (int64_t)CLOCK_DRIFT_MAX_PPM * 1000;
+
+        if (drift > limit)
+          drift = limit;
+        if (drift < -limit)
+          drift = -limit;
+        driftPpb = (int32_t)drift;
+      }
+    }
+  }
+
+  anchorWallUs = wallUs;
+  anchorMonoUs = monoUs;
+
+  // The year is known from the first sync on
+  if (!anchored) {
+    anchored = true;
+    applyTimezone();
+  }
+
+  stats.syncs++;
+  stats.lastSyncEpoch = (uint32_t)(wallUs / 1000000);
+  stats.driftPpb = driftPpb;
+
+  debugPrintf(F("[CLOCK]"), "Synced, offset=%ld ms drift=%ld ppb",
+              (long)stats.lastOffsetMs, (long)driftPpb);
+}
+
+void clockLoop() {
+  // New year: move the offset table forward
+  if (anchored && tzSpanCount > 0 && clockNow() >= tzRebuildAt)
+    applyTimezone();
+
+  if (!samplePending)
+    return;
+
+  noInterrupts();
+  int64_t wallUs = sampleWallUs;
+  uint64_t monoUs = sampleMonoUs;
+  samplePending = false;
+  interrupts();
+
+  applySample(wallUs, monoUs);
+}
+
+uint64_t clockMonoMs() { return micros64() / 1000; }
+
+uint64_t clockNowMs() {
+  if (!anchored)
+    return 0;
+  return (uint64_t)(estimateWallUs(micros64()) / 1000);
+}
+
+uint32_t clockNow() { return (uint32_t)(clockNowMs() / 1000); }
+
+bool clockValid() { return anchored; }
+
+ClockQuality clockQuality() {
+  if (!anchored)
+    return ClockUnsynced;
+
+  uint64_t ageMs = (micros64() - anchorMonoUs) / 1000;
+  return ageMs > (uint64_t)CLOCK_STALE_SEC * 1000 ? ClockStale : ClockSynced;
+}
+
+const ClockStats &clockStats() { return stats; }
+
+String clockQualityToString(uint8_t quality) {
+  switch (quality) {
+  case ClockUnsynced:
+    return "Unsynced";
+  case ClockSynced:
+    return "Synced";
+  case ClockStale:
+    return "Stale";
+  default:
+    return "Unknown";
+  }
+}
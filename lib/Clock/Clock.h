@@ -0,0 +1,192 @@
+#pragma once
+
+#include <Arduino.h>
+#include <time.h>
+
+/**
+ * @brief NTP servers queried by the SDK's SNTP client.
+ */
+#define CLOCK_NTP_SERVER_1 "pool.ntp.org"
+#define CLOCK_NTP_SERVER_2 "time.google.com"
+
+/**
+ * @brief Timezone used until one is set through the API (POSIX TZ string,
+ * Central European Time with EU daylight-saving rules).
+ */
+#define CLOCK_DEFAULT_TZ "CET-1CEST,M3.5.0,M10.5.0/3"
+
+/**
+ * @brief Maximum length of a timezone string (including terminator).
+ */
+#define CLOCK_TZ_MAX_LEN 48
+
+/**
+ * @brief Maximum number of UTC offset periods in the precomputed table
+ * (two years of a zone with two transitions per year need five).
+ */
+#define CLOCK_TZ_MAX_SPANS 8
+
+/**
+ * @brief Interval between SNTP synchronizations, in milliseconds.
+ *
+ * The local clock is drift corrected between syncs, so it does not need
+ * to be short.
+ */
+#define CLOCK_SYNC_INTERVAL_MS 3600000UL
+
+/**
+ * @brief Without a sync for this long (in seconds) the clock is reported
+ * as stale. It keeps running on the drift-corrected estimate.
+ */
+#define CLOCK_STALE_SEC 14400UL
+
+/**
+ * @brief Offsets larger than this (in milliseconds) are treated as a
+ * clock step rather than drift, and do not update the drift estimate.
+ */
+#define CLOCK_STEP_THRESHOLD_MS 1000
+
+/**
+ * @brief Minimum time between two syncs (in seconds) for the offset to
+ * be used as a drift sample; shorter intervals are dominated by network
+ * jitter.
+ */
+#define CLOCK_DRIFT_MIN_INTERVAL_SEC 600
+
+/**
+ * @brief Largest drift correction applied, in parts per million.
+ */
+#define CLOCK_DRIFT_MAX_PPM 500
+
+/**
+ * @brief Quality of the wall clock.
+ *
+ * - ClockUnsynced: No sync yet, the wall clock is unknown
+ * - ClockSynced: Synchronized within CLOCK_STALE_SEC
+ * - ClockStale: Last sync older than CLOCK_STALE_SEC (estimate only)
+ */
+enum ClockQuality { ClockUnsynced = 0, ClockSynced, ClockStale };
+
+/**
+ * @brief Synchronization statistics.
+ */
+struct ClockStats {
+  uint32_t syncs;         // SNTP syncs received
+  uint32_t steps;         // syncs whose offset exceeded the step threshold
+  uint32_t lastSyncEpoch; // wall time of the last sync (0 = never)
+  int32_t lastOffsetMs;   // NTP time minus local estimate at the last sync
+  uint32_t maxOffsetMs;   // largest absolute drift offset seen
+  uint32_t avgOffsetMs;   // moving average of absolute drift offsets
+  int32_t driftPpb;       // current rate correction (parts per billion)
+};
+
+/**
+ * @brief Starts SNTP (non-blocking) and registers the sync callback.
+ *
+ * Applies the persisted timezone (CLOCK_DEFAULT_TZ if none). The wall
+ * clock becomes valid on the first successful sync; until then clockNow()
+ * returns 0.
+ *
+ * @return true if initialization was successful
+ */
+bool clockInit();
+
+/**
+ * @brief Processes a pending sync sample (offset and drift update).
+ *
+ * Cheap when no sync happened; call it from the main loop.
+ */
+void clockLoop();
+
+/**
+ * @brief Monotonic time since boot, in milliseconds.
+ *
+ * Never wraps and never jumps; use it for timeouts and intervals.
+ */
+uint64_t clockMonoMs();
+
+/**
+ * @brief Current UTC time in milliseconds since the epoch.
+ *
+ * Derived from the monotonic clock anchored at the last sync and
+ * corrected by the estimated drift.
+ *
+ * @return Epoch milliseconds, or 0 if the clock was never synchronized
+ */
+uint64_t clockNowMs();
+
+/**
+ * @brief Current UTC time in seconds since the epoch.
+ *
+ * @return Epoch seconds, or 0 if the clock was never synchronized
+ */
+uint32_t clockNow();
+
+/**
+ * @brief Whether the wall clock was synchronized at least once.
+ */
+bool clockValid();
+
+/**
+ * @brief Current clock quality.
+ */
+ClockQuality clockQuality();
+
+/**
+ * @brief Synchronization statistics.
+ */
+const ClockStats &clockStats();
+
+/**
+ * @brief Converts a ClockQuality value to its string representation.
+ *
+ * @param quality The ClockQuality value
+ * @return "Unsynced", "Synced", "Stale" or "Unknown"
+ */
+String clockQualityToString(uint8_t quality);
+
+/**
+ * @brief Sets, applies and persists the timezone.
+ *
+ * The UTC offset transitions of the current and next year are computed
+ * once here, so later conversions need no TZ rule evaluation.
+ *
+ * @param tz POSIX TZ string (e.g. "CET-1CEST,M3.5.0,M10.5.0/3", "UTC0")
+ * @return false if the string is invalid or could not be stored
+ */
+bool clockSetTimezone(const char *tz);
+
+/**
+ * @brief Returns the active POSIX TZ string.
+ */
+const char *clockTimezone();
+
+/**
+ * @brief UTC offset (in seconds, east positive) in effect at an epoch.
+ */
+int32_t clockUtcOffset(uint32_t epoch);
+
+/**
+ * @brief Converts an epoch to broken-down local time.
+ *
+ * Within the precomputed range this is a binary search over the offset
+ * table plus a UTC conversion; outside it, localtime_r() is used.
+ *
+ * @param epoch UTC epoch
+ * @param out Local time
+ */
+void clockToLocal(uint32_t epoch, struct tm &out);
+
+/**
+ * @brief Converts broken-down local time to an epoch (mktime()
+ * replacement).
+ *
+ * Fields may be out of range (e.g. tm_mday 32, tm_hour 24) and are
+ * normalized. A local time that occurs twice (DST end) resolves to the
+ * earlier instant; one that does not exist (DST start) resolves to the
+ * transition instant. tm_isdst and tm_wday are ignored.
+ *
+ * @param local Local time
+ * @return UTC epoch
+ */
+uint32_t clockFromLocal(const struct tm &local);
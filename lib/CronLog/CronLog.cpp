@@ -0,0 +1,154 @@
+#include "CronLog.h"
+
+#include <Debug.h>
+
+#ifdef CRON_LOG_PERSIST
+#include <BinaryStorage.h>
+
+#define CRON_LOG_PATH "/cron_log.bin"
+#define CRON_LOG_MAGIC 0x474C5243 // "CRLG"
+
+/**
+ * @brief Flash image of the ring.
+ */
+struct CronLogFile {
+  uint32_t magic;
+  uint16_t head;
+  uint16_t count;
+  CronLogEntry entries[CRON_LOG_SIZE];
+};
+
+static bool logDirty = false;
+static unsigned long lastPersist = 0;
+#endif
+
+static CronLogEntry ring[CRON_LOG_SIZE];
+static uint16_t ringHead = 0; // next write position
+static uint16_t ringCount = 0;
+
+static CronJobStats jobStats[MAX_CRON_JOBS];
+
+static void saturatingInc(uint16_t &counter) {
+  if (counter < UINT16_MAX)
+    counter++;
+}
+
+void cronLogInit() {
+  cronLogClear();
+
+#ifdef CRON_LOG_PERSIST
+  CronLogFile file;
+  if (storageRead(CRON_LOG_PATH, (uint8_t *)&file, sizeof(file)) &&
+      file.magic == CRON_LOG_MAGIC && file.head < CRON_LOG_SIZE &&
+      file.count <= CRON_LOG_SIZE) {
+    memcpy(ring, file.entries, sizeof(ring));
+    ringHead = file.head;
+    ringCount = file.count;
+
+    debugPrintln(F("[CRON]"), "Restored " + String(ringCount) +
+                                  " execution log entries");
+  }
+  lastPersist = millis();
+#endif
+}
+
+void cronLogFlush() {
+#ifdef CRON_LOG_PERSIST
+  if (!logDirty)
+    return;
+
+  CronLogFile file;
+  file.magic = CRON_LOG_MAGIC;
+  file.head = ringHead;
+  file.count = ringCount;
+  memcpy(file.entries, ring, sizeof(ring));
+
+  if (storageWrite(CRON_LOG_PATH, (uint8_t *)&file, sizeof(file)))
+    logDirty = false;
+  lastPersist = millis();
+#endif
+}
+
+void cronLogLoop() {
+#ifdef CRON_LOG_PERSIST
+  if (logDirty && millis() - lastPersist >= CRON_LOG_PERSIST_INTERVAL_MS)
+    cronLogFlush();
+#endif
+}
+
+void cronLogRecord(uint16_t job, uint8_t action, uint32_t scheduledEpoch,
+                   uint32_t latenessMs, uint8_t result) {
+  CronLogEntry &e = ring[ringHead];
+  e.scheduledEpoch = scheduledEpoch;
+  e.latenessMs = latenessMs;
+  e.job = job;
+  e.action = action;
+  e.result = result;
+
+  ringHead = (ringHead + 1) % CRON_LOG_SIZE;
+  if (ringCount < CRON_LOG_SIZE)
+    ringCount++;
+
+#ifdef CRON_LOG_PERSIST
+  logDirty = true;
+#endif
+
+  if (job >= MAX_CRON_JOBS)
+    return;
+
+  CronJobStats &s = jobStats[job];
+  switch (result) {
+  case CronRunOk:
+    saturatingInc(s.runs);
+    break;
+  case CronRunMissed:
+    saturatingInc(s.misses);
+    break;
+  default:
+    saturatingInc(s.failures);
+    break;
+  }
+
+  if (result != CronRunMissed && latenessMs > s.maxLatenessMs)
+    s.maxLatenessMs = latenessMs;
+}
+
+void cronLogResetJob(uint16_t job) {
+  if (job < MAX_CRON_JOBS)
+    memset(&jobStats[job], 0, sizeof(CronJobStats));
+}
+
+void cronLogClear() {
+  memset(ring, 0, sizeof(ring));
+  memset(jobStats, 0, sizeof(jobStats));
+  ringHead = 0;
+  ringCount = 0;
+}
+
+const CronLogEntry *cronLogEntry(size_t index) {
+  if (index >= ringCount)
+    return nullptr;
+
+  return &ring[(ringHead + CRON_LOG_SIZE - 1 - index) % CRON_LOG_SIZE];
+}
+
+size_t cronLogCount() { return ringCount; }
+
+const CronJobStats *cronLogJobStats(uint16_t job) {
+  return job < MAX_CRON_JOBS ? &jobStats[job] : nullptr;
+}
+
+String cronRunResultToString(uint8_t result) {
+  switch (result) {
+  case CronRunOk:
+    return "Ok";
+  case CronRunFailed:
+    return "Failed";
+  case CronRunMissed:
+    return "Missed";
+  case CronRunUnreadable:
+    return "Unreadable";
+  default:
+    return "Unknown";
+  }
+}
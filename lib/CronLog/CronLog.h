@@ -0,0 +1,133 @@
+#pragma once
+
+#include <Arduino.h>
+#include <CronScheduler.h>
+
+/**
+ * @brief Number of executions kept in the RAM ring.
+ */
+#ifndef CRON_LOG_SIZE
+#define CRON_LOG_SIZE 32
+#endif
+
+/**
+ * @brief Define (e.g. -DCRON_LOG_PERSIST) to mirror the ring to flash.
+ *
+ * The mirror is written at most every CRON_LOG_PERSIST_INTERVAL_MS and
+ * only when new entries were added, plus right before a Reboot action.
+ * Per-job aggregates are not persisted.
+ */
+#ifndef CRON_LOG_PERSIST_INTERVAL_MS
+#define CRON_LOG_PERSIST_INTERVAL_MS 600000UL
+#endif
+
+/**
+ * @brief Action value logged when the job record could not be read.
+ */
+#define CRON_LOG_NO_ACTION 0xFF
+
+/**
+ * @brief Outcome of a scheduled occurrence.
+ *
+ * - CronRunOk: The action was executed successfully
+ * - CronRunFailed: The action was rejected (e.g. deviceSet() failed,
+ *   HTTP queue full)
+ * - CronRunMissed: Skipped by the misfire policy
+ * - CronRunUnreadable: The job record could not be read from flash
+ */
+enum CronRunResult {
+  CronRunOk = 0,
+  CronRunFailed,
+  CronRunMissed,
+  CronRunUnreadable
+};
+
+/**
+ * @brief One logged occurrence.
+ *
+ * The actual execution time is `scheduledEpoch` plus `latenessMs`.
+ */
+struct CronLogEntry {
+  uint32_t scheduledEpoch; // occurrence time (UTC epoch)
+  uint32_t latenessMs;     // execution (or skip) time minus occurrence
+  uint16_t job;            // slot index
+  uint8_t action;          // CronAction
+  uint8_t result;          // CronRunResult
+};
+
+/**
+ * @brief Per-job aggregates since boot or since the job was last set.
+ *
+ * Counters saturate at 65535.
+ */
+struct CronJobStats {
+  uint16_t runs;     // successful executions
+  uint16_t failures; // rejected or unreadable
+  uint16_t misses;   // occurrences skipped by the misfire policy
+  uint32_t maxLatenessMs;
+};
+
+/**
+ * @brief Initializes the log (and loads the flash mirror if enabled).
+ */
+void cronLogInit();
+
+/**
+ * @brief Writes the flash mirror when due; no-op without CRON_LOG_PERSIST.
+ */
+void cronLogLoop();
+
+/**
+ * @brief Writes the flash mirror now if it has unsaved entries.
+ */
+void cronLogFlush();
+
+/**
+ * @brief Appends an occurrence and updates the job aggregates.
+ *
+ * @param job Slot index
+ * @param action CronAction of the job
+ * @param scheduledEpoch Occurrence time
+ * @param latenessMs Time between the occurrence and the execution
+ * @param result CronRunResult
+ */
+void cronLogRecord(uint16_t job, uint8_t action, uint32_t scheduledEpoch,
+                   uint32_t latenessMs, uint8_t result);
+
+/**
+ * @brief Clears the aggregates of a job (the job was replaced).
+ */
+void cronLogResetJob(uint16_t job);
+
+/**
+ * @brief Clears the ring and all aggregates.
+ */
+void cronLogClear();
+
+/**
+ * @brief Returns a logged occurrence, newest first.
+ *
+ * @param index 0 = most recent
+ * @return nullptr if index >= cronLogCount()
+ */
+const CronLogEntry *cronLogEntry(size_t index);
+
+/**
+ * @brief Number of occurrences in the ring.
+ */
+size_t cronLogCount();
+
+/**
+ * @brief Aggregates of a job slot.
+ *
+ * @return nullptr if the index is out of range
+ */
+const CronJobStats *cronLogJobStats(uint16_t job);
+
+/**
+ * @brief Converts a CronRunResult value to its string representation.
+ *
+ * @param result The CronRunResult value
+ * @return "Ok", "Failed", "Missed", "Unreadable" or "Unknown"
+ */
+String cronRunResultToString(uint8_t result);
@@ -1,18 +1,118 @@
 #include "CronScheduler.h"
 #include <BinaryStorage.h>
+#include <Clock.h>
+#include <CronLog.h>
+#include <Debug.h>
 #include <DeviceController.h>
-#include <ESP8266HTTPClient.h>
-#include <NTPClient.h>
-#include <WiFiUdp.h>
+#include <HttpQueue.h>
+#include <Solar.h>
+#include <coredecls.h>
 
-WiFiUDP ntpUDP;
-NTPClient timeClient(ntpUDP);
-static HTTPClient http;
+/*
+ * Job table file layout:
+ *
+ *   CronFileHeader | CronRecord[0] | CronRecord[1] | ... | CronRecord[N-1]
+ *
+ * Every record has a fixed size and its own CRC, so a single job update
+ * rewrites one record in place and a damaged record only loses its slot.
+ * The file only grows as far as the highest slot ever written; slots past
+ * its end, or zero-filled by a later write, are empty.
+ */
+#define STORAGE_PATH "/cron_jobs.bin"
+#define CRON_FILE_MAGIC 0x4E4F5243 // "CRON"
+#define CRON_FILE_VERSION 1
+
+struct CronFileHeader {
+  uint32_t magic;
+  uint16_t version;
+  uint16_t recordSize;
+  uint32_t slots;
+};
+
+struct CronRecord {
+  CronJob job;
+  uint32_t crc;
+};
+
+#define RECORD_OFFSET(i)                                                       \
+  (sizeof(CronFileHeader) + (size_t)(i) * sizeof(CronRecord))
+
+/* Records read per storage access while building the index at boot */
+#define CRON_LOAD_BATCH 8
 
-#define STORAGE_PATH "/cron_state.bin"
-#define FILE_SIZE sizeof(CronJob) * MAX_CRON_JOBS
+/* New job table written by an import, renamed over STORAGE_PATH */
+#define IMPORT_STORAGE_PATH "/cron_import.bin"
 
-static CronJob cronJobsState[MAX_CRON_JOBS];
+/* Raw 32-slot job table written by earlier firmware (migrated on boot) */
+#define LEGACY_STORAGE_PATH "/cron_state.bin"
+#define LEGACY_SLOTS 32
+#define LEGACY_FILE_SIZE sizeof(CronJob) * LEGACY_SLOTS
+
+/**
+ * @brief Job layout written by firmware without HttpRequest support.
+ *
+ * Only used to migrate an existing /cron_state.bin on first boot.
+ */
+struct CronJobV1 {
+  bool active;
+  char cron[32];
+  CronAction action;
+  uint8_t pin;
+  uint8_t misfirePolicy;
+  uint8_t misfireLimit;
+  int value;
+  uint32_t lastExecEpoch;
+};
+#define LEGACY_FILE_SIZE_V1 sizeof(CronJobV1) * LEGACY_SLOTS
+
+/* Last-exec mirror: 4 bytes per job, only changed entries are rewritten */
+#define EXEC_STORAGE_PATH "/cron_exec.bin"
+#define EXEC_OFFSET(i) ((size_t)(i) * sizeof(uint32_t))
+
+/* Last-exec entries written per storage access */
+#define CRON_EXEC_BATCH 8
+
+/* Upper bound of loop iterations for a single next-fire search */
+#define CRON_SEARCH_MAX_STEPS 2000
+
+/* A schedule without a next occurrence is searched again after this */
+#define CRON_RETRY_SEC 3600
+
+/* Days searched for a solar event (covers a polar night) */
+#define CRON_SOLAR_MAX_DAYS 370
+
+/* Largest offset (minutes) from a solar event */
+#define CRON_SOLAR_MAX_OFFSET 720
+
+/* Slot flags kept in the RAM index */
+#define SLOT_ACTIVE 0x80
+#define SLOT_NO_FIRE 0x40 // next fire time holds the retry epoch
+#define SLOT_POLICY_MASK 0x03
+
+/*
+ * Slot index (RAM only). Job bodies stay on flash; the schedule of an
+ * inactive slot is left invalid so the loop skips it.
+ */
+static CronSchedule cronSchedules[MAX_CRON_JOBS];
+static uint32_t cronNextFireEpoch[MAX_CRON_JOBS]; // 0 = needs (re)init
+static uint32_t cronExecTable[MAX_CRON_JOBS];
+static uint8_t cronSlotFlags[MAX_CRON_JOBS]; // SLOT_ACTIVE | misfire policy
+static uint32_t cronExecDirty[(MAX_CRON_JOBS + 31) / 32];
+static bool cronExecChanged = false; // dirtied since the last storageDefer()
+
+/* Number of records present in the job table file */
+static uint16_t cronStoredSlots = 0;
+
+/* Last epoch converted to local time (see cronLocalTime) */
+static time_t cronLocalEpoch = 0;
+static struct tm cronLocalCache;
+
+/* Solar location the solar schedules were computed for */
+static uint32_t cronSolarVersion = 0;
+
+/* Clock step detection */
+static uint32_t lastTickEpoch = 0;
+static unsigned long lastTickMillis = 0;
 
 /**
  * Converts a CronAction enum to its string representation.
@@ -23,205 +123,1213 @@ String cronActionToString(CronAction action) {
     return "Set";
   case TogglePinState:
     return "Toggle";
+  case HttpRequest:
+    return "Http";
   case Reboot:
     return "Reboot";
+  case PulsePinState:
+    return "Pulse";
+  default:
+    return "Unknown";
+  }
+}
+
+/**
+ * Converts a CronMisfirePolicy value to its string representation.
+ */
+String cronMisfireToString(uint8_t policy) {
+  switch (policy) {
+  case MisfireSkip:
+    return "Skip";
+  case MisfireRunOnce:
+    return "Once";
+  case MisfireRunAll:
+    return "All";
   default:
     return "Unknown";
   }
 }
 
 /**
- * @brief Checks if a cron field matches a given value.
+ * @brief Parses an unsigned decimal number.
+ *
+ * @return Pointer past the last digit, or nullptr if no digit was found.
+ */
+static const char *parseNumber(const char *p, int &out) {
+  if (*p < '0' || *p > '9')
+    return nullptr;
+
+  out = 0;
+  while (*p >= '0' && *p <= '9') {
+    out = out * 10 + (*p - '0');
+    if (out > 1000)
+      return nullptr;
+    p++;
+  }
+  return p;
+}
+
+/**
+ * @brief Compiles a single cron field into a bitmask.
  *
  * Supports:
  *  - "*"
  *  - numeric value (e.g. "5")
  *  - ranges (e.g. "1-5")
  *  - lists (e.g. "1,3,5" or "5,10-20")
+ *  - steps (e.g. "0-30/10", "5/20", or a wildcard followed by "/15")
  *
  * @param expr Cron field expression
- * @param value Value to match against
- * @return true if matches, false otherwise
+ * @param lo Lowest allowed value
+ * @param hi Highest allowed value
+ * @param mask Output bitmask (bit n = value n)
+ * @return true if the field is valid
  */
-bool cronFieldMatch(const char *expr, int value) {
-  // wildcard "*"
-  if (strcmp(expr, "*") == 0)
-    return true;
+static bool cronFieldCompile(const char *expr, int lo, int hi,
+                             uint64_t &mask) {
+  mask = 0;
+  const char *p = expr;
 
-  // copy field
-  char buf[16];
-  strncpy(buf, expr, sizeof(buf));
-  buf[sizeof(buf) - 1] = '\0';
+  while (*p) {
+    int a, b, step = 1;
 
-  // split by comma (lists)
-  char *tok = strtok(buf, ",");
-  while (tok) {
-    // range or single?
-    char *dash = strchr(tok, '-');
-    if (!dash) {
-      if (atoi(tok) == value)
-        return true;
+    if (*p == '*') {
+      a = lo;
+      b = hi;
+      p++;
     } else {
-      int a = atoi(tok);
-      int b = atoi(dash + 1);
-      if (value >= a && value <= b)
-        return true;
+      p = parseNumber(p, a);
+      if (!p)
+        return false;
+      b = a;
+
+      if (*p == '-') {
+        p = parseNumber(p + 1, b);
+        if (!p)
+          return false;
+      }
     }
-    tok = strtok(nullptr, ",");
+
+    if (*p == '/') {
+      p = parseNumber(p + 1, step);
+      if (!p || step == 0)
+        return false;
+      // "a/s" means "from a to the end of the range"
+      if (b == a)
+        b = hi;
+    }
+
+    if (a < lo || b > hi || a > b)
+      return false;
+
+    for (int v = a; v <= b; v += step)
+      mask |= (uint64_t)1 << v;
+
+    if (*p == ',')
+      p++;
+    else if (*p)
+      return false;
   }
 
-  return false;
+  return mask != 0;
 }
 
 /**
- * @brief Checks whether a cron job should be executed at the given timestamp.
- *
- * This function:
- *  - evaluates the 5 cron fields (m h dom mon dow)
- *  - computes the target execution second for this minute
- *  - applies a time window (CRON_EXEC_WINDOW_SEC)
- *  - prevents double execution using lastExecEpoch
- *
- * @return true if the job should run now.
+ * @brief Compiles "@sunrise" / "@sunset" with an optional "+N" / "-N"
+ * offset in minutes.
  */
-bool cronMatch(const CronJob &job, uint32_t nowEpoch) {
-  // Convert epoch → local time
-  time_t now = nowEpoch;
-  struct tm *t = localtime(&now);
+static bool cronCompileSolar(const char *expr, CronSchedule &out) {
+  const char *p;
 
-  if (!t)
+  if (strncmp(expr, "@sunrise", 8) == 0) {
+    out.solar = SolarSunrise;
+    p = expr + 8;
+  } else if (strncmp(expr, "@sunset", 7) == 0) {
+    out.solar = SolarSunset;
+    p = expr + 7;
+  } else {
     return false;
+  }
+
+  int offset = 0;
+  if (*p == '+' || *p == '-') {
+    const char *end = parseNumber(p + 1, offset);
+    if (!end || *end || offset > CRON_SOLAR_MAX_OFFSET)
+      return false;
+    if (*p == '-')
+      offset = -offset;
+  } else if (*p) {
+    return false;
+  }
+
+  out.solarOffset = offset;
+  out.valid = true;
+  return true;
+}
+
+/**
+ * Compiles a 5-field cron expression into bitmasks.
+ */
+bool cronCompile(const char *expr, CronSchedule &out) {
+  out = {};
+
+  if (!expr)
+    return false;
+
+  if (expr[0] == '@') {
+    if (!cronCompileSolar(expr, out))
+      out = {};
+    return out.valid;
+  }
 
   // Split cron fields
-  char expr[32];
-  strncpy(expr, job.cron, sizeof(expr));
-  expr[sizeof(expr) - 1] = '\0';
+  char buf[32];
+  strncpy(buf, expr, sizeof(buf));
+  buf[sizeof(buf) - 1] = '\0';
 
   char *fields[5];
   int n = 0;
-  char *tok = strtok(expr, " ");
+  char *tok = strtok(buf, " ");
   while (tok && n < 5) {
     fields[n++] = tok;
     tok = strtok(nullptr, " ");
   }
-  if (n != 5)
+  if (n != 5 || tok)
     return false;
 
-  // Check each cron field
-  if (!cronFieldMatch(fields[0], t->tm_min))
+  uint64_t m;
+  if (!cronFieldCompile(fields[0], 0, 59, m))
     return false;
-  if (!cronFieldMatch(fields[1], t->tm_hour))
+  out.minutes = m;
+
+  if (!cronFieldCompile(fields[1], 0, 23, m))
     return false;
-  if (!cronFieldMatch(fields[2], t->tm_mday))
+  out.hours = (uint32_t)m;
+
+  if (!cronFieldCompile(fields[2], 1, 31, m))
     return false;
-  if (!cronFieldMatch(fields[3], t->tm_mon + 1))
+  out.days = (uint32_t)m;
+
+  if (!cronFieldCompile(fields[3], 1, 12, m))
     return false;
-  if (!cronFieldMatch(fields[4], t->tm_wday))
+  out.months = (uint16_t)m;
+
+  if (!cronFieldCompile(fields[4], 0, 7, m))
     return false;
+  // 7 is an alias for Sunday
+  out.weekdays = (uint8_t)((m | (m >> 7)) & 0x7F);
+
+  out.valid = true;
+  return true;
+}
+
+/**
+ * @brief Normalizes a broken-down local time and converts it to epoch.
+ *
+ * Uses the Clock module's precomputed offset table: DST gaps resolve to
+ * the transition, overlaps to the earlier instant.
+ */
+static time_t cronMakeTime(struct tm &t) {
+  t.tm_sec = 0;
+  return clockFromLocal(t);
+}
+
+/**
+ * @brief Converts an epoch to local time, caching the last result.
+ *
+ * Every job whose next fire time is computed in the same tick starts its
+ * search at the same minute, so the first conversion is shared.
+ */
+static void cronLocalTime(time_t t, struct tm &out) {
+  if (t != cronLocalEpoch) {
+    clockToLocal((uint32_t)t, cronLocalCache);
+    cronLocalEpoch = t;
+  }
+  out = cronLocalCache;
+}
+
+/**
+ * @brief Next fire time of a solar schedule.
+ *
+ * Walks local dates starting the day before `afterEpoch` (a large
+ * positive offset can push yesterday's event past it). Event times come
+ * from the Solar module's per-date cache.
+ */
+static uint32_t cronNextSolarFire(const CronSchedule &sched,
+                                  uint32_t afterEpoch) {
+  if (!solarHasLocation())
+    return 0;
+
+  struct tm lt;
+  cronLocalTime(afterEpoch, lt);
+  lt.tm_mday -= 1;
+  lt.tm_hour = 12;
+  lt.tm_min = 0;
+  lt.tm_sec = 0;
+
+  for (int d = 0; d < CRON_SOLAR_MAX_DAYS; d++, lt.tm_mday++) {
+    uint32_t noon = clockFromLocal(lt);
+    int32_t localDay = ((int64_t)noon + clockUtcOffset(noon)) / 86400;
+
+    uint32_t event;
+    if (!solarEventTime(localDay, sched.solar, event))
+      continue;
+
+    // Fire on the nearest minute
+    int64_t fire = (int64_t)event + sched.solarOffset * 60 + 30;
+    fire -= fire % 60;
+
+    if (fire > afterEpoch)
+      return (uint32_t)fire;
+  }
+
+  return 0;
+}
+
+/**
+ * Computes the next fire time of a schedule.
+ *
+ * The search walks local time with coarse jumps (month, day, hour) and
+ * only scans minutes through the bitmask, so a daily job needs a handful
+ * of iterations and even leap-day schedules stay within the step bound.
+ */
+uint32_t cronNextFire(const CronSchedule &sched, uint32_t afterEpoch) {
+  if (!sched.valid)
+    return 0;
+
+  if (sched.solar != SolarNone)
+    return cronNextSolarFire(sched, afterEpoch);
+
+  time_t t = ((time_t)afterEpoch / 60 + 1) * 60;
+
+  for (int step = 0; step < CRON_SEARCH_MAX_STEPS; step++) {
+    struct tm lt;
+    cronLocalTime(t, lt);
+
+    time_t next;
+
+    if (!(sched.months & (1 << (lt.tm_mon + 1)))) {
+      // Jump to the first day of the next month
+      lt.tm_mon += 1;
+      lt.tm_mday = 1;
+      lt.tm_hour = 0;
+      lt.tm_min = 0;
+      next = cronMakeTime(lt);
+    } else if (!(sched.days & (1UL << lt.tm_mday)) ||
+               !(sched.weekdays & (1 << lt.tm_wday))) {
+      // Jump to the next day
+      lt.tm_mday += 1;
+      lt.tm_hour = 0;
+      lt.tm_min = 0;
+      next = cronMakeTime(lt);
+    } else if (!(sched.hours & (1UL << lt.tm_hour))) {
+      // Jump to the next hour
+      lt.tm_hour += 1;
+      lt.tm_min = 0;
+      next = cronMakeTime(lt);
+    } else {
+      uint64_t rest = sched.minutes >> lt.tm_min;
+      if (rest & 1)
+        return (uint32_t)t;
 
-  // EXECUTION WINDOW CHECK
+      if (rest == 0) {
+        lt.tm_hour += 1;
+        lt.tm_min = 0;
+        next = cronMakeTime(lt);
+      } else {
+        next = t + (time_t)__builtin_ctzll(rest) * 60;
+      }
+    }
 
-  // expected second = 0 (cron standard)
-  uint32_t targetEpoch = nowEpoch - t->tm_sec;
+    // Never move backwards (DST overlaps)
+    t = next > t ? next : t + 60;
+  }
 
-  // Window match?
-  if (abs((int32_t)(nowEpoch - targetEpoch)) > CRON_EXEC_WINDOW_SEC)
+  return 0;
+}
+
+/**
+ * Whether a schedule has any occurrence within the search bound.
+ */
+bool cronCanFire(const CronSchedule &sched) {
+  if (!sched.valid)
     return false;
 
-  // avoid double execution
-  if ((uint32_t)(nowEpoch - job.lastExecEpoch) <= CRON_EXEC_WINDOW_SEC)
+  // Solar events depend on the location, which can change later
+  return sched.solar != SolarNone ||
+         cronNextFire(sched, CRON_MIN_VALID_EPOCH) != 0;
+}
+
+/**
+ * @brief Returns the current wall-clock epoch (UTC).
+ */
+static uint32_t cronNow() { return clockNow(); }
+
+/**
+ * @brief Marks the last execution of a job for the next mirror flush.
+ */
+static void cronSetLastExec(uint16_t index, uint32_t epoch) {
+  if (cronExecTable[index] == epoch)
+    return;
+
+  cronExecTable[index] = epoch;
+  cronExecDirty[index / 32] |= 1UL << (index % 32);
+  cronExecChanged = true;
+}
+
+/**
+ * @brief Computes the first pending occurrence of a job.
+ *
+ * Jobs with a catch-up policy resume from their last execution (bounded
+ * by CRON_MISFIRE_HORIZON_SEC) so that occurrences missed while the
+ * device was off are found. Skip jobs only look at the current window.
+ */
+static uint32_t cronInitNextFire(uint16_t index, uint32_t nowEpoch) {
+  uint8_t policy = cronSlotFlags[index] & SLOT_POLICY_MASK;
+  uint32_t lastExec = cronExecTable[index];
+
+  // A timestamp in the future was written with a wrong clock: ignore it
+  if (lastExec > nowEpoch + CRON_CLOCK_STEP_SEC)
+    lastExec = 0;
+
+  uint32_t base = nowEpoch - CRON_EXEC_WINDOW_SEC - 1;
+
+  if (policy != MisfireSkip && lastExec != 0) {
+    uint32_t horizon = nowEpoch - CRON_MISFIRE_HORIZON_SEC;
+    base = lastExec > horizon ? lastExec : horizon;
+  }
+
+  // Never fire again an occurrence that already ran
+  if (lastExec > base)
+    base = lastExec;
+
+  return cronNextFire(cronSchedules[index], base);
+}
+
+/**
+ * @brief Stores the next fire time of a job.
+ *
+ * A schedule without one (unsatisfiable date, no solar event) is not
+ * searched again before CRON_RETRY_SEC or the next cronReschedule().
+ */
+static void cronSetNextFire(uint16_t index, uint32_t next, uint32_t nowEpoch) {
+  if (next == 0) {
+    cronSlotFlags[index] |= SLOT_NO_FIRE;
+    next = nowEpoch + CRON_RETRY_SEC;
+  } else {
+    cronSlotFlags[index] &= ~SLOT_NO_FIRE;
+  }
+  cronNextFireEpoch[index] = next;
+}
+
+/**
+ * @brief Writes a batch of last-exec entries; failed ones stay dirty.
+ */
+static bool cronWriteExecChunks(const StorageChunk *chunks, size_t n) {
+  if (storageWriteChunks(EXEC_STORAGE_PATH, chunks, n))
+    return true;
+
+  for (size_t k = 0; k < n; k++) {
+    uint16_t i = chunks[k].offset / sizeof(uint32_t);
+    cronExecDirty[i / 32] |= 1UL << (i % 32);
+  }
+  return false;
+}
+
+/**
+ * @brief Writes the changed entries of the last-exec mirror to flash.
+ *
+ * Also the deferred flush of the mirror (see cronDeferExecTable).
+ */
+static bool cronFlushExecTable() {
+  StorageChunk chunks[CRON_EXEC_BATCH];
+  size_t n = 0;
+  bool ok = true;
+
+  for (uint16_t w = 0; w < (MAX_CRON_JOBS + 31) / 32; w++) {
+    uint32_t dirty = cronExecDirty[w];
+    cronExecDirty[w] = 0;
+
+    while (dirty) {
+      uint16_t i = w * 32 + __builtin_ctz(dirty);
+      dirty &= dirty - 1;
+
+      chunks[n++] = {EXEC_OFFSET(i), (const uint8_t *)&cronExecTable[i],
+                     sizeof(uint32_t)};
+
+      if (n == CRON_EXEC_BATCH) {
+        ok = cronWriteExecChunks(chunks, n) && ok;
+        n = 0;
+      }
+    }
+  }
+
+  if (n > 0)
+    ok = cronWriteExecChunks(chunks, n) && ok;
+  return ok;
+}
+
+/**
+ * @brief Schedules a flush of the last-exec mirror if an entry changed.
+ *
+ * Executions in the same burst (several jobs on adjacent ticks, a series
+ * of job updates) share one write. A power cut before the flush can run
+ * the latest occurrence again after boot; a Reboot action flushes first.
+ */
+static void cronDeferExecTable() {
+  if (!cronExecChanged)
+    return;
+
+  cronExecChanged = false;
+  storageDefer(cronFlushExecTable);
+}
+
+/**
+ * @brief Executes the action of a cron job once.
+ *
+ * @return false if the action was rejected (an HttpRequest counts as
+ * successful once queued)
+ */
+static bool cronExecute(uint16_t index, const CronJob &job) {
+  switch (job.action) {
+  case SetPinState:
+  case TogglePinState: {
+    GpioConfig *existing = deviceGet(job.pin);
+    if (!existing)
+      return false;
+
+    GpioConfig newCfg = *existing;
+    if (job.action == SetPinState)
+      newCfg.state = job.value;
+    else
+      newCfg.state = newCfg.state ? 0 : 1;
+
+    return deviceSet(newCfg);
+  }
+  case PulsePinState:
+    return devicePulse(job.pin, job.value, job.pulseMs);
+  case HttpRequest: {
+    char body[32];
+    snprintf(body, sizeof(body), "{\"job\":%u,\"value\":%d}",
+             (unsigned)index, job.value);
+    return httpEnqueue((HttpQueueMethod)job.httpMethod, job.url, body,
+                       index) != 0;
+  }
+  case Reboot:
+    // Persist last-exec first, or the job would run again after boot
+    cronFlushExecTable();
+    storageFlush();
+    cronLogFlush();
+    ESP.restart();
+    return true;
+  }
+  return false;
+}
+
+/**
+ * @brief Milliseconds elapsed since an occurrence.
+ */
+static uint32_t cronLatenessMs(uint32_t scheduledEpoch) {
+  uint64_t nowMs = clockNowMs();
+  uint64_t dueMs = (uint64_t)scheduledEpoch * 1000;
+
+  if (nowMs <= dueMs)
+    return 0;
+  return nowMs - dueMs > UINT32_MAX ? UINT32_MAX : nowMs - dueMs;
+}
+
+/**
+ * @brief Detects wall-clock steps and handles backward ones.
+ *
+ * Forward steps need no special handling: every job whose next fire time
+ * was skipped over is late and goes through its misfire policy.
+ * Small backward steps keep the precomputed next fire times, so an
+ * occurrence that already ran is never repeated. Large backward steps
+ * (bad time source corrected) reset all schedules.
+ */
+static void cronCheckClockStep(uint32_t nowEpoch) {
+  unsigned long nowMs = millis();
+
+  if (lastTickEpoch != 0) {
+    uint32_t expected = lastTickEpoch + (nowMs - lastTickMillis) / 1000;
+    int32_t delta = (int32_t)(nowEpoch - expected);
+
+    if (delta > CRON_CLOCK_STEP_SEC) {
+      debugPrintln(F("[CRON]"),
+                   "Clock stepped forward by " + String(delta) + " s");
+    } else if (delta < -CRON_CLOCK_STEP_SEC) {
+      debugPrintln(F("[CRON]"),
+                   "Clock stepped backward by " + String(-delta) + " s");
+
+      if (-delta > CRON_CLOCK_RESYNC_SEC)
+        cronReschedule();
+    }
+  }
+
+  lastTickEpoch = nowEpoch;
+  lastTickMillis = nowMs;
+}
+
+/**
+ * @brief Decides how many times a due job runs now.
+ *
+ * @param index Job index
+ * @param job Job definition
+ * @param firstDue Oldest pending occurrence of the job
+ * @param nowEpoch Current time
+ * @return Number of runs (0 = occurrence dropped)
+ */
+static uint8_t cronRunsForMisfire(uint16_t index, const CronJob &job,
+                                  uint32_t firstDue, uint32_t nowEpoch) {
+  uint32_t lateness = nowEpoch - firstDue;
+
+  if (lateness <= CRON_EXEC_WINDOW_SEC)
+    return 1;
+
+  if (lateness > CRON_MISFIRE_HORIZON_SEC)
+    return 0;
+
+  switch (job.misfirePolicy) {
+  case MisfireRunOnce:
+    return 1;
+
+  case MisfireRunAll: {
+    uint8_t limit =
+        job.misfireLimit ? job.misfireLimit : CRON_MISFIRE_DEFAULT_LIMIT;
+    uint8_t runs = 1;
+    uint32_t t = firstDue;
+
+    while (runs < limit) {
+      t = cronNextFire(cronSchedules[index], t);
+      if (t == 0 || t > nowEpoch)
+        break;
+      runs++;
+    }
+    return runs;
+  }
+
+  case MisfireSkip:
+  default:
+    return 0;
+  }
+}
+
+/**
+ * @brief Checksum of a job record.
+ */
+static uint32_t cronRecordCrc(const CronJob &job) {
+  return crc32((const uint8_t *)&job, sizeof(CronJob));
+}
+
+/**
+ * @brief Whether a record is a zero-filled gap (slot never written).
+ */
+static bool cronRecordIsEmpty(const CronRecord &rec) {
+  return rec.crc == 0 && !rec.job.active;
+}
+
+/**
+ * @brief Updates the RAM index of a slot from a job definition.
+ */
+static void cronIndexJob(uint16_t index, const CronJob &job) {
+  cronSlotFlags[index] =
+      (job.active ? SLOT_ACTIVE : 0) | (job.misfirePolicy & SLOT_POLICY_MASK);
+
+  if (job.active)
+    cronCompile(job.cron, cronSchedules[index]);
+  else
+    cronSchedules[index] = {};
+
+  cronNextFireEpoch[index] = 0;
+}
+
+/**
+ * @brief Writes a fresh table header, which empties every slot.
+ */
+static bool cronWriteHeader() {
+  CronFileHeader hdr;
+  hdr.magic = CRON_FILE_MAGIC;
+  hdr.version = CRON_FILE_VERSION;
+  hdr.recordSize = sizeof(CronRecord);
+  hdr.slots = MAX_CRON_JOBS;
+
+  // Record offsets are absolute, so the file is raw (not storageWrite()
+  // framed); removing it first truncates the old records
+  cronStoredSlots = 0;
+  return storageRemove(STORAGE_PATH) &&
+         storageWriteAt(STORAGE_PATH, 0, (uint8_t *)&hdr, sizeof(hdr));
+}
+
+/**
+ * @brief Rewrites job records in place with a single storage operation.
+ *
+ * The stored last execution time is taken from the RAM index.
+ */
+static bool cronWriteRecords(const uint16_t *indices, const CronJob *jobs,
+                             size_t count) {
+  CronRecord *recs = (CronRecord *)malloc(count * sizeof(CronRecord));
+  StorageChunk *chunks = (StorageChunk *)malloc(count * sizeof(StorageChunk));
+  bool ok = recs && chunks;
+
+  if (ok) {
+    for (size_t k = 0; k < count; k++) {
+      uint16_t i = indices[k];
+
+      recs[k].job = jobs[k];
+      recs[k].job.lastExecEpoch = cronExecTable[i];
+      recs[k].crc = cronRecordCrc(recs[k].job);
+      chunks[k] = {RECORD_OFFSET(i), (const uint8_t *)&recs[k],
+                   sizeof(CronRecord)};
+
+      if (i >= cronStoredSlots)
+        cronStoredSlots = i + 1;
+    }
+
+    ok = storageWriteChunks(STORAGE_PATH, chunks, count);
+  }
+
+  free(chunks);
+  free(recs);
+  return ok;
+}
+
+/**
+ * @brief Reads one job record.
+ *
+ * Missing and damaged records read as an empty job.
+ *
+ * @return false if the storage access failed
+ */
+static bool cronReadRecord(uint16_t index, CronJob &out) {
+  out = {};
+
+  if (index >= cronStoredSlots)
+    return true;
+
+  CronRecord rec;
+  if (!storageReadAt(STORAGE_PATH, RECORD_OFFSET(index), (uint8_t *)&rec,
+                     sizeof(rec)))
     return false;
 
+  if (cronRecordIsEmpty(rec))
+    return true;
+
+  if (rec.crc != cronRecordCrc(rec.job)) {
+    debugPrintln(F("[CRON]"), "Job " + String(index) + " corrupted");
+    return true;
+  }
+
+  out = rec.job;
   return true;
 }
 
+/**
+ * @brief Builds the RAM index from the job table file.
+ *
+ * Records are read a few at a time, so boot needs no buffer for the
+ * whole table. Records that fail their CRC leave their slot empty.
+ *
+ * @return false if the table header is missing or invalid
+ */
+static bool cronLoadIndex() {
+  CronFileHeader hdr;
+  if (!storageReadAt(STORAGE_PATH, 0, (uint8_t *)&hdr, sizeof(hdr)))
+    return false;
+
+  if (hdr.magic != CRON_FILE_MAGIC || hdr.version != CRON_FILE_VERSION ||
+      hdr.recordSize != sizeof(CronRecord))
+    return false;
+
+  size_t slots = (storageSize(STORAGE_PATH) - sizeof(hdr)) / sizeof(CronRecord);
+  if (slots > MAX_CRON_JOBS) {
+    debugPrintln(F("[CRON]"), "Job table has " + String(slots) +
+                                  " slots, only " + String(MAX_CRON_JOBS) +
+                                  " are used");
+    slots = MAX_CRON_JOBS;
+  }
+
+  CronRecord *buf = (CronRecord *)malloc(CRON_LOAD_BATCH * sizeof(CronRecord));
+  if (!buf)
+    return false;
+
+  for (size_t first = 0; first < slots; first += CRON_LOAD_BATCH) {
+    size_t n =
+        slots - first < CRON_LOAD_BATCH ? slots - first : CRON_LOAD_BATCH;
+
+    // Keep the table on a read error: it is only ever recreated when its
+    // header is missing or invalid
+    if (!storageReadAt(STORAGE_PATH, RECORD_OFFSET(first), (uint8_t *)buf,
+                       n * sizeof(CronRecord))) {
+      debugPrintln(F("[CRON]"), "Job table unreadable from slot " +
+                                    String(first));
+      break;
+    }
+
+    for (size_t k = 0; k < n; k++) {
+      const CronRecord &rec = buf[k];
+
+      if (cronRecordIsEmpty(rec))
+        continue;
+
+      if (rec.crc != cronRecordCrc(rec.job)) {
+        debugPrintln(F("[CRON]"),
+                     "Job " + String(first + k) + " corrupted, cleared");
+        continue;
+      }
+
+      cronIndexJob(first + k, rec.job);
+      cronExecTable[first + k] = rec.job.lastExecEpoch;
+    }
+  }
+
+  free(buf);
+  cronStoredSlots = slots;
+  return true;
+}
+
+/**
+ * @brief Loads a raw job table written by earlier firmware.
+ *
+ * Two layouts are recognized by size: the current CronJob array and the
+ * one without HttpRequest fields (CronJobV1).
+ */
+static bool cronLoadLegacy(CronJob *jobs) {
+  if (storageRead(LEGACY_STORAGE_PATH, (uint8_t *)jobs, LEGACY_FILE_SIZE))
+    return true;
+
+  memset(jobs, 0, LEGACY_FILE_SIZE);
+
+  CronJobV1 *old = (CronJobV1 *)malloc(LEGACY_FILE_SIZE_V1);
+  if (!old)
+    return false;
+
+  bool ok = storageRead(LEGACY_STORAGE_PATH, (uint8_t *)old,
+                        LEGACY_FILE_SIZE_V1);
+
+  if (ok) {
+    for (int i = 0; i < LEGACY_SLOTS; i++) {
+      CronJob &job = jobs[i];
+      job.active = old[i].active;
+      memcpy(job.cron, old[i].cron, sizeof(job.cron));
+      job.action = old[i].action;
+      job.pin = old[i].pin;
+      job.misfirePolicy = old[i].misfirePolicy;
+      job.misfireLimit = old[i].misfireLimit;
+      job.value = old[i].value;
+      job.lastExecEpoch = old[i].lastExecEpoch;
+    }
+  }
+
+  free(old);
+  return ok;
+}
+
+/**
+ * @brief Creates a new job table, importing the legacy one if present.
+ *
+ * @return true if legacy jobs were imported
+ */
+static bool cronCreateTable() {
+  CronJob *jobs = (CronJob *)calloc(LEGACY_SLOTS, sizeof(CronJob));
+  bool imported = jobs && cronLoadLegacy(jobs);
+  bool stored = cronWriteHeader();
+
+  if (imported) {
+    debugPrintln(F("[CRON]"), F("Migrating cron table to record layout"));
+
+    uint16_t indices[LEGACY_SLOTS];
+    size_t count = LEGACY_SLOTS < MAX_CRON_JOBS ? LEGACY_SLOTS : MAX_CRON_JOBS;
+
+    for (size_t i = 0; i < count; i++) {
+      indices[i] = i;
+      cronIndexJob(i, jobs[i]);
+      cronExecTable[i] = jobs[i].lastExecEpoch;
+    }
+
+    stored = stored && cronWriteRecords(indices, jobs, count);
+  }
+
+  free(jobs);
+
+  if (stored)
+    storageRemove(LEGACY_STORAGE_PATH);
+
+  return imported;
+}
+
+/**
+ * @brief Merges the last-exec mirror into the RAM index.
+ *
+ * The mirror is newer than the table wherever it was written; entries it
+ * zero-filled keep the value from the job record.
+ */
+static void cronLoadExecTable() {
+  size_t entries = storageSize(EXEC_STORAGE_PATH) / sizeof(uint32_t);
+  if (entries > MAX_CRON_JOBS)
+    entries = MAX_CRON_JOBS;
+
+  uint32_t buf[32];
+
+  for (size_t first = 0; first < entries; first += 32) {
+    size_t n = entries - first < 32 ? entries - first : 32;
+
+    if (!storageReadAt(EXEC_STORAGE_PATH, EXEC_OFFSET(first), (uint8_t *)buf,
+                       n * sizeof(uint32_t)))
+      return;
+
+    for (size_t k = 0; k < n; k++) {
+      if (buf[k] > cronExecTable[first + k])
+        cronExecTable[first + k] = buf[k];
+    }
+  }
+}
+
 /**
  * Initializes the cron scheduler.
  * - Sets up internal data structures and prepares the scheduler
  * - Inizialization of cron jobs storage
- * - Inizialization of NTPClient for timekeeping
+ *
+ * Time and timezone come from the Clock module; nothing here waits for a
+ * sync.
  */
 bool cronSchedulerInit() {
-  timeClient.begin();
-  timeClient.update();
+  // Build the slot index from storage
+  bool storageOk = cronLoadIndex();
+
+  if (!storageOk) {
+    memset(cronSchedules, 0, sizeof(cronSchedules));
+    memset(cronSlotFlags, 0, sizeof(cronSlotFlags));
+    memset(cronExecTable, 0, sizeof(cronExecTable));
 
-  // Timezone Europa/Italia: CET/CEST
-  setenv("TZ", "CET-1CEST,M3.5.0,M10.5.0/3", 1);
-  // setenv("TZ", DEFAULT_TZ, 1);
+    // Create the record file so that later updates can be done in place
+    storageOk = cronCreateTable();
+  }
 
-  tzset();
+  cronLoadExecTable();
+  cronLogInit();
 
-  // Load cron jobs state from storage
-  bool storageOk =
-      storageRead(STORAGE_PATH, (uint8_t *)cronJobsState, FILE_SIZE);
+  debugPrintln(F("[CRON]"), String(cronActiveCount()) + " active job(s), " +
+                                String(MAX_CRON_JOBS) + " slots");
 
   return storageOk;
 }
 
 /**
- * Retrieves a cron job by index.
+ * @brief Updates the RAM index of a job (no storage access).
  */
-bool setCronJob(uint8_t index, const CronJob &job) {
-  if (index >= MAX_CRON_JOBS)
+static void cronApplyJob(uint16_t index, const CronJob &job) {
+  uint32_t lastExec = job.lastExecEpoch;
+
+  // Anchor the catch-up window of a new job at its creation time
+  uint32_t now = cronNow();
+  if (job.active && lastExec == 0 && now >= CRON_MIN_VALID_EPOCH)
+    lastExec = now;
+
+  cronSetLastExec(index, lastExec);
+  cronIndexJob(index, job);
+  cronLogResetJob(index);
+}
+
+/**
+ * Sets a cron job at the specified index (one record written in place).
+ */
+bool setCronJob(uint16_t index, const CronJob &job) {
+  return cronSetJobs(&index, &job, 1);
+}
+
+/**
+ * Updates several jobs with a single storage operation.
+ */
+bool cronSetJobs(const uint16_t *indices, const CronJob *jobs, size_t count) {
+  if (!indices || !jobs || count == 0)
     return false;
 
-  cronJobsState[index] = job;
+  for (size_t i = 0; i < count; i++) {
+    if (indices[i] >= MAX_CRON_JOBS)
+      return false;
+  }
+
+  for (size_t i = 0; i < count; i++)
+    cronApplyJob(indices[i], jobs[i]);
 
   // Save to storage
-  return storageWrite(STORAGE_PATH, (uint8_t *)cronJobsState, FILE_SIZE);
+  bool ok = cronWriteRecords(indices, jobs, count);
+  cronDeferExecTable();
+  return ok;
 }
 
 /**
- * Retrieves all cron jobs.
+ * Removes every job: the table is reset to its header and the last-exec
+ * mirror is deleted.
  */
-CronJob *cronGetAll() { return cronJobsState; }
+bool cronClearAll() {
+  memset(cronSchedules, 0, sizeof(cronSchedules));
+  memset(cronSlotFlags, 0, sizeof(cronSlotFlags));
+  memset(cronExecTable, 0, sizeof(cronExecTable));
+  memset(cronExecDirty, 0, sizeof(cronExecDirty));
+  cronExecChanged = false;
+  memset(cronNextFireEpoch, 0, sizeof(cronNextFireEpoch));
+
+  for (uint16_t i = 0; i < MAX_CRON_JOBS; i++)
+    cronLogResetJob(i);
+
+  bool ok = cronWriteHeader();
+  return storageRemove(EXEC_STORAGE_PATH) && ok;
+}
+
+/* Open import: records not yet written, in slot order */
+static CronRecord *importBuf = nullptr;
+static uint16_t importIndex[CRON_LOAD_BATCH];
+static size_t importCount = 0;
+static int32_t importLast = -1;
+static bool importOk = false;
+
+/**
+ * @brief Writes the buffered import records with one storage operation.
+ */
+static bool cronImportFlush() {
+  if (importCount == 0)
+    return true;
+
+  StorageChunk chunks[CRON_LOAD_BATCH];
+  for (size_t k = 0; k < importCount; k++)
+    chunks[k] = {RECORD_OFFSET(importIndex[k]), (const uint8_t *)&importBuf[k],
+                 sizeof(CronRecord)};
+
+  bool ok = storageWriteChunks(IMPORT_STORAGE_PATH, chunks, importCount);
+  importCount = 0;
+  return ok;
+}
+
+void cronImportAbort() {
+  free(importBuf);
+  importBuf = nullptr;
+  importCount = 0;
+  storageRemove(IMPORT_STORAGE_PATH);
+}
+
+bool cronImportBegin() {
+  cronImportAbort();
+
+  importBuf = (CronRecord *)malloc(CRON_LOAD_BATCH * sizeof(CronRecord));
+  if (!importBuf)
+    return false;
+
+  CronFileHeader hdr;
+  hdr.magic = CRON_FILE_MAGIC;
+  hdr.version = CRON_FILE_VERSION;
+  hdr.recordSize = sizeof(CronRecord);
+  hdr.slots = MAX_CRON_JOBS;
+
+  importLast = -1;
+  importOk = storageWriteAt(IMPORT_STORAGE_PATH, 0, (uint8_t *)&hdr,
+                            sizeof(hdr));
+  return importOk;
+}
+
+bool cronImportJob(uint16_t index, const CronJob &job) {
+  if (!importBuf || !importOk || index >= MAX_CRON_JOBS ||
+      (int32_t)index <= importLast)
+    return false;
+
+  CronSchedule sched;
+  if (job.active && !(cronCompile(job.cron, sched) && cronCanFire(sched)))
+    return false;
+
+  // The imported jobs are new here: anchor their catch-up at the import
+  uint32_t now = cronNow();
+
+  CronRecord &rec = importBuf[importCount];
+  rec.job = job;
+  rec.job.lastExecEpoch = now >= CRON_MIN_VALID_EPOCH ? now : 0;
+  rec.crc = cronRecordCrc(rec.job);
+
+  importIndex[importCount++] = index;
+  importLast = index;
+
+  if (importCount == CRON_LOAD_BATCH)
+    importOk = cronImportFlush();
+
+  return importOk;
+}
+
+bool cronImportCommit() {
+  if (!importBuf)
+    return false;
+
+  bool ok = importOk && cronImportFlush() &&
+            storageRename(IMPORT_STORAGE_PATH, STORAGE_PATH);
+
+  free(importBuf);
+  importBuf = nullptr;
+
+  if (!ok) {
+    storageRemove(IMPORT_STORAGE_PATH);
+    return false;
+  }
+
+  memset(cronSchedules, 0, sizeof(cronSchedules));
+  memset(cronSlotFlags, 0, sizeof(cronSlotFlags));
+  memset(cronExecTable, 0, sizeof(cronExecTable));
+  memset(cronExecDirty, 0, sizeof(cronExecDirty));
+  cronExecChanged = false;
+  memset(cronNextFireEpoch, 0, sizeof(cronNextFireEpoch));
+
+  for (uint16_t i = 0; i < MAX_CRON_JOBS; i++)
+    cronLogResetJob(i);
+
+  // The last executions are in the new records; the mirror is stale
+  storageRemove(EXEC_STORAGE_PATH);
+
+  ok = cronLoadIndex();
+  debugPrintln(F("[CRON]"), "Imported job table, " +
+                                String(cronActiveCount()) + " active job(s)");
+  return ok;
+}
 
 /**
- * Retrieves a cron job by index.
+ * Reads a cron job from storage.
  */
-CronJob *cronGet(uint8_t index) {
+bool cronGet(uint16_t index, CronJob &out) {
   if (index >= MAX_CRON_JOBS)
-    return nullptr;
-  return &cronJobsState[index];
+    return false;
+
+  if (!cronReadRecord(index, out))
+    return false;
+
+  out.lastExecEpoch = cronExecTable[index];
+  return true;
+}
+
+bool cronIsActive(uint16_t index) {
+  return index < MAX_CRON_JOBS && (cronSlotFlags[index] & SLOT_ACTIVE);
+}
+
+int cronFindFreeSlot() {
+  for (int i = 0; i < MAX_CRON_JOBS; i++) {
+    if (!(cronSlotFlags[i] & SLOT_ACTIVE))
+      return i;
+  }
+  return -1;
+}
+
+uint16_t cronActiveCount() {
+  uint16_t count = 0;
+  for (int i = 0; i < MAX_CRON_JOBS; i++) {
+    if (cronSlotFlags[i] & SLOT_ACTIVE)
+      count++;
+  }
+  return count;
+}
+
+/**
+ * Recomputes every next fire time on the next tick, including the
+ * schedules waiting for a retry.
+ */
+void cronReschedule() {
+  memset(cronNextFireEpoch, 0, sizeof(cronNextFireEpoch));
+  for (int i = 0; i < MAX_CRON_JOBS; i++)
+    cronSlotFlags[i] &= ~SLOT_NO_FIRE;
+  cronLocalEpoch = 0;
+}
+
+/**
+ * @brief Recomputes the solar schedules after a location change.
+ */
+static void cronCheckSolarLocation() {
+  if (solarLocationVersion() == cronSolarVersion)
+    return;
+  cronSolarVersion = solarLocationVersion();
+
+  for (int i = 0; i < MAX_CRON_JOBS; i++) {
+    if (cronSchedules[i].solar != SolarNone) {
+      cronNextFireEpoch[i] = 0;
+      cronSlotFlags[i] &= ~SLOT_NO_FIRE;
+    }
+  }
 }
 
 void cronSchedulerLoop() {
-  static unsigned long lastPrint = 0;
-
-  // Aggiorna NTP
-  timeClient.update();
-
-  // Stampa solo una volta al secondo
-  unsigned long now = millis();
-  if (now - lastPrint >= 1000) {
-    lastPrint = now;
-
-    for (int i = 0; i < MAX_CRON_JOBS; i++) {
-
-      if (cronJobsState[i].active &&
-          cronMatch(cronJobsState[i], timeClient.getEpochTime())) {
-        GpioConfig *existing = deviceGet(cronJobsState[i].pin);
-        GpioConfig newCfg = *existing;
-
-        // Esegui l'azione
-        switch (cronJobsState[i].action) {
-        case SetPinState:
-          newCfg.state = cronJobsState[i].value;
-          deviceSet(newCfg);
-          break;
-        case TogglePinState:
-          newCfg.state = newCfg.state ? 0 : 1;
-          deviceSet(newCfg);
-          break;
-        case HttpRequest:
-          break;
-        case Reboot:
-          ESP.restart();
-          break;
-        }
-        // Aggiorna lastExecEpoch
-        cronJobsState[i].lastExecEpoch = timeClient.getEpochTime();
-      }
+  static unsigned long lastTick = 0;
+
+  // Valuta i job solo una volta al secondo
+  unsigned long nowMs = millis();
+  if (nowMs - lastTick < 1000)
+    return;
+  lastTick = nowMs;
+
+  // Read the clock once per tick
+  uint32_t now = cronNow();
+
+  // No schedule can be evaluated before the first time sync
+  if (now < CRON_MIN_VALID_EPOCH)
+    return;
+
+  cronCheckClockStep(now);
+  cronCheckSolarLocation();
+
+  for (int i = 0; i < MAX_CRON_JOBS; i++) {
+    // Inactive slots have no valid schedule
+    if (!cronSchedules[i].valid)
+      continue;
+
+    // Retry epoch reached: search again from the current window
+    if ((cronSlotFlags[i] & SLOT_NO_FIRE) && now >= cronNextFireEpoch[i])
+      cronNextFireEpoch[i] = 0;
+
+    if (cronNextFireEpoch[i] == 0)
+      cronSetNextFire(i, cronInitNextFire(i, now), now);
+
+    uint32_t due = cronNextFireEpoch[i];
+    if (now < due || (cronSlotFlags[i] & SLOT_NO_FIRE))
+      continue;
+
+    cronSetNextFire(i, cronNextFire(cronSchedules[i], now), now);
+
+    // Only due jobs are read from flash
+    CronJob job;
+    if (!cronReadRecord(i, job) || !job.active) {
+      debugPrintln(F("[CRON]"), "Job " + String(i) + " unreadable, skipped");
+      cronLogRecord(i, CRON_LOG_NO_ACTION, due, cronLatenessMs(due),
+                    CronRunUnreadable);
+      continue;
+    }
+
+    uint8_t runs = cronRunsForMisfire(i, job, due, now);
+
+    if (runs == 0) {
+      debugPrintln(F("[CRON]"), "Job " + String(i) + " missed (" +
+                                    String(now - due) + " s late), skipped");
+      cronLogRecord(i, job.action, due, cronLatenessMs(due), CronRunMissed);
+      continue;
+    }
+
+    if (now - due > CRON_EXEC_WINDOW_SEC) {
+      debugPrintln(F("[CRON]"), "Job " + String(i) + " missed (" +
+                                    String(now - due) + " s late), running " +
+                                    String(runs) + "x");
+    }
+
+    // Record the execution before running: Reboot does not return
+    cronSetLastExec(i, now);
+
+    uint32_t scheduled = due;
+    for (uint8_t r = 0; r < runs; r++) {
+      uint32_t lateMs = cronLatenessMs(scheduled);
+
+      // Reboot does not return: log it before running
+      if (job.action == Reboot)
+        cronLogRecord(i, job.action, scheduled, lateMs, CronRunOk);
+
+      bool ok = cronExecute(i, job);
+      cronLogRecord(i, job.action, scheduled, lateMs,
+                    ok ? CronRunOk : CronRunFailed);
+
+      // Catch-up runs stand for the following missed occurrences
+      scheduled = cronNextFire(cronSchedules[i], scheduled);
     }
   }
-}
\ No newline at end of file
+
+  cronDeferExecTable();
+  cronLogLoop();
+}
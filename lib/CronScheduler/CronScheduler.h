@@ -5,20 +5,15 @@
 /**
  * @brief Maximum number of scheduled cron jobs.
  *
- * This limit ensures efficient memory usage on the ESP8266.
+ * Job bodies live on LittleFS and are read only when a job fires or is
+ * queried; RAM holds a small per-slot index (compiled schedule, next fire
+ * time, last execution and flags, about 34 bytes per slot, plus 12 bytes
+ * of execution statistics in CronLog). The limit can be changed with a
+ * build flag.
  */
-#define MAX_CRON_JOBS 32
-
-/**
- * @brief Default timezone string for UTC.
- *
- * UTC has no offset and no daylight-saving rules, making it the
- * simplest and most stable choice for systems that do not require
- * local civil time.
- *
- * Used by configTime() to configure the ESP8266 timezone.
- */
-#define DEFAULT_TZ "UTC0"
+#ifndef MAX_CRON_JOBS
+#define MAX_CRON_JOBS 256
+#endif
 
 /**
  * @brief Time window (in seconds) for cron job execution.
@@ -29,15 +24,93 @@
  */
 #define CRON_EXEC_WINDOW_SEC 2
 
+/**
+ * @brief Maximum age (in seconds) of a missed occurrence that can still be
+ * caught up by the misfire policy.
+ *
+ * Occurrences older than this are dropped, which bounds both the work done
+ * after a long power outage and the amount of stale actions replayed.
+ */
+#define CRON_MISFIRE_HORIZON_SEC 86400
+
+/**
+ * @brief Default number of catch-up runs for the RunAll misfire policy
+ * when the job does not specify its own limit.
+ */
+#define CRON_MISFIRE_DEFAULT_LIMIT 5
+
+/**
+ * @brief Minimum deviation (in seconds) between the wall clock and the
+ * monotonic clock that is treated as a clock step (e.g. NTP correction).
+ */
+#define CRON_CLOCK_STEP_SEC 5
+
+/**
+ * @brief Backward clock steps larger than this (in seconds) reset every
+ * schedule instead of waiting for the clock to catch up again.
+ */
+#define CRON_CLOCK_RESYNC_SEC 3600
+
+/**
+ * @brief Epochs before this value (2024-01-01) are considered "clock not
+ * synchronized yet" and no job is evaluated.
+ */
+#define CRON_MIN_VALID_EPOCH 1704067200UL
+
+/**
+ * @brief Maximum URL length (including terminator) of an HttpRequest job.
+ */
+#define CRON_URL_MAX_LEN 64
+
 /**
  * @brief Actions that can be performed by a cron job.
  *
  * - SetPinState: Set a GPIO pin to HIGH or LOW
  * - TogglePinState: Toggle the current state of a GPIO pin
- * - HttpRequest: Perform an HTTP GET request to a specified URL
+ * - HttpRequest: Queue an HTTP GET or POST to the job's URL (non-blocking,
+ *   see HttpQueue)
  * - Reboot: Reboot the device
+ * - PulsePinState: Set a GPIO pin to `value` for `pulseMs` milliseconds,
+ *   then revert it (see devicePulse())
  */
-enum CronAction { SetPinState = 0, TogglePinState, HttpRequest, Reboot };
+enum CronAction {
+  SetPinState = 0,
+  TogglePinState,
+  HttpRequest,
+  Reboot,
+  PulsePinState
+};
+
+/**
+ * @brief What to do with occurrences missed while the device was off,
+ * rebooting, stalled or while the clock jumped forward.
+ *
+ * - MisfireSkip: Drop missed occurrences (default, previous behavior)
+ * - MisfireRunOnce: Run the job once, however many occurrences were missed
+ * - MisfireRunAll: Run the job once per missed occurrence, up to
+ *   `misfireLimit` runs (CRON_MISFIRE_DEFAULT_LIMIT if zero)
+ *
+ * Only occurrences within CRON_MISFIRE_HORIZON_SEC are ever caught up.
+ */
+enum CronMisfirePolicy { MisfireSkip = 0, MisfireRunOnce, MisfireRunAll };
+
+/**
+ * @brief Compiled form of a 5-field cron expression.
+ *
+ * Each field is stored as a bitmask so that matching and next-fire
+ * searches never re-parse the expression string. Solar expressions
+ * ("@sunset-30") fire daily and only use `solar` and `solarOffset`.
+ */
+struct CronSchedule {
+  uint64_t minutes;    // bit n = minute n (0-59)
+  uint32_t hours;      // bit n = hour n (0-23)
+  uint32_t days;       // bit n = day of month n (1-31)
+  uint16_t months;     // bit n = month n (1-12)
+  uint8_t weekdays;    // bit n = weekday n (0-6, Sunday = 0)
+  bool valid;
+  uint8_t solar;       // SolarEvent anchor (SolarNone = field masks)
+  int16_t solarOffset; // minutes after (or before) the solar event
+};
 
 /**
  * @brief Represents a scheduled cron job.
@@ -48,6 +121,12 @@ enum CronAction { SetPinState = 0, TogglePinState, HttpRequest, Reboot };
  * - action: The action to perform
  * - pin: The target GPIO pin (if applicable)
  * - value: The value associated with the action (if applicable)
+ * - misfirePolicy / misfireLimit: How missed occurrences are handled
+ *   (see CronMisfirePolicy)
+ * - httpMethod / url: Target of an HttpRequest job (HttpQueueMethod).
+ *   For POST the body is {"job":<index>,"value":<value>}.
+ * - pulseMs: Pulse duration of a PulsePinState job (shares the storage
+ *   of `url`, so the record layout is unchanged)
  *
  * The field `lastExecEpoch` stores the timestamp of the last execution.
  * It is required because, on a microcontroller like ESP8266, the main loop
@@ -64,6 +143,11 @@ enum CronAction { SetPinState = 0, TogglePinState, HttpRequest, Reboot };
  * - detect whether the job has already run for the current cycle,
  * - remain robust even when time checks occur late or irregularly.
  *
+ * The last execution time is additionally mirrored to a small side file
+ * (see cronSchedulerLoop()) so that it survives reboots without rewriting
+ * the whole job table. For jobs that never ran it holds the creation time,
+ * which anchors the misfire catch-up.
+ *
  * The type is uint32_t (unsigned epoch time), which is not affected by
  * the Year 2038 problem and remains valid until the year 2106.
  */
@@ -72,8 +156,15 @@ struct CronJob {
   char cron[32];
   CronAction action;
   uint8_t pin;
+  uint8_t misfirePolicy; // CronMisfirePolicy
+  uint8_t misfireLimit;  // max catch-up runs for MisfireRunAll
+  uint8_t httpMethod;    // HttpQueueMethod (HttpRequest only)
   int value;
   uint32_t lastExecEpoch; // Y2038-safe (unsigned); valid until year 2106
+  union {
+    char url[CRON_URL_MAX_LEN]; // HttpRequest
+    uint32_t pulseMs;           // PulsePinState
+  };
 };
 
 /**
@@ -84,12 +175,65 @@ struct CronJob {
  */
 String cronActionToString(CronAction action);
 
+/**
+ * @brief Converts a CronMisfirePolicy value to its string representation.
+ *
+ * @param policy The CronMisfirePolicy value
+ * @return "Skip", "Once", "All" or "Unknown"
+ */
+String cronMisfireToString(uint8_t policy);
+
+/**
+ * @brief Compiles a 5-field cron expression into bitmasks.
+ *
+ * Supported field syntax: "*", "n", "a-b", comma-separated lists, and
+ * steps ("a-b/s", "a/s", or a wildcard followed by "/s"). Day of week
+ * accepts 0-7 (0 and 7 are Sunday).
+ *
+ * Instead of the 5 fields, "@sunrise" or "@sunset" with an optional
+ * offset in minutes ("@sunset-30", "@sunrise+15", up to 720) anchors the
+ * job to the solar event of every day at the configured location.
+ *
+ * @param expr Cron expression (m h dom mon dow)
+ * @param out Compiled schedule (out.valid is false on error)
+ * @return true if the expression is valid
+ */
+bool cronCompile(const char *expr, CronSchedule &out);
+
+/**
+ * @brief Computes the next fire time of a schedule.
+ *
+ * Solar schedules use the event times cached by the Solar module and
+ * never fire while no location is configured (no search is made). The
+ * scheduler recomputes them when the location changes.
+ *
+ * @param sched Compiled schedule
+ * @param afterEpoch Search strictly after this epoch
+ * @return Epoch (minute aligned) of the next occurrence, or 0 if none is
+ * found within the search bound
+ */
+uint32_t cronNextFire(const CronSchedule &sched, uint32_t afterEpoch);
+
+/**
+ * @brief Whether a schedule ever fires.
+ *
+ * Field expressions can compile and still match no date ("0 0 30 2 *").
+ * Solar schedules are always accepted: their events depend on the
+ * location, which may be set later.
+ *
+ * @param sched Compiled schedule
+ * @return true if the schedule is valid and has an occurrence
+ */
+bool cronCanFire(const CronSchedule &sched);
+
 /**
  * @brief Initializes the cron scheduler.
  *
  * - Sets up internal data structures and prepares the scheduler
  * - Inizialization of cron jobs storage
- * - Inizialization of NTPClient for timekeeping
+ *
+ * Time is read from the Clock module (clockInit() must run first); the
+ * scheduler does not wait for the first sync.
  *
  * @return true if initialization was successful, false otherwise
  */
@@ -98,29 +242,128 @@ bool cronSchedulerInit();
 /**
  * @brief Sets a cron job at the specified index.
  *
+ * Only the job's fixed-size record is rewritten in the job table file.
+ *
+ * If `job.lastExecEpoch` is zero and the clock is synchronized, it is set
+ * to the current time so that the job's catch-up window starts now.
+ *
  * @param index The index of the cron job to set (0 to MAX_CRON_JOBS-1)
  * @param job The CronJob structure containing the job details
  * @return true if the job was set successfully, false otherwise
  */
-bool setCronJob(uint8_t index, const CronJob &job);
+bool setCronJob(uint16_t index, const CronJob &job);
 
 /**
- * @brief Retrieves all cron jobs.
+ * @brief Sets several cron jobs with a single storage operation.
+ *
+ * Every record is rewritten in place; all of them share one open of the
+ * table file. No job is changed if any index is out of range.
+ *
+ * @param indices Slot index of each job (0 to MAX_CRON_JOBS-1)
+ * @param jobs Job definitions, same order as `indices`
+ * @param count Number of jobs
+ * @return true if all jobs were stored successfully
+ */
+bool cronSetJobs(const uint16_t *indices, const CronJob *jobs, size_t count);
+
+/**
+ * @brief Removes every cron job with a single storage write.
+ *
+ * @return true if the cleared table was stored successfully
+ */
+bool cronClearAll();
+
+/**
+ * @brief Starts replacing the whole job table.
+ *
+ * Jobs added with cronImportJob() go to a new table file that replaces the
+ * current one in cronImportCommit(); until then the scheduler keeps
+ * running the current jobs, and a failed or aborted import leaves them
+ * untouched.
+ *
+ * @return false if the new table could not be created
+ */
+bool cronImportBegin();
+
+/**
+ * @brief Adds a job to the table being imported.
+ *
+ * Jobs must come in increasing slot order; slots left out are empty. The
+ * catch-up window of every imported job starts at the import.
  *
- * @return Pointer to the array of all cron jobs.
+ * @param index Slot index (0 to MAX_CRON_JOBS-1)
+ * @param job Job definition
+ * @return false if no import is open, the index is out of order, an
+ * active job's schedule never fires (see cronCanFire()) or the write
+ * failed
  */
-CronJob *cronGetAll();
+bool cronImportJob(uint16_t index, const CronJob &job);
 
 /**
- * @brief Retrieves a cron job by index.
+ * @brief Replaces the job table with the imported one (a single rename)
+ * and rebuilds the RAM index.
+ *
+ * @return false if the import failed (the current jobs are kept)
+ */
+bool cronImportCommit();
+
+/**
+ * @brief Discards an open import.
+ */
+void cronImportAbort();
+
+/**
+ * @brief Reads a cron job from storage.
+ *
+ * Slots that were never written (or whose record is damaged) read as an
+ * empty, inactive job.
  *
  * @param index The index of the cron job to retrieve (0 to MAX_CRON_JOBS-1)
- * @return Pointer to the CronJob structure at the specified index, or nullptr
- * if index is out of range
+ * @param out Job definition, with the current last execution time
+ * @return false if the index is out of range or the record cannot be read
+ */
+bool cronGet(uint16_t index, CronJob &out);
+
+/**
+ * @brief Whether a slot holds an active job (RAM index, no storage access).
+ *
+ * @param index Slot index
+ * @return true if the slot is in range and its job is active
  */
-CronJob *cronGet(uint8_t index);
+bool cronIsActive(uint16_t index);
+
+/**
+ * @brief Finds the first slot without an active job.
+ *
+ * @return Slot index, or -1 if every slot is in use
+ */
+int cronFindFreeSlot();
+
+/**
+ * @brief Number of active jobs.
+ */
+uint16_t cronActiveCount();
+
+/**
+ * @brief Discards every precomputed next fire time.
+ *
+ * Call after a change that moves local time (e.g. a new timezone); the
+ * schedules are recomputed on the next tick. Schedules without a next
+ * occurrence are otherwise searched again only once an hour.
+ */
+void cronReschedule();
 
 /**
  * @brief Main loop function for the cron scheduler.
+ *
+ * Once per second:
+ * - detects wall-clock steps against millis() and handles them explicitly
+ *   (forward steps go through the misfire policy, small backward steps
+ *   never re-run an occurrence, large ones reset the schedules)
+ * - runs every job whose next fire time has been reached, applying the
+ *   job's misfire policy when it is later than CRON_EXEC_WINDOW_SEC
+ * - reads the record of a job from flash only when it is due
+ * - persists the changed last-exec entries at most once per tick, and
+ *   always before a Reboot action
  */
 void cronSchedulerLoop();
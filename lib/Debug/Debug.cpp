@@ -4,6 +4,7 @@
 #include <stdio.h>
 
 #include "EepromConfig.h"
+#include "KvStore.h"
 
 namespace {
 bool debugActive = false;
@@ -16,11 +17,12 @@ template <typename T> void printTag(const T &tag) {
 
 void debugInit() {
   bool storedFlag = false;
-  if (loadDebugFlag(&storedFlag)) {
-    debugActive = storedFlag;
-  } else {
-    debugActive = false;
+  if (!kvGetBool(KvKeyDebugFlag, storedFlag)) {
+    // Flag of older firmware: move it out of EEPROM
+    if (loadDebugFlag(&storedFlag) && kvSetBool(KvKeyDebugFlag, storedFlag))
+      clearDebugFlag();
   }
+  debugActive = storedFlag;
 
   Serial.println(debugActive ? F("[DEBUG] Serial debug ENABLED")
                              : F("[DEBUG] Serial debug DISABLED"));
@@ -34,6 +36,14 @@ void debugSetEnabled(bool enabled) {
                              : F("[DEBUG] Runtime debug DISABLED"));
 }
 
+bool debugSaveEnabled(bool enabled) {
+  if (!kvSetBool(KvKeyDebugFlag, enabled))
+    return false;
+
+  debugSetEnabled(enabled);
+  return true;
+}
+
 void debugPrint(const String &message) {
   if (!debugActive)
     return;
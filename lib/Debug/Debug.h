@@ -3,7 +3,10 @@
 #include <Arduino.h>
 
 /**
- * @brief Initializes the debug subsystem using the persisted EEPROM flag.
+ * @brief Initializes the debug subsystem using the flag persisted in the
+ * key-value store (call after kvInit()).
+ *
+ * The flag of older firmware is moved from EEPROM on first boot.
  */
 void debugInit();
 
@@ -13,10 +16,19 @@ void debugInit();
 bool debugEnabled();
 
 /**
- * @brief Overrides the runtime debug state without touching EEPROM.
+ * @brief Overrides the runtime debug state without persisting it.
  */
 void debugSetEnabled(bool enabled);
 
+/**
+ * @brief Persists the debug flag in the key-value store and applies it.
+ *
+ * Inside an open kvBegin() batch the flag is stored by kvCommit().
+ *
+ * @return false if the flag could not be stored (or added to the batch)
+ */
+bool debugSaveEnabled(bool enabled);
+
 /**
  * @brief Prints a message without a trailing newline when debug is enabled.
  */
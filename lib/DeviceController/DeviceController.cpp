@@ -1,23 +1,497 @@
 #include "DeviceController.h"
 #include <BinaryStorage.h>
+#include <Clock.h>
 #include <GpioUtils.h>
+#include <coredecls.h>
 
 #include <Debug.h>
 
 #define STORAGE_PATH "/gpio_state.bin"
 #define FILE_SIZE sizeof(GpioConfig) * MAX_GPIO_PINS
 
+#define JOURNAL_PATH "/gpio_journal.bin"
+#define SNAPSHOT_MAGIC 0x534F5047 // "GPOS"
+
+/* Records read per storage access during replay */
+#define JOURNAL_READ_BATCH 16
+
+/**
+ * @brief State table as persisted by a compaction.
+ *
+ * `seq` is the last journal sequence number folded in: records up to it
+ * are already contained, which makes a journal left over by a compaction
+ * interrupted before its removal harmless.
+ */
+struct GpioSnapshot {
+  uint32_t magic;
+  uint32_t seq;
+  GpioConfig table[MAX_GPIO_PINS];
+};
+
+/**
+ * @brief One journaled pin change (absolute state, not a delta).
+ */
+struct JournalRecord {
+  uint32_t seq;
+  uint8_t pin;
+  uint8_t mode;
+  uint16_t check; // low 16 bits of the CRC32 of the record
+  int32_t state;
+};
+
+#define PULSE_RTC_MAGIC 0x50554C53 // "PULS"
+
 static GpioConfig gpioState[MAX_GPIO_PINS];
 
+/**
+ * @brief A pin driven to a temporary value until its deadline.
+ */
+struct PulseEntry {
+  uint8_t pin;
+  int pulseState;
+  int revertState;
+  uint64_t deadlineMs; // clockMonoMs()
+};
+
+/**
+ * @brief Pending pulses as kept in RTC memory (survives a soft reboot).
+ */
+struct PulseRtcRecord {
+  uint32_t magic;
+  uint32_t count;
+  struct {
+    uint32_t pin;
+    int32_t pulseState;
+    int32_t revertState;
+    uint32_t remainingMs;
+  } entries[MAX_PULSES];
+  uint32_t crc;
+};
+
+#define OUTPUT_RTC_MAGIC 0x43545247 // "GRTC"
+
+/**
+ * @brief GPIO table as mirrored in RTC memory (survives a soft reboot).
+ *
+ * States are the persisted ones (pulses reverted), as in the flash copy;
+ * the journal position lets deviceInit() continue without reading flash.
+ * Input and analog states are not mirrored.
+ */
+struct OutputRtcRecord {
+  uint32_t magic;
+  uint32_t journalSeq;
+  uint16_t journalCount;
+  uint16_t reserved;
+  struct {
+    uint8_t mode;
+    uint8_t reserved;
+    uint16_t state;
+  } pins[MAX_GPIO_PINS];
+  uint32_t crc;
+};
+
+static_assert(PULSE_RTC_BLOCK >= 32,
+              "pulse RTC record in the area overwritten by OTA updates");
+static_assert(PULSE_RTC_BLOCK * 4 + sizeof(PulseRtcRecord) <=
+                  OUTPUT_RTC_BLOCK * 4,
+              "pulse and output RTC records overlap");
+static_assert(OUTPUT_RTC_BLOCK * 4 + sizeof(OutputRtcRecord) <= 512,
+              "output RTC record exceeds RTC user memory");
+
+static DeviceBootInfo bootInfo;
+
+/* CRC of the last mirror written, to skip identical writes */
+static uint32_t outputRtcCrc = 0;
+
+/* Timer queue: active pulses sorted by deadline */
+static PulseEntry pulses[MAX_PULSES];
+static uint8_t pulseCount = 0;
+static uint64_t pulseRtcSavedAt = 0;
+
+/* Journal position */
+static uint32_t journalSeq = 0;
+static uint16_t journalCount = 0;
+
+/**
+ * @brief State of a pin as it should be persisted (pulse reverted).
+ */
+static int persistedState(uint8_t pin) {
+  for (uint8_t i = 0; i < pulseCount; i++) {
+    if (pulses[i].pin == pin)
+      return pulses[i].revertState;
+  }
+  return gpioState[pin].state;
+}
+
+/**
+ * @brief Mirrors the GPIO table and journal position to RTC memory.
+ */
+static void saveOutputsToRtc() {
+  OutputRtcRecord rec = {};
+  rec.magic = OUTPUT_RTC_MAGIC;
+  rec.journalSeq = journalSeq;
+  rec.journalCount = journalCount;
+
+  for (uint8_t i = 0; i < MAX_GPIO_PINS; i++) {
+    PinMode mode = gpioState[i].mode;
+
+    rec.pins[i].mode = (uint8_t)mode;
+    if (mode == PinMode::Output || mode == PinMode::Pwm)
+      rec.pins[i].state = persistedState(i);
+  }
+  rec.crc = crc32((const uint8_t *)&rec, offsetof(OutputRtcRecord, crc));
+
+  if (rec.crc == outputRtcCrc)
+    return;
+
+  ESP.rtcUserMemoryWrite(OUTPUT_RTC_BLOCK, (uint32_t *)&rec, sizeof(rec));
+  outputRtcCrc = rec.crc;
+}
+
+static bool loadOutputsFromRtc(OutputRtcRecord &rec) {
+  return ESP.rtcUserMemoryRead(OUTPUT_RTC_BLOCK, (uint32_t *)&rec,
+                               sizeof(rec)) &&
+         rec.magic == OUTPUT_RTC_MAGIC &&
+         rec.crc ==
+             crc32((const uint8_t *)&rec, offsetof(OutputRtcRecord, crc));
+}
+
+static bool loadPulsesFromRtc(PulseRtcRecord &rec) {
+  return ESP.rtcUserMemoryRead(PULSE_RTC_BLOCK, (uint32_t *)&rec,
+                               sizeof(rec)) &&
+         rec.magic == PULSE_RTC_MAGIC && rec.count <= MAX_PULSES &&
+         rec.crc == crc32((const uint8_t *)&rec, offsetof(PulseRtcRecord, crc));
+}
+
+static uint16_t journalCheck(JournalRecord rec) {
+  rec.check = 0;
+  return crc32(&rec, sizeof(rec)) & 0xFFFF;
+}
+
+/**
+ * @brief Writes a snapshot of the whole table and empties the journal.
+ *
+ * Every pulsed pin is stored at its final state.
+ */
+static bool saveState() {
+  GpioSnapshot snap;
+  snap.magic = SNAPSHOT_MAGIC;
+  snap.seq = journalSeq;
+  memcpy(snap.table, gpioState, sizeof(snap.table));
+
+  for (uint8_t i = 0; i < MAX_GPIO_PINS; i++)
+    snap.table[i].state = persistedState(i);
+
+  bool ok = storageWrite(STORAGE_PATH, (uint8_t *)&snap, sizeof(snap));
+  if (ok) {
+    journalCount = 0;
+    ok = storageRemove(JOURNAL_PATH);
+  }
+
+  saveOutputsToRtc();
+  return ok;
+}
+
+/**
+ * @brief Appends the current state of some pins to the journal.
+ *
+ * Falls back to a full snapshot when the journal is full or the append
+ * fails.
+ *
+ * @param mask Bit n set = journal pin n
+ */
+static bool journalPins(uint32_t mask) {
+  JournalRecord recs[MAX_GPIO_PINS];
+  uint8_t n = 0;
+
+  for (uint8_t pin = 0; pin < MAX_GPIO_PINS; pin++) {
+    if (!(mask & (1UL << pin)))
+      continue;
+
+    JournalRecord &r = recs[n++];
+    r.seq = ++journalSeq;
+    r.pin = pin;
+    r.mode = (uint8_t)gpioState[pin].mode;
+    r.state = persistedState(pin);
+    r.check = journalCheck(r);
+  }
+
+  if (n == 0)
+    return true;
+
+  if (journalCount + n > GPIO_JOURNAL_MAX_RECORDS ||
+      !storageAppend(JOURNAL_PATH, (uint8_t *)recs, n * sizeof(JournalRecord)))
+    return saveState();
+
+  journalCount += n;
+  saveOutputsToRtc();
+  return true;
+}
+
+/**
+ * @brief Loads the snapshot, or a table written by older firmware.
+ */
+static bool loadSnapshot() {
+  GpioSnapshot snap;
+
+  if (storageRead(STORAGE_PATH, (uint8_t *)&snap, sizeof(snap)) &&
+      snap.magic == SNAPSHOT_MAGIC) {
+    memcpy(gpioState, snap.table, sizeof(gpioState));
+    journalSeq = snap.seq;
+    return true;
+  }
+
+  journalSeq = 0;
+  return storageRead(STORAGE_PATH, (uint8_t *)gpioState, FILE_SIZE);
+}
+
+/**
+ * @brief Applies the journal over the loaded snapshot.
+ *
+ * Replay stops at the first damaged or out-of-sequence record (torn
+ * append after a power cut); the journal is then compacted so that later
+ * appends are not hidden behind the damage.
+ */
+static void replayJournal() {
+  size_t total = storageSize(JOURNAL_PATH) / sizeof(JournalRecord);
+  if (total == 0)
+    return;
+
+  unsigned long start = micros();
+  uint32_t applied = 0;
+  uint32_t stale = 0;
+  bool damaged = storageSize(JOURNAL_PATH) % sizeof(JournalRecord) != 0;
+  uint32_t lastSeq = 0;
+
+  JournalRecord buf[JOURNAL_READ_BATCH];
+
+  for (size_t first = 0; first < total && !damaged;
+       first += JOURNAL_READ_BATCH) {
+    size_t n = total - first;
+    if (n > JOURNAL_READ_BATCH)
+      n = JOURNAL_READ_BATCH;
+
+    if (!storageReadAt(JOURNAL_PATH, first * sizeof(JournalRecord),
+                       (uint8_t *)buf, n * sizeof(JournalRecord))) {
+      damaged = true;
+      break;
+    }
+
+    for (size_t i = 0; i < n; i++) {
+      const JournalRecord &r = buf[i];
+
+      if (r.check != journalCheck(r) || r.pin >= MAX_GPIO_PINS ||
+          r.seq <= lastSeq) {
+        damaged = true;
+        break;
+      }
+      lastSeq = r.seq;
+
+      // Already folded into the snapshot
+      if (r.seq <= journalSeq) {
+        stale++;
+        continue;
+      }
+
+      gpioState[r.pin].mode = (PinMode)r.mode;
+      gpioState[r.pin].state = r.state;
+      applied++;
+    }
+  }
+
+  if (lastSeq > journalSeq)
+    journalSeq = lastSeq;
+  journalCount = applied + stale;
+
+  debugPrintln(F("[DeviceController]"),
+               "Replayed " + String(applied) + " of " + String(total) +
+                   " journal record(s) in " + String(micros() - start) +
+                   " us");
+
+  if (damaged || stale > 0) {
+    debugPrintln(F("[DeviceController]"), F("Compacting GPIO journal"));
+    saveState();
+  }
+}
+
+/**
+ * @brief Mirrors the pending pulses to RTC memory.
+ */
+static void savePulsesToRtc() {
+  PulseRtcRecord rec = {};
+  uint64_t now = clockMonoMs();
+
+  rec.magic = PULSE_RTC_MAGIC;
+  rec.count = pulseCount;
+  for (uint8_t i = 0; i < pulseCount; i++) {
+    rec.entries[i].pin = pulses[i].pin;
+    rec.entries[i].pulseState = pulses[i].pulseState;
+    rec.entries[i].revertState = pulses[i].revertState;
+    rec.entries[i].remainingMs =
+        pulses[i].deadlineMs > now ? pulses[i].deadlineMs - now : 0;
+  }
+  rec.crc = crc32((const uint8_t *)&rec, offsetof(PulseRtcRecord, crc));
+
+  ESP.rtcUserMemoryWrite(PULSE_RTC_BLOCK, (uint32_t *)&rec, sizeof(rec));
+  pulseRtcSavedAt = now;
+}
+
+/**
+ * @brief Removes the pulse of a pin from the queue.
+ *
+ * @return true if the pin was pulsing
+ */
+static bool removePulse(uint8_t pin) {
+  for (uint8_t i = 0; i < pulseCount; i++) {
+    if (pulses[i].pin != pin)
+      continue;
+
+    memmove(&pulses[i], &pulses[i + 1],
+            (pulseCount - i - 1) * sizeof(PulseEntry));
+    pulseCount--;
+    return true;
+  }
+  return false;
+}
+
+/**
+ * @brief Inserts a pulse keeping the queue sorted by deadline.
+ */
+static void insertPulse(const PulseEntry &entry) {
+  uint8_t i = pulseCount;
+  while (i > 0 && pulses[i - 1].deadlineMs > entry.deadlineMs) {
+    pulses[i] = pulses[i - 1];
+    i--;
+  }
+  pulses[i] = entry;
+  pulseCount++;
+}
+
+/**
+ * @brief Whether a pin can carry a pulse in its current mode.
+ */
+static bool pulseAllowed(uint8_t pin) {
+  if (!gpioIsValid(pin))
+    return false;
+
+  PinMode mode = gpioState[pin].mode;
+  return mode == PinMode::Output || mode == PinMode::Pwm;
+}
+
+/**
+ * @brief Resumes the pulses that were pending before a soft reboot.
+ */
+static void restorePulsesFromRtc() {
+  PulseRtcRecord rec;
+  if (!loadPulsesFromRtc(rec))
+    return;
+
+  uint64_t now = clockMonoMs();
+
+  for (uint32_t i = 0; i < rec.count; i++) {
+    uint8_t pin = rec.entries[i].pin;
+
+    // The configuration changed meanwhile: flash already has the final state
+    if (pin >= MAX_GPIO_PINS || !pulseAllowed(pin) ||
+        gpioState[pin].state != rec.entries[i].revertState)
+      continue;
+
+    PulseEntry entry = {pin, rec.entries[i].pulseState,
+                        rec.entries[i].revertState,
+                        now + rec.entries[i].remainingMs};
+
+    gpioState[pin].state = entry.pulseState;
+    applyConfigToHardware(gpioState[pin]);
+    insertPulse(entry);
+
+    debugPrintln(F("[DeviceController]"),
+                 "Resumed pulse on pin " + String(pin) + ", " +
+                     String(rec.entries[i].remainingMs) + " ms left");
+  }
+
+  savePulsesToRtc();
+}
+
+/**
+ * Restores outputs from the RTC mirror, before anything else has run.
+ * Output latches are set before the pins are switched to output, so
+ * they come up at the right level.
+ */
+void deviceEarlyRestore() {
+  OutputRtcRecord rec;
+  if (!loadOutputsFromRtc(rec))
+    return;
+
+  for (uint8_t i = 0; i < MAX_GPIO_PINS; i++)
+    gpioState[i] = {i, (PinMode)rec.pins[i].mode, rec.pins[i].state};
+
+  journalSeq = rec.journalSeq;
+  journalCount = rec.journalCount;
+
+  // Outputs that were pulsing come back at their pulse level
+  PulseRtcRecord pulse;
+  bool pulsing = loadPulsesFromRtc(pulse);
+
+  for (uint8_t pin = 0; pin <= 16; pin++) {
+    if (!gpioIsValid(pin))
+      continue;
+
+    int level = gpioState[pin].state;
+    for (uint32_t k = 0; pulsing && k < pulse.count; k++) {
+      if (pulse.entries[k].pin == pin &&
+          pulse.entries[k].revertState == level)
+        level = pulse.entries[k].pulseState;
+    }
+
+    switch (gpioState[pin].mode) {
+    case PinMode::Output:
+      digitalWrite(pin, level ? HIGH : LOW);
+      pinMode(pin, OUTPUT);
+      break;
+
+    case PinMode::Input:
+      pinMode(pin, INPUT);
+      break;
+
+    case PinMode::InputPullup:
+      pinMode(pin, INPUT_PULLUP);
+      break;
+
+    default:
+      break;
+    }
+  }
+
+  bootInfo.fromRtc = true;
+  bootInfo.restoredUs = micros();
+}
+
+const DeviceBootInfo &deviceBootInfo() { return bootInfo; }
+
 /**
  * Initializes the GPIO subsystem by restoring the last saved configuration
- * from flash memory. If loading fails, all pins are initialized as Disabled.
+ * from the RTC mirror (soft reboot) or from flash memory. If loading fails,
+ * all pins are initialized as Disabled.
  */
 bool deviceInit() {
   debugPrintln(F("[DeviceController]"),
                F("Initializing DeviceController and loading GPIO state..."));
 
-  bool storageOk = storageRead(STORAGE_PATH, (uint8_t *)gpioState, FILE_SIZE);
+  bool storageOk = bootInfo.fromRtc;
+
+  if (storageOk) {
+    debugPrintln(F("[DeviceController]"),
+                 F("GPIO state taken from RTC memory, flash not read"));
+
+    // The filesystem was emptied meanwhile: recreate the snapshot
+    if (storageSize(STORAGE_PATH) == 0)
+      saveState();
+  } else {
+    storageOk = loadSnapshot();
+
+    if (storageOk)
+      replayJournal();
+  }
 
   if (!storageOk) {
     debugPrintln(F("[DeviceController]"),
@@ -27,12 +501,28 @@ bool deviceInit() {
     for (int i = 0; i < MAX_GPIO_PINS; i++) {
       gpioState[i] = {(uint8_t)(i + 1), PinMode::Disabled, LOW};
     }
+
+    // The journal needs a snapshot to be replayed over
+    saveState();
   }
 
+  // Pulses first, so that pulsing outputs never show their final state
+  restorePulsesFromRtc();
+
   for (int i = 0; i < MAX_GPIO_PINS; i++) {
     applyConfigToHardware(gpioState[i]);
   }
 
+  if (!bootInfo.fromRtc)
+    bootInfo.restoredUs = micros();
+
+  saveOutputsToRtc();
+
+  debugPrintln(F("[DeviceController]"),
+               "Outputs restored from " +
+                   String(bootInfo.fromRtc ? "RTC memory" : "flash") + " " +
+                   String(bootInfo.restoredUs) + " us after reset");
+
   return true;
 }
 
@@ -96,7 +586,7 @@ bool deviceSet(GpioConfig &config) {
     gpioState[A0_INDEX].mode = PinMode::Analog;
     gpioState[A0_INDEX].state = analogRead(A0);
 
-    storageWrite(STORAGE_PATH, (uint8_t *)gpioState, FILE_SIZE);
+    journalPins(1UL << A0_INDEX);
     return true;
   }
 
@@ -143,13 +633,98 @@ bool deviceSet(GpioConfig &config) {
     return false;
   }
 
-  // Update cached state and persist it to flash
+  // A direct set overrides a pulse in progress
+  if (removePulse(config.pin))
+    savePulsesToRtc();
+
+  // Update cached state and journal the change
   gpioState[config.pin] = config;
-  storageWrite(STORAGE_PATH, (uint8_t *)gpioState, FILE_SIZE);
+  journalPins(1UL << config.pin);
 
   return true;
 }
 
+/**
+ * Drives an output to a value for a duration; the revert is queued.
+ */
+bool devicePulse(uint8_t pin, int value, uint32_t durationMs) {
+  if (!pulseAllowed(pin) || durationMs == 0 ||
+      durationMs > PULSE_MAX_DURATION_MS)
+    return false;
+
+  if (gpioState[pin].mode == PinMode::Output)
+    value = value ? 1 : 0;
+
+  // Re-pulsing keeps the state from before the first pulse
+  int revertState = gpioState[pin].state;
+  for (uint8_t i = 0; i < pulseCount; i++) {
+    if (pulses[i].pin == pin)
+      revertState = pulses[i].revertState;
+  }
+
+  removePulse(pin);
+  if (pulseCount >= MAX_PULSES)
+    return false;
+
+  insertPulse({pin, value, revertState, clockMonoMs() + durationMs});
+  savePulsesToRtc();
+
+  // RAM and hardware only: flash keeps the final state
+  gpioState[pin].state = value;
+  applyConfigToHardware(gpioState[pin]);
+
+  debugPrintln(F("[DeviceController]"),
+               "Pulse on pin " + String(pin) + " for " + String(durationMs) +
+                   " ms, reverting to " + String(revertState));
+  return true;
+}
+
+uint32_t deviceWriteOutputs(uint32_t setMask, uint32_t clearMask) {
+  uint32_t applied = 0;
+
+  for (uint8_t pin = 0; pin <= 16; pin++) {
+    if (((setMask | clearMask) & (1UL << pin)) && gpioIsValid(pin) &&
+        gpioState[pin].mode == PinMode::Output)
+      applied |= 1UL << pin;
+  }
+
+  uint32_t high = setMask & applied;
+  uint32_t low = clearMask & applied & ~high;
+
+  // Timing-critical part: one register write per direction
+  GPOS = high & 0xFFFF;
+  GPOC = low & 0xFFFF;
+  if (applied & (1UL << 16))
+    digitalWrite(16, (high >> 16) & 1 ? HIGH : LOW);
+
+  bool pulsesChanged = false;
+  for (uint8_t pin = 0; pin <= 16; pin++) {
+    if (!(applied & (1UL << pin)))
+      continue;
+
+    pulsesChanged |= removePulse(pin);
+    gpioState[pin].state = (high >> pin) & 1;
+  }
+
+  if (pulsesChanged)
+    savePulsesToRtc();
+
+  if (applied)
+    journalPins(applied);
+
+  return applied;
+}
+
+uint32_t devicePulseRemaining(uint8_t pin) {
+  uint64_t now = clockMonoMs();
+
+  for (uint8_t i = 0; i < pulseCount; i++) {
+    if (pulses[i].pin == pin)
+      return pulses[i].deadlineMs > now ? pulses[i].deadlineMs - now : 0;
+  }
+  return 0;
+}
+
 /**
  * Replace ALL GPIO configurations with a new set.
  *
@@ -166,6 +741,12 @@ bool deviceSet(GpioConfig &config) {
  */
 bool deviceReplaceAll(const GpioConfig *configs, size_t count) {
 
+  // A new configuration cancels every pulse
+  if (pulseCount > 0) {
+    pulseCount = 0;
+    savePulsesToRtc();
+  }
+
   // Disable all digital pins
   for (int pin = 0; pin <= 16; pin++) {
     if (!gpioIsValid(pin))
@@ -241,7 +822,7 @@ bool deviceReplaceAll(const GpioConfig *configs, size_t count) {
   }
 
   // Persist entire table to flash
-  return storageWrite(STORAGE_PATH, (uint8_t *)gpioState, FILE_SIZE);
+  return saveState();
 }
 
 /**
@@ -292,11 +873,29 @@ int deviceRead(uint8_t pin) {
 }
 
 /**
- * Periodic handler used to refresh the cached state of digital input
- * and analog input pins.
+ * Periodic handler used to revert expired pulses and to refresh the
+ * cached state of digital input and analog input pins.
  */
 void deviceLoop() {
 
+  // Revert expired pulses (queue head has the earliest deadline)
+  if (pulseCount > 0) {
+    uint64_t now = clockMonoMs();
+    bool changed = false;
+
+    while (pulseCount > 0 && pulses[0].deadlineMs <= now) {
+      GpioConfig &cfg = gpioState[pulses[0].pin];
+      cfg.state = pulses[0].revertState;
+      applyConfigToHardware(cfg);
+
+      removePulse(cfg.pin);
+      changed = true;
+    }
+
+    if (changed || now - pulseRtcSavedAt >= PULSE_RTC_REFRESH_MS)
+      savePulsesToRtc();
+  }
+
   // Refresh digital inputs
   for (int pin = 0; pin <= 16; pin++) {
     if (!gpioIsValid(pin))
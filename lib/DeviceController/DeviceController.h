@@ -4,6 +4,73 @@
 #include <ArduinoJson.h>
 #include <GpioUtils.h>
 
+/**
+ * @brief Maximum number of pins with a pulse in progress.
+ */
+#define MAX_PULSES 4
+
+/**
+ * @brief Longest accepted pulse, in milliseconds (24 hours).
+ */
+#define PULSE_MAX_DURATION_MS 86400000UL
+
+/**
+ * @brief First RTC user memory block (4 bytes each) holding the pending
+ * pulse reverts (19 blocks). Blocks 0-31 (the first 128 bytes) are left
+ * free: an OTA update overwrites them.
+ */
+#define PULSE_RTC_BLOCK 32
+
+/**
+ * @brief First RTC user memory block holding the mirror of the GPIO table
+ * (22 blocks), right after the pulse record.
+ */
+#define OUTPUT_RTC_BLOCK 52
+
+/**
+ * @brief Interval (in milliseconds) at which the remaining time of active
+ * pulses is refreshed in RTC memory.
+ */
+#define PULSE_RTC_REFRESH_MS 1000
+
+/**
+ * @brief Journal length (in records) that triggers a compaction.
+ *
+ * Single pin changes are appended to a journal as 12-byte records instead
+ * of rewriting the whole state table; once the journal holds this many
+ * records it is folded into a new snapshot and emptied.
+ */
+#define GPIO_JOURNAL_MAX_RECORDS 128
+
+/**
+ * @brief How the outputs were restored at boot.
+ */
+struct DeviceBootInfo {
+  bool fromRtc;        // soft reboot: table taken from the RTC mirror
+  uint32_t restoredUs; // micros() when the outputs were correct again
+};
+
+/**
+ * @brief Drives the outputs to their state before a soft reboot.
+ *
+ * The GPIO table (persisted states, plus pending pulses) is mirrored to
+ * RTC user memory with a CRC on every change. After a reset that keeps
+ * RTC memory (ESP.restart(), watchdog, reset pin) this restores digital
+ * outputs and inputs directly from the mirror, long before LittleFS is
+ * mounted; deviceInit() then takes the table from the mirror and does not
+ * read flash. After a power-on the mirror fails its CRC and nothing
+ * happens here.
+ *
+ * Meant for the core's preinit() hook: no Serial, no heap, no filesystem.
+ * PWM outputs are started later by deviceInit().
+ */
+void deviceEarlyRestore();
+
+/**
+ * @brief How the outputs were restored at boot and how long it took.
+ */
+const DeviceBootInfo &deviceBootInfo();
+
 /**
  * @brief Initializes all GPIO hardware according to the current configuration.
  *
@@ -47,6 +114,48 @@ void applyConfigToHardware(const GpioConfig &cfg);
  */
 bool deviceSet(GpioConfig &config);
 
+/**
+ * @brief Drives an output to a value for a duration, then reverts it.
+ *
+ * The pin must be configured as Output or Pwm. The revert is handled by a
+ * millisecond timer queue polled in deviceLoop(), independent of the cron
+ * tick. Only the final (reverted) state is ever written to flash; the
+ * pending revert is kept in RTC memory, so after a soft reboot the pulse
+ * resumes for its remaining time and still reverts. After a power loss the
+ * pin starts in its final state.
+ *
+ * Pulsing a pin that is already pulsing restarts the timer and keeps the
+ * original revert state. deviceSet() on the pin cancels its pulse.
+ *
+ * @param pin GPIO number
+ * @param value Output value during the pulse (0/1, or PWM duty)
+ * @param durationMs Pulse length (1 to PULSE_MAX_DURATION_MS)
+ * @return false if the pin cannot be pulsed or too many pulses are active
+ */
+bool devicePulse(uint8_t pin, int value, uint32_t durationMs);
+
+/**
+ * @brief Remaining time of the pulse on a pin.
+ *
+ * @param pin GPIO number
+ * @return Milliseconds until the revert, or 0 if the pin is not pulsing
+ */
+uint32_t devicePulseRemaining(uint8_t pin);
+
+/**
+ * @brief Switches several digital outputs at the same instant.
+ *
+ * GPIO0-15 are written with one set and one clear register access, so all
+ * of them change together; GPIO16 follows immediately after. Only pins
+ * currently in Output mode are touched; pulses on them are cancelled. The
+ * resulting states are persisted once, after the switch.
+ *
+ * @param setMask Bit n set = drive GPIOn high
+ * @param clearMask Bit n set = drive GPIOn low (ignored where setMask wins)
+ * @return Mask of the pins that were actually switched
+ */
+uint32_t deviceWriteOutputs(uint32_t setMask, uint32_t clearMask);
+
 /**
  * @brief Replaces the entire GPIO configuration with a new set.
  *
@@ -63,7 +172,7 @@ bool deviceReplaceAll(const GpioConfig *configs, size_t count);
  * @brief Periodic handler for time-based and background GPIO tasks.
  *
  * This function is intended to be called repeatedly inside the main loop().
- * It can be used for:
+ * It reverts expired pulses (see devicePulse()) and can be used for:
  * - Software PWM generation
  * - PWM fading effects
  * - State schedulers
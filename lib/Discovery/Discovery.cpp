@@ -0,0 +1,138 @@
+#include "Discovery.h"
+#include <Auth.h>
+#include <CronScheduler.h>
+#include <DeviceController.h>
+#include <ESP8266mDNS.h>
+#include <WifiManager.h>
+#include <coredecls.h>
+
+#include <Debug.h>
+
+static bool active = false;
+static MDNSResponder::hMDNSService service = nullptr;
+
+static uint32_t stateVersion = 0;
+static uint32_t stateHash = 0;
+static bool versionInit = false;
+
+static unsigned long lastCheck = 0;
+static unsigned long lastAnnounce = 0;
+static bool announcePending = false;
+
+/**
+ * @brief CRC32 of everything the state version covers.
+ */
+static uint32_t computeStateHash() {
+  GpioConfig *pins = deviceGetAll();
+  uint32_t crc = 0xFFFFFFFF;
+
+  for (uint8_t i = 0; i < MAX_GPIO_PINS; i++) {
+    int32_t entry[2];
+    entry[0] = (int32_t)pins[i].mode;
+
+    // Analog readings jitter: only the mode counts
+    entry[1] = pins[i].mode == PinMode::Analog ? 0 : pins[i].state;
+
+    crc = crc32(entry, sizeof(entry), crc);
+  }
+
+  uint8_t flags[4];
+  uint16_t cron = cronActiveCount();
+  flags[0] = getAuthEnabled();
+  flags[1] = debugEnabled();
+  flags[2] = cron & 0xFF;
+  flags[3] = cron >> 8;
+
+  return crc32(flags, sizeof(flags), crc);
+}
+
+/**
+ * @brief Fills the TXT records that can change at runtime; called by the
+ * responder whenever it answers or announces.
+ */
+static void addDynamicTxt(const MDNSResponder::hMDNSService svc) {
+  MDNS.addDynamicServiceTxt(svc, "auth", getAuthEnabled() ? "hmac" : "none");
+  MDNS.addDynamicServiceTxt(svc, "sv", stateVersion);
+}
+
+static bool startResponder() {
+  String host = discoveryHostname();
+
+  if (!MDNS.begin(host.c_str())) {
+    debugPrintln(F("[MDNS]"), F("mDNS responder failed to start"));
+    return false;
+  }
+
+  service = MDNS.addService(host.c_str(), DISCOVERY_SERVICE, DISCOVERY_PROTO,
+                            80);
+  if (!service) {
+    debugPrintln(F("[MDNS]"), F("Service registration failed"));
+    MDNS.end();
+    return false;
+  }
+
+  char chip[9];
+  snprintf(chip, sizeof(chip), "%06x", (unsigned)ESP.getChipId());
+
+  MDNS.addServiceTxt(service, "chip", chip);
+  MDNS.addServiceTxt(service, "fw", FIRMWARE_VERSION);
+  MDNS.setDynamicServiceTxtCallback(service, addDynamicTxt);
+
+  debugPrintf(F("[MDNS]"), "Advertising _%s._%s as %s.local",
+              DISCOVERY_SERVICE, DISCOVERY_PROTO, host.c_str());
+  return true;
+}
+
+void discoveryLoop() {
+  unsigned long now = millis();
+
+  if (!versionInit) {
+    stateVersion = os_random();
+    stateHash = computeStateHash();
+    versionInit = true;
+  }
+
+  if (now - lastCheck >= DISCOVERY_CHECK_MS) {
+    lastCheck = now;
+
+    uint32_t hash = computeStateHash();
+    if (hash != stateHash) {
+      stateHash = hash;
+      stateVersion++;
+      announcePending = true;
+    }
+  }
+
+  if (!active) {
+    if (!wifiIsConnected())
+      return;
+
+    // Retried on the next check if it fails
+    if (now - lastAnnounce < DISCOVERY_ANNOUNCE_MIN_MS)
+      return;
+    lastAnnounce = now;
+
+    active = startResponder();
+    announcePending = false;
+    return;
+  }
+
+  MDNS.update();
+
+  if (announcePending && now - lastAnnounce >= DISCOVERY_ANNOUNCE_MIN_MS) {
+    MDNS.announce();
+    lastAnnounce = now;
+    announcePending = false;
+  }
+}
+
+uint32_t discoveryStateVersion() { return stateVersion; }
+
+String discoveryHostname() {
+  char host[32];
+  snprintf(host, sizeof(host), DISCOVERY_HOST_PREFIX "%06x",
+           (unsigned)ESP.getChipId());
+  return String(host);
+}
+
+bool discoveryActive() { return active; }
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <Arduino.h>
+
+/**
+ * @brief Firmware version advertised in the "fw" TXT record and returned
+ * by /api/state. Override with a build flag (-DFIRMWARE_VERSION=\"x.y.z\").
+ */
+#ifndef FIRMWARE_VERSION
+#define FIRMWARE_VERSION "1.0.0"
+#endif
+
+/**
+ * @brief DNS-SD service type: `_esp-gpio._tcp`.
+ */
+#define DISCOVERY_SERVICE "esp-gpio"
+#define DISCOVERY_PROTO "tcp"
+
+/**
+ * @brief Prefix of the hostname and service instance name, followed by
+ * the chip ID in hex (e.g. esp-gpio-1a2b3c.local).
+ */
+#define DISCOVERY_HOST_PREFIX "esp-gpio-"
+
+/**
+ * @brief Interval between two checks of the device state, in milliseconds.
+ */
+#define DISCOVERY_CHECK_MS 500
+
+/**
+ * @brief Minimum time between two announcements of a changed state
+ * version, in milliseconds. Changes in between are sent together.
+ */
+#define DISCOVERY_ANNOUNCE_MIN_MS 2000
+
+/**
+ * @brief Advances the state version and runs the mDNS responder.
+ *
+ * The responder is started with the first WiFi link and advertises the
+ * REST API (port 80) as `_esp-gpio._tcp` with the TXT records:
+ *
+ * - chip: chip ID (hex)
+ * - fw: FIRMWARE_VERSION
+ * - auth: "hmac" or "none"
+ * - sv: state version
+ *
+ * The state version changes whenever the pin table (modes, digital and
+ * PWM values; not analog readings), the number of active cron jobs or the
+ * auth and debug flags change, and the new value is announced at most
+ * every DISCOVERY_ANNOUNCE_MIN_MS. It starts at a random value at boot:
+ * clients should compare it for equality only.
+ *
+ * This function must be called repeatedly inside the main loop().
+ */
+void discoveryLoop();
+
+/**
+ * @brief Current state version.
+ */
+uint32_t discoveryStateVersion();
+
+/**
+ * @brief mDNS hostname (without ".local").
+ */
+String discoveryHostname();
+
+/**
+ * @brief Whether the mDNS responder is running.
+ */
+bool discoveryActive();
@@ -1,99 +1,244 @@
 #include "EepromConfig.h"
+#include <BinaryStorage.h>
 #include <EEPROM.h>
+#include <KvStore.h>
+#include <coredecls.h>
 
 /*
- * EEPROM memory layout (total size: 128 bytes)
+ * EEPROM memory layout (total size: 512 bytes)
  *
  * Address range | Size | Purpose
  * --------------|------|-------------------------------------------
- * 0             | 1    | MAGIC byte (0x42 = initialized EEPROM)
- * 1             | 1    | Authentication enabled flag (0xA5 = enabled)
- * 2  – 33       | 32   | Authentication shared secret (binary)
- * 34 – 39       | 6    | Reserved (future use / alignment)
- * 40 – 70       | 31   | WiFi SSID
- * 71            | 1    | Reserved
- * 72 – 102      | 31   | WiFi password
- * 103           | 1    | Serial debug flag (0xA5 = enabled)
- * 104 – 127     | 24   | Free / reserved
+ * 0   – 127     | 128  | Legacy byte layout (cleared after migration)
+ * 128 – 319     | 192  | Configuration record, slot A
+ * 320 – 511     | 192  | Configuration record, slot B
  *
  * Notes:
- * - EEPROM is emulated in flash on ESP8266.
- * - MAGIC byte is used to detect first boot / uninitialized memory.
- * - All flags use value 0xA5 to indicate enabled/valid state.
- * - Authentication keys are stored in binary form.
+ * - EEPROM is emulated in flash on ESP8266: every commit erases and
+ *   rewrites the whole sector, so the number of commits is what wears it.
+ * - The record (EepromRecord) is loaded once into RAM at eepromInit();
+ *   getters never touch EEPROM. The emulation buffer is only allocated
+ *   while a record is being written.
+ * - Each commit writes the next generation into the other slot, so the
+ *   previous one stays intact: a record that fails its CRC falls back to
+ *   the older copy instead of losing the configuration.
+ * - Setters only commit when a value actually changes.
+ * - The legacy layout (magic byte 0x42 at address 0, flags = 0xA5) is
+ *   migrated on first boot.
+ * - The authentication and debug fields are only read to migrate them to
+ *   the key-value store, then cleared.
  * - This module contains NO business logic, only storage access.
  */
 
-#define EEPROM_SIZE 128
-
-/* Magic */
-#define MAGIC_ADDR 0
-#define MAGIC_VALUE 0x42
+#define EEPROM_SIZE 512
+
+/* Legacy byte layout */
+#define LEGACY_MAGIC_ADDR 0
+#define LEGACY_MAGIC_VALUE 0x42
+#define LEGACY_AUTH_FLAG_ADDR 1
+#define LEGACY_AUTH_KEY_ADDR 2
+#define LEGACY_SSID_ADDR 40
+#define LEGACY_PASS_ADDR 72
+#define LEGACY_WIFI_LEN 31
+#define LEGACY_DEBUG_FLAG_ADDR 103
+#define LEGACY_FLAG_ON 0xA5
+#define LEGACY_SIZE 128
+
+/* Record slots */
+#define SLOT_A_ADDR 128
+#define SLOT_B_ADDR 320
+#define RECORD_MAGIC 0x47464345 // "ECFG"
+#define RECORD_VERSION 1
 
 /* Authentication */
-#define AUTH_FLAG_ADDR 1
-#define AUTH_KEY_ADDR 2
 #define AUTH_KEY_LEN 32
 
-/* WiFi */
-#define SSID_ADDR 40
-#define PASS_ADDR 72
-#define MAX_WIFI_LEN 31
+/* WiFi (IEEE 802.11 / WPA2 limits) */
+#define WIFI_SSID_MAX_LEN 32
+#define WIFI_PASS_MAX_LEN 64
+
+/* Record flags */
+#define FLAG_AUTH 0x01     // authentication enabled
+#define FLAG_AUTH_KEY 0x02 // authKey holds a key
+#define FLAG_DEBUG 0x04    // serial debug enabled
 
-/* Serial debug */
-#define DEBUG_FLAG_ADDR 103
+/**
+ * @brief Persistent configuration, one generation per commit.
+ */
+struct __attribute__((packed)) EepromRecord {
+  uint32_t magic;
+  uint16_t version;
+  uint16_t length; // sizeof(EepromRecord)
+  uint32_t seq;    // generation, the newest valid slot wins
+  uint8_t flags;
+  uint8_t reserved[3];
+  uint8_t authKey[AUTH_KEY_LEN];
+  char ssid[WIFI_SSID_MAX_LEN + 1];
+  char pass[WIFI_PASS_MAX_LEN + 1];
+  uint32_t crc; // CRC32 of all previous fields
+};
+
+static_assert(sizeof(EepromRecord) <= SLOT_B_ADDR - SLOT_A_ADDR,
+              "EepromRecord does not fit its slot");
+static_assert(SLOT_B_ADDR + (SLOT_B_ADDR - SLOT_A_ADDR) <= EEPROM_SIZE,
+              "EEPROM slots exceed EEPROM_SIZE");
+
+/* RAM copy of the newest record */
+static EepromRecord record;
+static uint8_t activeSlot = 0; // slot holding `record`
+static bool stored = false;    // a valid record exists in EEPROM
 
 /* Hardwer Reset */
 #define RESET_GPIO 4          // GPIO4
 #define RESET_ACTIVE_LOW true // true = LOW active
 #define RESET_HOLD_MS 5000    // 5 seconds
 
+/* -------------------------------------------------------------------------- */
+/* Record                                                                     */
+/* -------------------------------------------------------------------------- */
+
+static uint32_t recordCrc(const EepromRecord &rec) {
+  return crc32((const uint8_t *)&rec, offsetof(EepromRecord, crc));
+}
+
+static bool recordValid(const EepromRecord &rec) {
+  return rec.magic == RECORD_MAGIC && rec.version == RECORD_VERSION &&
+         rec.length == sizeof(EepromRecord) && rec.crc == recordCrc(rec);
+}
+
+static size_t slotAddr(uint8_t slot) {
+  return slot ? SLOT_B_ADDR : SLOT_A_ADDR;
+}
+
+/**
+ * @brief Writes the RAM record as the next generation (one commit).
+ *
+ * @param wipe Clear the whole area first (legacy bytes and the previous
+ * generation): used by migration and factory reset
+ */
+static bool writeRecord(bool wipe) {
+  EepromRecord rec = record;
+  rec.magic = RECORD_MAGIC;
+  rec.version = RECORD_VERSION;
+  rec.length = sizeof(EepromRecord);
+  rec.seq = record.seq + 1;
+  rec.crc = recordCrc(rec);
+
+  uint8_t slot = stored && !wipe ? activeSlot ^ 1 : 0;
+
+  EEPROM.begin(EEPROM_SIZE);
+
+  if (wipe) {
+    for (int i = 0; i < EEPROM_SIZE; i++)
+      EEPROM.write(i, 0x00);
+  }
+
+  EEPROM.put(slotAddr(slot), rec);
+
+  // Commits and releases the emulation buffer
+  if (!EEPROM.end()) {
+    Serial.println("[EEPROM] ERROR: Commit failed");
+    return false;
+  }
+
+  record.seq = rec.seq;
+  activeSlot = slot;
+  stored = true;
+  return true;
+}
+
+/**
+ * @brief Persists the RAM record if a setter changed it.
+ *
+ * @param before Record before the setter ran
+ */
+static bool commitIfChanged(const EepromRecord &before) {
+  if (memcmp(&before, &record, sizeof(record)) == 0)
+    return true;
+
+  return writeRecord(false);
+}
+
+/**
+ * @brief Fills the RAM record from the legacy byte layout.
+ */
+static void loadLegacy() {
+  if (EEPROM.read(LEGACY_AUTH_FLAG_ADDR) == LEGACY_FLAG_ON) {
+    record.flags |= FLAG_AUTH | FLAG_AUTH_KEY;
+
+    for (size_t i = 0; i < AUTH_KEY_LEN; i++)
+      record.authKey[i] = EEPROM.read(LEGACY_AUTH_KEY_ADDR + i);
+  }
+
+  if (EEPROM.read(LEGACY_DEBUG_FLAG_ADDR) == LEGACY_FLAG_ON)
+    record.flags |= FLAG_DEBUG;
+
+  for (int i = 0; i < LEGACY_WIFI_LEN - 1; i++) {
+    record.ssid[i] = EEPROM.read(LEGACY_SSID_ADDR + i);
+    record.pass[i] = EEPROM.read(LEGACY_PASS_ADDR + i);
+  }
+}
+
 /* -------------------------------------------------------------------------- */
 /* Initialization                                                             */
 /* -------------------------------------------------------------------------- */
 
 bool eepromInit() {
+  EepromRecord a;
+  EepromRecord b;
+
   EEPROM.begin(EEPROM_SIZE);
+  EEPROM.get(SLOT_A_ADDR, a);
+  EEPROM.get(SLOT_B_ADDR, b);
 
-  uint8_t magic = EEPROM.read(MAGIC_ADDR);
+  bool aOk = recordValid(a);
+  bool bOk = recordValid(b);
 
-  if (magic != MAGIC_VALUE) {
-    // First boot or corrupted EEPROM
-    Serial.println("[EEPROM] Magic not found, initializing EEPROM");
+  if (aOk || bOk) {
+    EEPROM.end();
 
-    // Clear entire EEPROM
-    for (int i = 0; i < EEPROM_SIZE; i++)
-      EEPROM.write(i, 0x00);
+    // Newest valid generation (wrap-safe comparison)
+    activeSlot = aOk && (!bOk || (int32_t)(a.seq - b.seq) > 0) ? 0 : 1;
+    record = activeSlot ? b : a;
+    stored = true;
 
-    // Explicit defaults
-    EEPROM.write(AUTH_FLAG_ADDR, 0x00);  // auth disabled
-    EEPROM.write(DEBUG_FLAG_ADDR, 0x00); // debug disabled
+    if ((!aOk && a.magic == RECORD_MAGIC) || (!bOk && b.magic == RECORD_MAGIC))
+      Serial.println("[EEPROM] Damaged record copy ignored");
 
-    // Write magic
-    EEPROM.write(MAGIC_ADDR, MAGIC_VALUE);
+    Serial.println("[EEPROM] Configuration loaded, generation " +
+                   String(record.seq));
+    return true;
+  }
 
-    EEPROM.commit();
-    Serial.println("[EEPROM] EEPROM initialized with default values");
+  memset(&record, 0, sizeof(record));
+  stored = false;
+
+  if (EEPROM.read(LEGACY_MAGIC_ADDR) == LEGACY_MAGIC_VALUE) {
+    Serial.println("[EEPROM] Migrating legacy layout");
+    loadLegacy();
   } else {
-    Serial.println("[EEPROM] Magic found, EEPROM already initialized");
+    // First boot or both copies corrupted
+    Serial.println("[EEPROM] No valid record, initializing EEPROM");
   }
 
-  return true;
+  EEPROM.end();
+
+  bool ok = writeRecord(true);
+  if (ok)
+    Serial.println("[EEPROM] EEPROM initialized");
+  return ok;
 }
 
 bool resetEeprom() {
   Serial.println("[EEPROM] Performing full EEPROM reset...");
 
-  // Clear entire EEPROM region
-  for (int i = 0; i < EEPROM_SIZE; i++) {
-    EEPROM.write(i, 0x00);
-  }
+  // Defaults, and no copy of the old credentials left in the other slot
+  uint32_t seq = record.seq;
+  memset(&record, 0, sizeof(record));
+  record.seq = seq;
 
-  // Persist changes to flash
-  if (!EEPROM.commit()) {
-    Serial.println("[EEPROM] ERROR: Commit failed");
+  if (!writeRecord(true))
     return false;
-  }
 
   Serial.println("[EEPROM] EEPROM reset completed");
   return true;
@@ -129,6 +274,10 @@ void checkHardwareReset() {
 
   resetEeprom();
 
+  // The other settings live in the key-value store on LittleFS
+  if (storageInit())
+    kvClear();
+
   delay(200);
   ESP.restart();
 }
@@ -138,40 +287,30 @@ void checkHardwareReset() {
 /* -------------------------------------------------------------------------- */
 
 bool loadWifiCredentials(String &ssid, String &pass) {
-  char buf[MAX_WIFI_LEN];
-
-  // SSID
-  for (int i = 0; i < MAX_WIFI_LEN - 1; i++)
-    buf[i] = EEPROM.read(SSID_ADDR + i);
-  buf[MAX_WIFI_LEN - 1] = '\0';
-  ssid = buf;
-
-  // Password
-  for (int i = 0; i < MAX_WIFI_LEN - 1; i++)
-    buf[i] = EEPROM.read(PASS_ADDR + i);
-  buf[MAX_WIFI_LEN - 1] = '\0';
-  pass = buf;
+  ssid = record.ssid;
+  pass = record.pass;
 
   return ssid.length() > 0;
 }
 
 void setWifiCredentials(const String &ssid, const String &pass) {
-  for (uint i = 0; i < MAX_WIFI_LEN - 1; i++)
-    EEPROM.write(SSID_ADDR + i, i < ssid.length() ? ssid[i] : 0);
+  EepromRecord before = record;
 
-  for (uint i = 0; i < MAX_WIFI_LEN - 1; i++)
-    EEPROM.write(PASS_ADDR + i, i < pass.length() ? pass[i] : 0);
+  memset(record.ssid, 0, sizeof(record.ssid));
+  memset(record.pass, 0, sizeof(record.pass));
+  strncpy(record.ssid, ssid.c_str(), WIFI_SSID_MAX_LEN);
+  strncpy(record.pass, pass.c_str(), WIFI_PASS_MAX_LEN);
 
-  EEPROM.commit();
+  commitIfChanged(before);
 }
 
 void clearWifiCredentials() {
-  for (int i = 0; i < MAX_WIFI_LEN - 1; i++) {
-    EEPROM.write(SSID_ADDR + i, 0);
-    EEPROM.write(PASS_ADDR + i, 0);
-  }
+  EepromRecord before = record;
+
+  memset(record.ssid, 0, sizeof(record.ssid));
+  memset(record.pass, 0, sizeof(record.pass));
 
-  EEPROM.commit();
+  commitIfChanged(before);
 }
 
 /* -------------------------------------------------------------------------- */
@@ -182,7 +321,7 @@ bool loadAuthFlag(bool *flag) {
   if (!flag)
     return false;
 
-  *flag = (EEPROM.read(AUTH_FLAG_ADDR) == 0xA5);
+  *flag = record.flags & FLAG_AUTH;
   return true;
 }
 
@@ -190,39 +329,20 @@ bool loadAuthKey(uint8_t *key, size_t length) {
   if (!key || length != AUTH_KEY_LEN)
     return false;
 
-  if (EEPROM.read(AUTH_FLAG_ADDR) != 0xA5)
+  if (!(record.flags & FLAG_AUTH_KEY))
     return false;
 
-  for (size_t i = 0; i < AUTH_KEY_LEN; i++)
-    key[i] = EEPROM.read(AUTH_KEY_ADDR + i);
-
+  memcpy(key, record.authKey, AUTH_KEY_LEN);
   return true;
 }
 
-void setAuthFlag(bool flag) {
-  EEPROM.write(AUTH_FLAG_ADDR, flag ? 0xA5 : 0x00);
-  EEPROM.commit();
-}
-
-void setAuthKey(const uint8_t *key, size_t length) {
-  if (!key || length != AUTH_KEY_LEN)
-    return;
-
-  EEPROM.write(AUTH_FLAG_ADDR, 0xA5);
-
-  for (size_t i = 0; i < AUTH_KEY_LEN; i++)
-    EEPROM.write(AUTH_KEY_ADDR + i, key[i]);
-
-  EEPROM.commit();
-}
-
 void clearAuthKey() {
-  EEPROM.write(AUTH_FLAG_ADDR, 0x00);
+  EepromRecord before = record;
 
-  for (size_t i = 0; i < AUTH_KEY_LEN; i++)
-    EEPROM.write(AUTH_KEY_ADDR + i, 0);
+  record.flags &= ~(FLAG_AUTH | FLAG_AUTH_KEY);
+  memset(record.authKey, 0, AUTH_KEY_LEN);
 
-  EEPROM.commit();
+  commitIfChanged(before);
 }
 
 /* -------------------------------------------------------------------------- */
@@ -233,11 +353,14 @@ bool loadDebugFlag(bool *flag) {
   if (!flag)
     return false;
 
-  *flag = (EEPROM.read(DEBUG_FLAG_ADDR) == 0xA5);
+  *flag = record.flags & FLAG_DEBUG;
   return true;
 }
 
-void setSerialDebugFlag(bool flag) {
-  EEPROM.write(DEBUG_FLAG_ADDR, flag ? 0xA5 : 0x00);
-  EEPROM.commit();
+void clearDebugFlag() {
+  EepromRecord before = record;
+
+  record.flags &= ~FLAG_DEBUG;
+
+  commitIfChanged(before);
 }
@@ -5,6 +5,8 @@
 /**
  * @brief Initializes the EEPROM emulation layer.
  *
+ * Loads the newest valid configuration record (version and CRC checked)
+ * into RAM, migrating the legacy byte layout if that is all there is.
  * Must be called once at startup before accessing
  * any persistent configuration.
  */
@@ -16,7 +18,7 @@ bool eepromInit();
  * This function performs a full reset of the persistent EEPROM storage.
  *
  * Behavior:
- * - Clears all stored data (WiFi credentials, auth key, flags)
+ * - Clears all stored data (WiFi credentials, legacy auth key and flags)
  * - Resets the magic value so the device is treated as "factory new"
  * - Disables authentication
  * - Disables serial debug
@@ -37,7 +39,8 @@ bool resetEeprom();
  * INPUT_PULLUP) for a fixed amount of time during startup, the device will:
  *
  *   - Clear all persistent configuration stored in EEPROM
- *   - Reset authentication keys and flags
+ *   - Clear the key-value store (authentication key and flag, debug flag,
+ *     timezone, WiFi networks, ...)
  *   - Disable serial debug
  *   - Reboot into provisioning mode
  *
@@ -85,25 +88,25 @@ void setWifiCredentials(const String &ssid, const String &pass);
 void clearWifiCredentials();
 
 /* -------------------------------------------------------------------------- */
-/* Authentication key                                                         */
+/* Settings moved to the config store                                         */
 /* -------------------------------------------------------------------------- */
 
-/**
- * @brief Enables or disables authentication api.
- *
- * @param flag true to enable, false to disable
+/*
+ * The authentication flag and key and the serial debug flag are kept in
+ * the key-value store (KvStore). Older firmware stored them here: they
+ * are read once by authInit() / debugInit() to migrate them, then
+ * cleared.
  */
-bool loadAuthFlag(bool *flag);
 
 /**
- * @brief Enables or disables authentication.
+ * @brief Reads the authentication flag of older firmware.
  *
- * @param flag true to enable, false to disable
+ * @param flag Output flag
  */
-void setAuthFlag(bool flag);
+bool loadAuthFlag(bool *flag);
 
 /**
- * @brief Loads the authentication shared secret.
+ * @brief Loads the authentication shared secret of older firmware.
  *
  * @param key Output buffer (binary)
  * @param length Buffer size (must be 32 bytes)
@@ -112,30 +115,16 @@ void setAuthFlag(bool flag);
 bool loadAuthKey(uint8_t *key, size_t length);
 
 /**
- * @brief Saves a new authentication shared secret.
- *
- * @param key Binary key
- * @param length Key length (must be 32 bytes)
- */
-void setAuthKey(const uint8_t *key, size_t length);
-
-/**
- * @brief Clears the stored authentication key.
+ * @brief Clears the authentication flag and key.
  */
 void clearAuthKey();
 
-/* -------------------------------------------------------------------------- */
-/* Serial debug                                                               */
-/* -------------------------------------------------------------------------- */
-
 /**
- * @brief Checks if serial debug output is enabled.
+ * @brief Reads the serial debug flag of older firmware.
  */
 bool loadDebugFlag(bool *flag);
 
 /**
- * @brief Enables or disables serial debug output.
- *
- * @param flag true to enable, false to disable
+ * @brief Clears the serial debug flag.
  */
-void setSerialDebugFlag(bool flag);
+void clearDebugFlag();
@@ -0,0 +1,515 @@
+#include "HttpQueue.h"
+#include <ESP8266WiFi.h>
+
+#include <Debug.h>
+
+/* Maximum bytes consumed from the socket per loop call */
+#define HTTP_READ_CHUNK 128
+
+/* Longest header line that is inspected (longer lines are truncated) */
+#define HTTP_LINE_LEN 64
+
+#define HTTP_HOST_LEN 48
+
+/**
+ * @brief Queued request.
+ */
+struct HttpRequestEntry {
+  uint32_t id;
+  int16_t tag;
+  uint8_t method;
+  char url[HTTP_QUEUE_URL_LEN];
+  char body[HTTP_QUEUE_BODY_LEN];
+};
+
+/**
+ * @brief Resolved address of a host.
+ */
+struct DnsEntry {
+  char host[HTTP_HOST_LEN]; // empty = unused
+  IPAddress ip;
+  unsigned long resolvedAt;
+};
+
+/**
+ * @brief Processing state of the request at the head of the queue.
+ */
+enum HttpState : uint8_t { HttpIdle = 0, HttpReadHeaders, HttpReadBody };
+
+/* Bounded FIFO */
+static HttpRequestEntry queue[HTTP_QUEUE_SIZE];
+static uint8_t queueHead = 0;
+static uint8_t queueCount = 0;
+static uint32_t nextId = 1;
+
+/* Connection (kept alive between requests to the same host) */
+static WiFiClient conn;
+static char connHost[HTTP_HOST_LEN];
+static uint16_t connPort = 0;
+static bool connOpen = false;
+static unsigned long connLastUsed = 0;
+
+/* Addresses of recently used hosts */
+static DnsEntry dnsCache[HTTP_DNS_CACHE_SIZE];
+
+/* Current request */
+static HttpState state = HttpIdle;
+static unsigned long reqStart = 0;
+static unsigned long lastProgress = 0;
+static bool reqReused = false;
+static bool reqRetried = false; // already resent on a fresh connection
+static uint16_t respStatus = 0;
+static int32_t respRemaining = -1; // -1 = no Content-Length
+static bool respKeepAlive = false;
+static char line[HTTP_LINE_LEN];
+static uint8_t lineLen = 0;
+static bool lineFirst = true;
+
+/* Results */
+static HttpQueueStats stats;
+static HttpResult results[HTTP_RESULT_HISTORY];
+static uint8_t resultHead = 0;
+static uint8_t resultCount = 0;
+
+/**
+ * @brief Splits "http://host[:port]/path" into its components.
+ *
+ * @return true if the URL is a supported plain-HTTP URL.
+ */
+static bool parseUrl(const char *url, char *host, uint16_t &port,
+                     const char *&path) {
+  if (strncmp(url, "http://", 7) != 0)
+    return false;
+
+  const char *h = url + 7;
+  const char *end = h;
+  while (*end && *end != ':' && *end != '/')
+    end++;
+
+  size_t hostLen = end - h;
+  if (hostLen == 0 || hostLen >= HTTP_HOST_LEN)
+    return false;
+
+  memcpy(host, h, hostLen);
+  host[hostLen] = '\0';
+
+  port = 80;
+  if (*end == ':') {
+    long p = strtol(end + 1, (char **)&end, 10);
+    if (p <= 0 || p > 65535)
+      return false;
+    port = (uint16_t)p;
+  }
+
+  path = *end == '/' ? end : "/";
+  return *end == '\0' || *end == '/';
+}
+
+uint32_t httpEnqueue(HttpQueueMethod method, const char *url,
+                     const char *body, int16_t tag) {
+  char host[HTTP_HOST_LEN];
+  uint16_t port;
+  const char *path;
+
+  if (!url || strlen(url) >= HTTP_QUEUE_URL_LEN ||
+      !parseUrl(url, host, port, path))
+    return 0;
+
+  if (queueCount >= HTTP_QUEUE_SIZE) {
+    stats.dropped++;
+    debugPrintln(F("[HTTP]"), F("Queue full, request dropped"));
+    return 0;
+  }
+
+  HttpRequestEntry &e = queue[(queueHead + queueCount) % HTTP_QUEUE_SIZE];
+  e.id = nextId++;
+  e.tag = tag;
+  e.method = method;
+  strlcpy(e.url, url, sizeof(e.url));
+  strlcpy(e.body, (method == HttpPost && body) ? body : "", sizeof(e.body));
+
+  queueCount++;
+  stats.enqueued++;
+  return e.id;
+}
+
+/**
+ * @brief Closes the kept-alive connection.
+ */
+static void closeConnection() {
+  conn.stop();
+  connOpen = false;
+  connHost[0] = '\0';
+}
+
+/**
+ * @brief Records the outcome of the head request and pops it.
+ */
+static void finishRequest(HttpQueueError error) {
+  const HttpRequestEntry &e = queue[queueHead];
+  unsigned long now = millis();
+
+  HttpResult &r = results[resultHead];
+  r.id = e.id;
+  r.tag = e.tag;
+  r.status = respStatus;
+  r.error = error;
+  r.reused = reqReused;
+  r.latencyMs = now - reqStart;
+  r.doneAt = now;
+
+  resultHead = (resultHead + 1) % HTTP_RESULT_HISTORY;
+  if (resultCount < HTTP_RESULT_HISTORY)
+    resultCount++;
+
+  stats.completed++;
+  if (error != HttpOk || respStatus >= 400)
+    stats.failed++;
+  if (reqReused)
+    stats.reused++;
+  if (r.latencyMs > stats.maxLatencyMs)
+    stats.maxLatencyMs = r.latencyMs;
+
+  debugPrintf(F("[HTTP]"), "#%u %s status=%u error=%s latency=%lums%s",
+              (unsigned)e.id, e.url, respStatus,
+              httpErrorToString(error).c_str(), (unsigned long)r.latencyMs,
+              reqReused ? " (reused)" : "");
+
+  if (error != HttpOk || !respKeepAlive)
+    closeConnection();
+  else
+    connLastUsed = now;
+
+  queueHead = (queueHead + 1) % HTTP_QUEUE_SIZE;
+  queueCount--;
+  state = HttpIdle;
+  reqRetried = false;
+}
+
+/**
+ * @brief Prepares to send the head request again on a new connection.
+ *
+ * Only when it went over a kept-alive connection (which the server may
+ * have closed just before it was reused), nothing was received yet and
+ * it was not retried already.
+ *
+ * @return false if the request cannot be retried
+ */
+static bool retryRequest() {
+  if (!reqReused || reqRetried || !lineFirst || lineLen > 0)
+    return false;
+
+  debugPrintln(F("[HTTP]"), F("Kept-alive connection closed, retrying"));
+
+  closeConnection();
+  reqRetried = true;
+  stats.retried++;
+  state = HttpIdle;
+  return true;
+}
+
+/**
+ * @brief Drops the cached address of a host (it may have moved).
+ */
+static void forgetHost(const char *host) {
+  for (DnsEntry &e : dnsCache) {
+    if (strcmp(e.host, host) == 0)
+      e.host[0] = '\0';
+  }
+}
+
+/**
+ * @brief Resolves a host name, from the cache while the entry is fresh.
+ *
+ * Only a miss blocks; its result replaces the oldest entry.
+ */
+static bool resolveHost(const char *host, IPAddress &ip,
+                        uint32_t timeoutMs) {
+  unsigned long now = millis();
+  DnsEntry *slot = nullptr;
+
+  for (DnsEntry &e : dnsCache) {
+    if (strcmp(e.host, host) == 0) {
+      slot = &e;
+      break;
+    }
+    if (!slot || (slot->host[0] != '\0' &&
+                  (e.host[0] == '\0' ||
+                   now - e.resolvedAt > now - slot->resolvedAt)))
+      slot = &e;
+  }
+
+  if (strcmp(slot->host, host) == 0 &&
+      now - slot->resolvedAt < HTTP_DNS_TTL_MS) {
+    ip = slot->ip;
+    return true;
+  }
+
+  stats.dnsLookups++;
+  if (!WiFi.hostByName(host, ip, timeoutMs)) {
+    forgetHost(host);
+    return false;
+  }
+
+  strlcpy(slot->host, host, sizeof(slot->host));
+  slot->ip = ip;
+  slot->resolvedAt = now;
+  return true;
+}
+
+/**
+ * @brief Opens (or reuses) the connection and writes the request.
+ */
+static void startRequest() {
+  const HttpRequestEntry &e = queue[queueHead];
+
+  // A retry keeps the start of the first attempt (latency)
+  if (!reqRetried)
+    reqStart = millis();
+  lastProgress = millis();
+  respStatus = 0;
+  respRemaining = -1;
+  respKeepAlive = true;
+  lineLen = 0;
+  lineFirst = true;
+
+  char host[HTTP_HOST_LEN];
+  uint16_t port;
+  const char *path;
+  parseUrl(e.url, host, port, path);
+
+  if (WiFi.status() != WL_CONNECTED) {
+    reqReused = false;
+    finishRequest(HttpErrNoWifi);
+    return;
+  }
+
+  reqReused = connOpen && conn.connected() && port == connPort &&
+              strcmp(host, connHost) == 0;
+
+  if (!reqReused) {
+    closeConnection();
+
+    // DNS and connect share one budget
+    unsigned long connectStart = millis();
+
+    IPAddress ip;
+    if (!resolveHost(host, ip, HTTP_CONNECT_TIMEOUT_MS)) {
+      finishRequest(HttpErrDns);
+      return;
+    }
+
+    uint32_t spent = millis() - connectStart;
+    if (spent >= HTTP_CONNECT_TIMEOUT_MS) {
+      finishRequest(HttpErrConnect);
+      return;
+    }
+
+    conn.setTimeout(HTTP_CONNECT_TIMEOUT_MS - spent);
+    if (!conn.connect(ip, port)) {
+      forgetHost(host);
+      finishRequest(HttpErrConnect);
+      return;
+    }
+
+    conn.setNoDelay(true);
+    strlcpy(connHost, host, sizeof(connHost));
+    connPort = port;
+    connOpen = true;
+  }
+
+  char req[HTTP_QUEUE_URL_LEN + HTTP_QUEUE_BODY_LEN + 160];
+  size_t bodyLen = strlen(e.body);
+  int n;
+
+  if (e.method == HttpPost) {
+    n = snprintf(req, sizeof(req),
+                 "POST %s HTTP/1.1\r\nHost: %s\r\nConnection: keep-alive\r\n"
+                 "Content-Type: application/json\r\nContent-Length: %u\r\n"
+                 "\r\n%s",
+                 path, host, (unsigned)bodyLen, e.body);
+  } else {
+    n = snprintf(req, sizeof(req),
+                 "GET %s HTTP/1.1\r\nHost: %s\r\nConnection: keep-alive\r\n"
+                 "\r\n",
+                 path, host);
+  }
+
+  if (n <= 0 || (size_t)n >= sizeof(req)) {
+    finishRequest(HttpErrConnect);
+    return;
+  }
+
+  if (conn.write((const uint8_t *)req, n) != (size_t)n) {
+    if (!retryRequest())
+      finishRequest(HttpErrConnect);
+    return;
+  }
+
+  state = HttpReadHeaders;
+}
+
+/**
+ * @brief Case-insensitive header name check; returns the value or nullptr.
+ */
+static const char *headerValue(const char *hdr, const char *name) {
+  size_t len = strlen(name);
+  if (strncasecmp(hdr, name, len) != 0 || hdr[len] != ':')
+    return nullptr;
+
+  const char *v = hdr + len + 1;
+  while (*v == ' ')
+    v++;
+  return v;
+}
+
+/**
+ * @brief Processes one complete status or header line.
+ *
+ * @return false if the response is malformed.
+ */
+static bool handleLine() {
+  line[lineLen] = '\0';
+
+  if (lineFirst) {
+    lineFirst = false;
+    if (strncmp(line, "HTTP/1.", 7) != 0 || lineLen < 12)
+      return false;
+    // HTTP/1.0 closes by default
+    respKeepAlive = line[7] == '1';
+    respStatus = atoi(line + 9);
+    return respStatus >= 100;
+  }
+
+  const char *v;
+  if ((v = headerValue(line, "Content-Length"))) {
+    respRemaining = atol(v);
+  } else if ((v = headerValue(line, "Connection"))) {
+    respKeepAlive = strncasecmp(v, "close", 5) != 0;
+  } else if ((v = headerValue(line, "Transfer-Encoding"))) {
+    // Chunked bodies are not parsed
+    respRemaining = -1;
+  }
+  return true;
+}
+
+/**
+ * @brief Reads available response bytes without blocking.
+ */
+static void readResponse() {
+  if (millis() - lastProgress > HTTP_READ_TIMEOUT_MS) {
+    finishRequest(HttpErrTimeout);
+    return;
+  }
+
+  int avail = conn.available();
+  if (avail <= 0) {
+    if (!conn.connected() && !retryRequest())
+      finishRequest(HttpErrProtocol);
+    return;
+  }
+
+  lastProgress = millis();
+  int budget = avail < HTTP_READ_CHUNK ? avail : HTTP_READ_CHUNK;
+
+  if (state == HttpReadHeaders) {
+    while (budget-- > 0) {
+      int c = conn.read();
+      if (c < 0)
+        return;
+
+      if (c == '\r')
+        continue;
+
+      if (c != '\n') {
+        if (lineLen < HTTP_LINE_LEN - 1)
+          line[lineLen++] = (char)c;
+        continue;
+      }
+
+      // End of headers
+      if (lineLen == 0 && !lineFirst) {
+        if (respRemaining > 0) {
+          state = HttpReadBody;
+        } else {
+          // Without a length (chunked, read-until-close) the body is not
+          // needed: drop the connection instead of parsing it
+          if (respRemaining < 0)
+            respKeepAlive = false;
+          finishRequest(HttpOk);
+        }
+        return;
+      }
+
+      if (!handleLine()) {
+        finishRequest(HttpErrProtocol);
+        return;
+      }
+      lineLen = 0;
+    }
+    return;
+  }
+
+  // Body: discard the payload so the connection can be reused
+  uint8_t scratch[HTTP_READ_CHUNK];
+  if (budget > respRemaining)
+    budget = respRemaining;
+
+  int n = conn.read(scratch, budget);
+  if (n > 0)
+    respRemaining -= n;
+
+  if (respRemaining == 0)
+    finishRequest(HttpOk);
+}
+
+void httpQueueLoop() {
+  // Drop idle or remotely closed keep-alive connections
+  if (state == HttpIdle && connOpen &&
+      (millis() - connLastUsed > HTTP_KEEPALIVE_IDLE_MS || !conn.connected()))
+    closeConnection();
+
+  switch (state) {
+  case HttpIdle:
+    if (queueCount > 0)
+      startRequest();
+    break;
+
+  case HttpReadHeaders:
+  case HttpReadBody:
+    readResponse();
+    break;
+  }
+}
+
+size_t httpQueuePending() { return queueCount; }
+
+const HttpQueueStats &httpQueueStats() { return stats; }
+
+const HttpResult *httpQueueResult(size_t index) {
+  if (index >= resultCount)
+    return nullptr;
+
+  size_t pos = (resultHead + HTTP_RESULT_HISTORY - 1 - index) %
+               HTTP_RESULT_HISTORY;
+  return &results[pos];
+}
+
+String httpErrorToString(uint8_t error) {
+  switch (error) {
+  case HttpOk:
+    return "Ok";
+  case HttpErrDns:
+    return "Dns";
+  case HttpErrConnect:
+    return "Connect";
+  case HttpErrTimeout:
+    return "Timeout";
+  case HttpErrProtocol:
+    return "Protocol";
+  case HttpErrNoWifi:
+    return "NoWifi";
+  default:
+    return "Unknown";
+  }
+}
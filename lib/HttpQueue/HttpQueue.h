@@ -0,0 +1,154 @@
+#pragma once
+
+#include <Arduino.h>
+
+/**
+ * @brief Maximum number of outbound requests waiting to be sent.
+ *
+ * Requests enqueued while the queue is full are dropped and counted.
+ */
+#define HTTP_QUEUE_SIZE 4
+
+/**
+ * @brief Maximum URL length (including terminator) of a queued request.
+ */
+#define HTTP_QUEUE_URL_LEN 96
+
+/**
+ * @brief Maximum POST body length (including terminator).
+ */
+#define HTTP_QUEUE_BODY_LEN 64
+
+/**
+ * @brief Upper bound for DNS resolution and TCP connect together, in
+ * milliseconds.
+ *
+ * This is the only step that blocks the main loop, and only when no
+ * keep-alive connection to the same host can be reused. The DNS part is
+ * skipped while the host's address is cached (HTTP_DNS_TTL_MS); after a
+ * lookup, the connect gets what is left of the budget.
+ */
+#define HTTP_CONNECT_TIMEOUT_MS 1500
+
+/**
+ * @brief Number of host names whose resolved address is cached.
+ */
+#define HTTP_DNS_CACHE_SIZE 4
+
+/**
+ * @brief Time a resolved address is reused without a new lookup, in
+ * milliseconds. A failed connect drops it earlier.
+ */
+#define HTTP_DNS_TTL_MS 600000UL
+
+/**
+ * @brief Maximum time without progress while waiting for the response.
+ */
+#define HTTP_READ_TIMEOUT_MS 5000
+
+/**
+ * @brief Idle keep-alive connections are closed after this time.
+ */
+#define HTTP_KEEPALIVE_IDLE_MS 15000
+
+/**
+ * @brief Number of completed requests kept in the result history.
+ */
+#define HTTP_RESULT_HISTORY 8
+
+/**
+ * @brief Supported request methods.
+ */
+enum HttpQueueMethod { HttpGet = 0, HttpPost };
+
+/**
+ * @brief Transport-level outcome of a request.
+ *
+ * HttpOk means a status line was received; the HTTP status code itself
+ * is reported separately in HttpResult::status.
+ */
+enum HttpQueueError {
+  HttpOk = 0,
+  HttpErrDns,
+  HttpErrConnect,
+  HttpErrTimeout,
+  HttpErrProtocol,
+  HttpErrNoWifi
+};
+
+/**
+ * @brief Outcome of a completed request.
+ */
+struct HttpResult {
+  uint32_t id;        ///< Request id returned by httpEnqueue()
+  int16_t tag;        ///< Caller tag (e.g. cron job index, -1 if none)
+  uint16_t status;    ///< HTTP status code (0 if none received)
+  uint8_t error;      ///< HttpQueueError
+  bool reused;        ///< Sent over a kept-alive connection
+  uint32_t latencyMs; ///< Time from start of processing to completion
+  uint32_t doneAt;    ///< millis() at completion
+};
+
+/**
+ * @brief Aggregate counters since boot.
+ */
+struct HttpQueueStats {
+  uint32_t enqueued;
+  uint32_t dropped; ///< Rejected because the queue was full
+  uint32_t completed;
+  uint32_t failed; ///< Transport error or HTTP status >= 400
+  uint32_t reused;     ///< Requests sent over a kept-alive connection
+  uint32_t retried;    ///< Resent after the server closed a kept-alive one
+  uint32_t dnsLookups; ///< Blocking DNS resolutions (cache misses)
+  uint32_t maxLatencyMs;
+};
+
+/**
+ * @brief Queues an outbound HTTP request.
+ *
+ * Only plain "http://host[:port]/path" URLs are supported. The request is
+ * processed asynchronously by httpQueueLoop().
+ *
+ * @param method HttpGet or HttpPost
+ * @param url Target URL
+ * @param body POST body (JSON), ignored for GET (may be nullptr)
+ * @param tag Caller-defined tag reported back in HttpResult
+ * @return Request id (> 0), or 0 if the URL is invalid or the queue is full
+ */
+uint32_t httpEnqueue(HttpQueueMethod method, const char *url,
+                     const char *body, int16_t tag = -1);
+
+/**
+ * @brief Periodic handler driving the outbound request state machine.
+ *
+ * Each call performs at most one bounded step (connect, send, read a
+ * chunk of the response), so the main loop is never blocked for longer
+ * than HTTP_CONNECT_TIMEOUT_MS.
+ *
+ * A request sent over a kept-alive connection that the server closes
+ * before any response byte is sent again, once, on a new connection.
+ */
+void httpQueueLoop();
+
+/**
+ * @brief Returns the number of requests waiting or in progress.
+ */
+size_t httpQueuePending();
+
+/**
+ * @brief Returns aggregate counters since boot.
+ */
+const HttpQueueStats &httpQueueStats();
+
+/**
+ * @brief Returns a completed request from the history.
+ *
+ * @param index 0 = most recent
+ * @return Pointer to the result, or nullptr if out of range
+ */
+const HttpResult *httpQueueResult(size_t index);
+
+/**
+ * @brief Converts a HttpQueueError to its string representation.
+ */
+String httpErrorToString(uint8_t error);
@@ -0,0 +1,441 @@
+#include "KvStore.h"
+
+#include <BinaryStorage.h>
+#include <Debug.h>
+#include <coredecls.h>
+
+/*
+ * Log file layout:
+ *
+ *   KvFileHeader | batch | batch | ...
+ *
+ * A batch is one or more records followed by a commit record. Each record
+ * is a KvRecordHeader followed by `length` value bytes. Records of a batch
+ * without its commit record (torn append) are ignored. A later record for
+ * the same key supersedes earlier ones; a tombstone removes the key.
+ */
+#define KV_PATH "/kv.bin"
+#define KV_TMP_PATH "/kv.tmp"
+#define KV_MAGIC 0x3153564B // "KVS1"
+#define KV_VERSION 1
+
+/* Internal record types */
+#define KV_TYPE_COMMIT 0xFE
+#define KV_TYPE_DELETED 0xFF
+
+/* Maximum records in one batch (including the commit record) */
+#define KV_BATCH_MAX_RECORDS 16
+
+struct KvFileHeader {
+  uint32_t magic;
+  uint16_t version;
+  uint16_t reserved;
+};
+
+struct KvRecordHeader {
+  uint16_t key;
+  uint8_t type;
+  uint8_t reserved;
+  uint16_t length;
+  uint16_t check; // low 16 bits of the CRC32 of header and value
+};
+
+/**
+ * @brief Index entry: where the current value of a key lives in the log.
+ */
+struct KvIndexEntry {
+  uint16_t key;
+  uint8_t type;
+  uint16_t length;
+  uint32_t offset; // file offset of the value bytes
+};
+
+static KvIndexEntry kvIndex[KV_MAX_KEYS];
+static uint8_t indexCount = 0;
+static uint32_t logSize = 0;
+static KvStats stats;
+
+/* A failed append may have left bytes after logSize */
+static bool logTorn = false;
+
+/* Open batch */
+static uint8_t batch[KV_BATCH_SIZE];
+static size_t batchLen = 0;
+static uint8_t batchRecords = 0;
+static bool batchOpen = false;
+
+static uint16_t recordCheck(KvRecordHeader hdr, const uint8_t *value) {
+  hdr.check = 0;
+  uint32_t crc = crc32(&hdr, sizeof(hdr));
+  return crc32(value, hdr.length, crc) & 0xFFFF;
+}
+
+static int findKey(uint16_t key) {
+  for (uint8_t i = 0; i < indexCount; i++) {
+    if (kvIndex[i].key == key)
+      return i;
+  }
+  return -1;
+}
+
+/**
+ * @brief Applies one committed record to the index.
+ */
+static bool indexRecord(const KvRecordHeader &hdr, uint32_t valueOffset) {
+  int i = findKey(hdr.key);
+
+  if (hdr.type == KV_TYPE_DELETED) {
+    if (i >= 0)
+      kvIndex[i] = kvIndex[--indexCount];
+    return true;
+  }
+
+  if (i < 0) {
+    if (indexCount >= KV_MAX_KEYS)
+      return false;
+    i = indexCount++;
+  }
+
+  kvIndex[i] = {hdr.key, hdr.type, hdr.length, valueOffset};
+  return true;
+}
+
+/**
+ * @brief Indexes the committed batches of an encoded record sequence.
+ *
+ * @param buf Records
+ * @param len Bytes in `buf`
+ * @param base File offset of buf[0]
+ * @return Bytes up to the end of the last complete batch
+ */
+static size_t indexBatches(const uint8_t *buf, size_t len, uint32_t base) {
+  size_t pos = 0;
+  size_t committed = 0;
+  size_t staged[KV_BATCH_MAX_RECORDS];
+  uint8_t stagedCount = 0;
+
+  while (pos + sizeof(KvRecordHeader) <= len) {
+    KvRecordHeader hdr;
+    memcpy(&hdr, buf + pos, sizeof(hdr));
+
+    size_t end = pos + sizeof(hdr) + hdr.length;
+    if (end > len || hdr.length > KV_MAX_VALUE_LEN ||
+        hdr.check != recordCheck(hdr, buf + pos + sizeof(hdr)))
+      break;
+
+    if (hdr.type == KV_TYPE_COMMIT) {
+      for (uint8_t i = 0; i < stagedCount; i++) {
+        KvRecordHeader rec;
+        memcpy(&rec, buf + staged[i], sizeof(rec));
+        if (!indexRecord(rec, base + staged[i] + sizeof(rec)))
+          debugPrintln(F("[KV]"), "Index full, key " + String(rec.key) +
+                                      " dropped");
+      }
+      stagedCount = 0;
+      committed = end;
+    } else {
+      if (stagedCount >= KV_BATCH_MAX_RECORDS)
+        break;
+      staged[stagedCount++] = pos;
+    }
+
+    pos = end;
+  }
+
+  return committed;
+}
+
+/**
+ * @brief Encodes a record into the batch buffer.
+ */
+static bool batchAdd(uint16_t key, uint8_t type, const void *data,
+                     size_t length) {
+  // Room is kept for the commit record
+  if (length > KV_MAX_VALUE_LEN ||
+      batchLen + 2 * sizeof(KvRecordHeader) + length > KV_BATCH_SIZE ||
+      batchRecords + 1 >= KV_BATCH_MAX_RECORDS)
+    return false;
+
+  KvRecordHeader hdr = {key, type, 0, (uint16_t)length, 0};
+  if (length > 0)
+    memcpy(batch + batchLen + sizeof(hdr), data, length);
+  hdr.check = recordCheck(hdr, batch + batchLen + sizeof(hdr));
+  memcpy(batch + batchLen, &hdr, sizeof(hdr));
+
+  batchLen += sizeof(hdr) + length;
+  batchRecords++;
+  return true;
+}
+
+static void updateStats() {
+  stats.logSize = logSize;
+  stats.keys = indexCount;
+  stats.liveBytes = sizeof(KvFileHeader);
+  for (uint8_t i = 0; i < indexCount; i++)
+    stats.liveBytes += sizeof(KvRecordHeader) + kvIndex[i].length;
+  if (indexCount > 0)
+    stats.liveBytes += sizeof(KvRecordHeader); // commit record
+}
+
+/**
+ * @brief Rewrites the log with only the live values, as one batch.
+ *
+ * The new log is written to a temporary file and renamed over the old one.
+ */
+static bool compact() {
+  updateStats();
+
+  uint8_t *buf = (uint8_t *)malloc(stats.liveBytes);
+  if (!buf)
+    return false;
+
+  KvFileHeader fh = {KV_MAGIC, KV_VERSION, 0};
+  memcpy(buf, &fh, sizeof(fh));
+  size_t pos = sizeof(fh);
+
+  // New offsets only take effect once the new log is in place
+  uint32_t offsets[KV_MAX_KEYS];
+
+  bool ok = true;
+  for (uint8_t i = 0; i < indexCount && ok; i++) {
+    KvRecordHeader hdr = {kvIndex[i].key, kvIndex[i].type, 0,
+                          kvIndex[i].length, 0};
+    uint8_t *value = buf + pos + sizeof(hdr);
+
+    ok = hdr.length == 0 ||
+         storageReadAt(KV_PATH, kvIndex[i].offset, value, hdr.length);
+    hdr.check = recordCheck(hdr, value);
+    memcpy(buf + pos, &hdr, sizeof(hdr));
+
+    offsets[i] = pos + sizeof(hdr);
+    pos += sizeof(hdr) + hdr.length;
+  }
+
+  if (ok && indexCount > 0) {
+    KvRecordHeader commit = {0, KV_TYPE_COMMIT, 0, 0, 0};
+    commit.check = recordCheck(commit, nullptr);
+    memcpy(buf + pos, &commit, sizeof(commit));
+    pos += sizeof(commit);
+  }
+
+  ok = ok && storageRemove(KV_TMP_PATH) &&
+       storageWriteAt(KV_TMP_PATH, 0, buf, pos) &&
+       storageRename(KV_TMP_PATH, KV_PATH);
+  free(buf);
+
+  if (!ok) {
+    debugPrintln(F("[KV]"), F("ERROR: Compaction failed"));
+    return false;
+  }
+
+  for (uint8_t i = 0; i < indexCount; i++)
+    kvIndex[i].offset = offsets[i];
+
+  logSize = pos;
+  logTorn = false;
+  stats.compactions++;
+  updateStats();
+
+  debugPrintln(F("[KV]"), "Compacted to " + String(logSize) + " bytes");
+  return true;
+}
+
+/**
+ * @brief Replaces the log with an empty one.
+ */
+static bool createEmpty() {
+  KvFileHeader fh = {KV_MAGIC, KV_VERSION, 0};
+
+  indexCount = 0;
+  logSize = sizeof(fh);
+  logTorn = false;
+  updateStats();
+
+  return storageRemove(KV_PATH) &&
+         storageWriteAt(KV_PATH, 0, (uint8_t *)&fh, sizeof(fh));
+}
+
+bool kvInit() {
+  indexCount = 0;
+  batchLen = 0;
+  batchRecords = 0;
+  batchOpen = false;
+  logTorn = false;
+
+  size_t size = storageSize(KV_PATH);
+  KvFileHeader fh;
+
+  if (size < sizeof(fh) ||
+      !storageReadAt(KV_PATH, 0, (uint8_t *)&fh, sizeof(fh)) ||
+      fh.magic != KV_MAGIC || fh.version != KV_VERSION) {
+    debugPrintln(F("[KV]"), F("Creating empty store"));
+    return createEmpty();
+  }
+
+  // One read of the whole log (bounded by compaction)
+  size_t len = size - sizeof(fh);
+  uint8_t *buf = (uint8_t *)malloc(len ? len : 1);
+  if (!buf)
+    return false;
+
+  if (len > 0 && !storageReadAt(KV_PATH, sizeof(fh), buf, len)) {
+    free(buf);
+    return false;
+  }
+
+  size_t valid = indexBatches(buf, len, sizeof(fh));
+  free(buf);
+
+  logSize = sizeof(fh) + valid;
+  updateStats();
+
+  debugPrintln(F("[KV]"), String(indexCount) + " key(s), " +
+                              String(logSize) + " bytes");
+
+  // Drop a torn tail, or later appends would land behind it
+  if (valid < len || logSize > KV_COMPACT_SIZE)
+    return compact();
+
+  return true;
+}
+
+bool kvClear() {
+  kvAbort();
+
+  debugPrintln(F("[KV]"), F("Clearing store"));
+  return createEmpty();
+}
+
+bool kvBegin() {
+  if (batchOpen)
+    return false;
+
+  batchOpen = true;
+  batchLen = 0;
+  batchRecords = 0;
+  return true;
+}
+
+void kvAbort() {
+  batchOpen = false;
+  batchLen = 0;
+  batchRecords = 0;
+}
+
+bool kvCommit() {
+  if (!batchOpen)
+    return false;
+
+  batchOpen = false;
+  if (batchRecords == 0)
+    return true;
+
+  KvRecordHeader commit = {0, KV_TYPE_COMMIT, 0, 0, 0};
+  commit.check = recordCheck(commit, nullptr);
+  memcpy(batch + batchLen, &commit, sizeof(commit));
+  size_t len = batchLen + sizeof(commit);
+
+  batchLen = 0;
+  batchRecords = 0;
+
+  // Appending behind a partial batch would index it at the wrong offset
+  if (logTorn && !compact())
+    return false;
+
+  if (!storageAppend(KV_PATH, batch, len)) {
+    debugPrintln(F("[KV]"), F("ERROR: Commit failed"));
+
+    // Drop the partial batch now; retried by the next commit otherwise
+    logTorn = true;
+    compact();
+    return false;
+  }
+
+  indexBatches(batch, len, logSize);
+  logSize += len;
+  stats.commits++;
+  updateStats();
+
+  if (logSize > KV_COMPACT_SIZE)
+    compact();
+
+  return true;
+}
+
+bool kvSet(uint16_t key, uint8_t type, const void *data, size_t length) {
+  if (batchOpen)
+    return batchAdd(key, type, data, length);
+
+  kvBegin();
+  if (!batchAdd(key, type, data, length)) {
+    kvAbort();
+    return false;
+  }
+  return kvCommit();
+}
+
+bool kvGet(uint16_t key, uint8_t type, void *out, size_t length) {
+  int i = findKey(key);
+  if (i < 0 || kvIndex[i].type != type || kvIndex[i].length != length)
+    return false;
+
+  return length == 0 ||
+         storageReadAt(KV_PATH, kvIndex[i].offset, (uint8_t *)out, length);
+}
+
+bool kvSetString(uint16_t key, const char *value) {
+  return kvSet(key, KvString, value, strlen(value));
+}
+
+bool kvGetString(uint16_t key, char *out, size_t size) {
+  int i = findKey(key);
+  if (i < 0 || kvIndex[i].type != KvString || kvIndex[i].length >= size)
+    return false;
+
+  if (!kvGet(key, KvString, out, kvIndex[i].length))
+    return false;
+
+  out[kvIndex[i].length] = '\0';
+  return true;
+}
+
+bool kvSetU32(uint16_t key, uint32_t value) {
+  return kvSet(key, KvU32, &value, sizeof(value));
+}
+
+bool kvGetU32(uint16_t key, uint32_t &value) {
+  return kvGet(key, KvU32, &value, sizeof(value));
+}
+
+bool kvSetFloat(uint16_t key, float value) {
+  return kvSet(key, KvFloat, &value, sizeof(value));
+}
+
+bool kvGetFloat(uint16_t key, float &value) {
+  return kvGet(key, KvFloat, &value, sizeof(value));
+}
+
+bool kvSetBool(uint16_t key, bool value) {
+  uint8_t b = value ? 1 : 0;
+  return kvSet(key, KvBool, &b, 1);
+}
+
+bool kvGetBool(uint16_t key, bool &value) {
+  uint8_t b;
+  if (!kvGet(key, KvBool, &b, 1))
+    return false;
+
+  value = b != 0;
+  return true;
+}
+
+bool kvRemove(uint16_t key) {
+  if (!batchOpen && findKey(key) < 0)
+    return true;
+
+  return kvSet(key, KV_TYPE_DELETED, nullptr, 0);
+}
+
+bool kvHas(uint16_t key) { return findKey(key) >= 0; }
+
+const KvStats &kvStats() { return stats; }
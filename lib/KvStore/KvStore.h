@@ -0,0 +1,164 @@
+#pragma once
+
+#include <Arduino.h>
+
+/**
+ * @brief Maximum number of distinct keys held in the RAM index.
+ */
+#define KV_MAX_KEYS 32
+
+/**
+ * @brief Largest value, in bytes.
+ */
+#define KV_MAX_VALUE_LEN 128
+
+/**
+ * @brief Log size (in bytes) above which the store is compacted.
+ */
+#define KV_COMPACT_SIZE 4096
+
+/**
+ * @brief Capacity of the batch buffer, in bytes of encoded records.
+ */
+#define KV_BATCH_SIZE 384
+
+/**
+ * @brief Key registry.
+ *
+ * Keys are grouped by owning module (high byte). A key is never reused
+ * for a different meaning; a changed layout gets a new key, and the old
+ * one is read once for migration and removed.
+ */
+enum KvKey : uint16_t {
+  KvKeyClockTz = 0x0101,        // String: POSIX TZ
+  KvKeySolarLocation = 0x0201,  // Blob: latitude, longitude (2 x float)
+  KvKeyWifiLink = 0x0301,       // Blob: last BSSID, channel, DHCP lease
+  KvKeyWifiStaticIp = 0x0302,   // Blob: static IP, mask, gateway, DNS
+  KvKeyWifiNetStats = 0x0303,   // Blob: join counters per network
+  KvKeyWifiNetwork = 0x0310,    // Blob: SSID, password (0x0310 + slot)
+  KvKeyPowerProfile = 0x0401,   // U32: PowerProfile
+  KvKeyAuthFlag = 0x0501,       // Bool: API authentication enabled
+  KvKeyAuthKey = 0x0502,        // Blob: HMAC shared secret (32 bytes)
+  KvKeyDebugFlag = 0x0601,      // Bool: serial debug enabled
+};
+
+/**
+ * @brief Value types. A value can only be read back with its own type.
+ */
+enum KvType : uint8_t {
+  KvBlob = 1,
+  KvString,
+  KvU32,
+  KvI32,
+  KvFloat,
+  KvBool,
+};
+
+/**
+ * @brief Store counters.
+ */
+struct KvStats {
+  uint32_t logSize;     // bytes in the log file
+  uint32_t liveBytes;   // bytes a compacted log would need
+  uint16_t keys;        // keys in the index
+  uint32_t commits;     // batches appended since boot
+  uint32_t compactions; // compactions since boot
+};
+
+/**
+ * @brief Loads the store and builds the RAM index of value offsets.
+ *
+ * The log is read once. A batch torn by a power cut is dropped as a whole
+ * and the log is compacted.
+ *
+ * @return true if the store is usable
+ */
+bool kvInit();
+
+/**
+ * @brief Removes every key (factory reset).
+ *
+ * Does not need kvInit(): the log is replaced by an empty one.
+ *
+ * @return true if the empty log was written
+ */
+bool kvClear();
+
+/**
+ * @brief Starts a batch: the following updates are appended together,
+ * with a single file open, by kvCommit().
+ *
+ * A batch is all-or-nothing across power cuts. Reads inside a batch
+ * return the values from before it. Batches do not nest.
+ *
+ * @return false if a batch is already open
+ */
+bool kvBegin();
+
+/**
+ * @brief Appends the open batch to the log and updates the index.
+ *
+ * @return false if the write failed (no update of the batch is applied)
+ */
+bool kvCommit();
+
+/**
+ * @brief Discards the open batch.
+ */
+void kvAbort();
+
+/**
+ * @brief Stores a value (a batch of one when no batch is open).
+ *
+ * @param key KvKey
+ * @param type KvType
+ * @param data Value bytes
+ * @param length 0 to KV_MAX_VALUE_LEN bytes
+ * @return false if the value is too large, the batch is full or the
+ * write failed
+ */
+bool kvSet(uint16_t key, uint8_t type, const void *data, size_t length);
+
+/**
+ * @brief Reads a value of an exact type and length.
+ *
+ * @return false if the key is missing or has another type or length
+ */
+bool kvGet(uint16_t key, uint8_t type, void *out, size_t length);
+
+bool kvSetString(uint16_t key, const char *value);
+
+/**
+ * @brief Reads a string value.
+ *
+ * @param out Destination, always NUL terminated on success
+ * @param size Size of `out`
+ * @return false if missing, not a string or longer than size - 1
+ */
+bool kvGetString(uint16_t key, char *out, size_t size);
+
+bool kvSetU32(uint16_t key, uint32_t value);
+bool kvGetU32(uint16_t key, uint32_t &value);
+
+bool kvSetFloat(uint16_t key, float value);
+bool kvGetFloat(uint16_t key, float &value);
+
+bool kvSetBool(uint16_t key, bool value);
+bool kvGetBool(uint16_t key, bool &value);
+
+/**
+ * @brief Removes a key (appends a tombstone).
+ *
+ * @return true if the key no longer exists
+ */
+bool kvRemove(uint16_t key);
+
+/**
+ * @brief Whether a key exists.
+ */
+bool kvHas(uint16_t key);
+
+/**
+ * @brief Store counters.
+ */
+const KvStats &kvStats();
@@ -0,0 +1,269 @@
+#include "LinkMonitor.h"
+#include <ESP8266WiFi.h>
+#include <WifiManager.h>
+
+#include <Debug.h>
+
+static LinkSample ring[LINK_HISTORY_SIZE];
+static uint16_t ringHead = 0; // next write position
+static uint16_t ringCount = 0;
+
+static LinkReasonCount reasons[LINK_REASON_SLOTS];
+static LinkStats stats;
+
+static WiFiEventHandler disconnectHandler;
+
+/* Reason of the last disconnect event (0 = none since the link came up) */
+static volatile uint8_t lastReason = 0;
+
+static uint8_t prevState = WifiIdle;
+static unsigned long lastSample = 0;
+static unsigned long lostAt = 0;
+static bool linkLost = false;
+static bool proactivePending = false; // the next loss was requested
+static bool scanning = false;         // background scan for a weak link
+
+static void saturatingInc(uint16_t &counter) {
+  if (counter < UINT16_MAX)
+    counter++;
+}
+
+void linkMonitorInit() {
+  // Runs in the SDK event context: only record the reason
+  disconnectHandler = WiFi.onStationModeDisconnected(
+      [](const WiFiEventStationModeDisconnected &event) {
+        lastReason = event.reason;
+      });
+
+  lastSample = millis();
+}
+
+static void countReason(uint8_t reason) {
+  for (size_t i = 0; i < LINK_REASON_SLOTS; i++) {
+    if (reasons[i].count == 0)
+      reasons[i].reason = reason;
+
+    if (reasons[i].reason == reason) {
+      saturatingInc(reasons[i].count);
+      return;
+    }
+  }
+  saturatingInc(stats.otherReasons);
+}
+
+static void linkDown() {
+  lostAt = millis();
+  linkLost = true;
+
+  if (proactivePending) {
+    proactivePending = false;
+    return;
+  }
+
+  uint8_t reason = lastReason;
+  stats.disconnects++;
+  countReason(reason);
+
+  debugPrintln(F("[LINK]"), "Link lost: " + linkReasonToString(reason) +
+                                " (" + String(reason) + ")");
+}
+
+static void linkUp() {
+  lastReason = 0;
+
+  if (!linkLost)
+    return;
+
+  linkLost = false;
+
+  uint32_t elapsed = millis() - lostAt;
+  stats.reconnects++;
+  stats.lastReconnectMs = elapsed;
+  stats.totalReconnectMs += elapsed;
+  if (elapsed > stats.maxReconnectMs)
+    stats.maxReconnectMs = elapsed;
+
+  debugPrintln(F("[LINK]"), "Reconnected in " + String(elapsed) + " ms");
+}
+
+/**
+ * @brief Records a sample and reconnects when the link stays weak.
+ */
+static void sampleLink() {
+  LinkSample sample;
+  sample.state = wifiState();
+  sample.rssi = LINK_NO_RSSI;
+
+  if (sample.state == WifiConnected) {
+    // The SDK reports 31 when no value is available
+    int32_t rssi = WiFi.RSSI();
+    if (rssi < 0)
+      sample.rssi = rssi < -127 ? -127 : rssi;
+  }
+
+  ring[ringHead] = sample;
+  ringHead = (ringHead + 1) % LINK_HISTORY_SIZE;
+  if (ringCount < LINK_HISTORY_SIZE)
+    ringCount++;
+
+  bool weak = sample.rssi != LINK_NO_RSSI && sample.rssi < LINK_RSSI_WEAK;
+  if (!weak) {
+    stats.weakStreak = 0;
+    return;
+  }
+
+  if (stats.weakStreak < UINT8_MAX)
+    stats.weakStreak++;
+
+  if (LINK_WEAK_SAMPLES == 0 || stats.weakStreak < LINK_WEAK_SAMPLES ||
+      scanning)
+    return;
+
+  if (stats.scans > 0 && millis() - stats.lastScan < LINK_RECONNECT_HOLDOFF_MS)
+    return;
+
+  debugPrintln(F("[LINK]"), "Weak link (" + String(sample.rssi) +
+                                " dBm), scanning for a stronger AP.");
+
+  stats.weakStreak = 0;
+  saturatingInc(stats.scans);
+  stats.lastScan = millis();
+
+  // Asynchronous: the link stays up while the scan runs
+  scanning = WiFi.scanNetworks(true) == WIFI_SCAN_RUNNING;
+}
+
+/**
+ * @brief Whether a scan result is another access point of a stored
+ * network, LINK_ROAM_MARGIN_DB stronger than the current link.
+ */
+static bool strongerAccessPoint(int item, int32_t rssi) {
+  if (WiFi.RSSI(item) < rssi + LINK_ROAM_MARGIN_DB)
+    return false;
+
+  const uint8_t *bssid = WiFi.BSSID(item);
+  if (!bssid || memcmp(bssid, WiFi.BSSID(), 6) == 0)
+    return false;
+
+  String ssid = WiFi.SSID(item);
+  for (size_t i = 0; i < wifiNetworkCount(); i++) {
+    if (ssid == wifiNetwork(i)->ssid)
+      return true;
+  }
+  return false;
+}
+
+/**
+ * @brief Reconnects once the scan shows a stronger access point, keeps
+ * the weak link otherwise.
+ */
+static void scanLoop() {
+  // Link lost meanwhile: the scan is left to the WiFi state machine
+  if (wifiState() != WifiConnected) {
+    scanning = false;
+    return;
+  }
+
+  int8_t found = WiFi.scanComplete();
+  if (found == WIFI_SCAN_RUNNING &&
+      millis() - stats.lastScan < WIFI_SCAN_TIMEOUT_MS)
+    return;
+
+  scanning = false;
+
+  int32_t rssi = WiFi.RSSI();
+  bool better = false;
+  for (int i = 0; i < found && !better; i++)
+    better = strongerAccessPoint(i, rssi);
+  WiFi.scanDelete();
+
+  if (!better) {
+    debugPrintln(F("[LINK]"), F("No stronger access point, link kept."));
+    return;
+  }
+
+  debugPrintln(F("[LINK]"), F("Stronger access point found, reconnecting."));
+
+  saturatingInc(stats.proactive);
+  stats.lastProactive = millis();
+
+  proactivePending = true;
+  if (!wifiReconnect())
+    proactivePending = false;
+}
+
+void linkMonitorLoop() {
+  uint8_t state = wifiState();
+
+  if (state != prevState) {
+    if (prevState == WifiConnected)
+      linkDown();
+    else if (state == WifiConnected)
+      linkUp();
+
+    prevState = state;
+  }
+
+  if (scanning)
+    scanLoop();
+
+  if (millis() - lastSample >= LINK_SAMPLE_INTERVAL_MS) {
+    lastSample = millis();
+    sampleLink();
+  }
+}
+
+const LinkSample *linkHistoryEntry(size_t index) {
+  if (index >= ringCount)
+    return nullptr;
+
+  size_t pos = (ringHead + LINK_HISTORY_SIZE - 1 - index) % LINK_HISTORY_SIZE;
+  return &ring[pos];
+}
+
+size_t linkHistoryCount() { return ringCount; }
+
+const LinkReasonCount *linkReasons(size_t &count) {
+  count = 0;
+  while (count < LINK_REASON_SLOTS && reasons[count].count > 0)
+    count++;
+
+  return reasons;
+}
+
+const LinkStats &linkStats() { return stats; }
+
+String linkReasonToString(uint8_t reason) {
+  switch (reason) {
+  case WIFI_DISCONNECT_REASON_UNSPECIFIED:
+    return "Unspecified";
+  case WIFI_DISCONNECT_REASON_AUTH_EXPIRE:
+    return "AuthExpire";
+  case WIFI_DISCONNECT_REASON_AUTH_LEAVE:
+    return "AuthLeave";
+  case WIFI_DISCONNECT_REASON_ASSOC_EXPIRE:
+    return "AssocExpire";
+  case WIFI_DISCONNECT_REASON_ASSOC_TOOMANY:
+    return "AssocTooMany";
+  case WIFI_DISCONNECT_REASON_NOT_AUTHED:
+    return "NotAuthed";
+  case WIFI_DISCONNECT_REASON_NOT_ASSOCED:
+    return "NotAssoced";
+  case WIFI_DISCONNECT_REASON_ASSOC_LEAVE:
+    return "AssocLeave";
+  case WIFI_DISCONNECT_REASON_4WAY_HANDSHAKE_TIMEOUT:
+    return "4WayHandshakeTimeout";
+  case WIFI_DISCONNECT_REASON_BEACON_TIMEOUT:
+    return "BeaconTimeout";
+  case WIFI_DISCONNECT_REASON_NO_AP_FOUND:
+    return "NoApFound";
+  case WIFI_DISCONNECT_REASON_AUTH_FAIL:
+    return "AuthFail";
+  case WIFI_DISCONNECT_REASON_ASSOC_FAIL:
+    return "AssocFail";
+  case WIFI_DISCONNECT_REASON_HANDSHAKE_TIMEOUT:
+    return "HandshakeTimeout";
+  default:
+    return "Unknown";
+  }
+}
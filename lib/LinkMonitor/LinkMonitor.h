@@ -0,0 +1,145 @@
+#pragma once
+
+#include <Arduino.h>
+
+/**
+ * @brief Interval between two link samples, in milliseconds.
+ */
+#ifndef LINK_SAMPLE_INTERVAL_MS
+#define LINK_SAMPLE_INTERVAL_MS 10000UL
+#endif
+
+/**
+ * @brief Number of samples kept in the RAM ring (2 bytes each; 10 minutes
+ * at the default interval).
+ */
+#ifndef LINK_HISTORY_SIZE
+#define LINK_HISTORY_SIZE 60
+#endif
+
+/**
+ * @brief RSSI (dBm) below which a sample counts as weak.
+ */
+#ifndef LINK_RSSI_WEAK
+#define LINK_RSSI_WEAK -80
+#endif
+
+/**
+ * @brief Consecutive weak samples that trigger a background scan for a
+ * stronger access point. 0 disables proactive reconnects.
+ */
+#ifndef LINK_WEAK_SAMPLES
+#define LINK_WEAK_SAMPLES 6
+#endif
+
+/**
+ * @brief How much stronger (dB) than the current link an access point of
+ * a stored network must be for the weak link to be dropped.
+ */
+#ifndef LINK_ROAM_MARGIN_DB
+#define LINK_ROAM_MARGIN_DB 8
+#endif
+
+/**
+ * @brief Minimum time between two scans for a weak link, in milliseconds.
+ */
+#define LINK_RECONNECT_HOLDOFF_MS 600000UL
+
+/**
+ * @brief Number of distinct disconnect reason codes counted; further codes
+ * are counted together as "other".
+ */
+#define LINK_REASON_SLOTS 8
+
+/**
+ * @brief Sample RSSI value meaning "no link".
+ */
+#define LINK_NO_RSSI 0
+
+/**
+ * @brief One sample of the history ring.
+ */
+struct LinkSample {
+  int8_t rssi;   // dBm, LINK_NO_RSSI without a link
+  uint8_t state; // WifiState
+};
+
+/**
+ * @brief Link losses counted for one reason code.
+ */
+struct LinkReasonCount {
+  uint8_t reason; // WiFiDisconnectReason
+  uint16_t count;
+};
+
+/**
+ * @brief Counters since boot.
+ *
+ * Disconnects are links lost while connected (not failed attempts);
+ * proactive reconnects are counted apart. The reconnect time runs from
+ * the loss of the link to the next connection.
+ */
+struct LinkStats {
+  uint32_t disconnects;
+  uint16_t otherReasons; // losses whose reason had no free slot
+  uint32_t reconnects;
+  uint32_t lastReconnectMs;
+  uint32_t maxReconnectMs;
+  uint32_t totalReconnectMs;
+  uint16_t scans;              // background scans for a weak link
+  unsigned long lastScan;      // millis() of the last one, 0 if none
+  uint16_t proactive;          // reconnects to a stronger access point
+  unsigned long lastProactive; // millis() of the last one, 0 if none
+  uint8_t weakStreak;          // current run of weak samples
+};
+
+/**
+ * @brief Registers the WiFi event handler. Call after wifiInit().
+ */
+void linkMonitorInit();
+
+/**
+ * @brief Tracks link transitions, samples the link every
+ * LINK_SAMPLE_INTERVAL_MS and triggers proactive reconnects.
+ *
+ * A link that stays weak is only dropped when a background scan (the
+ * link stays up) finds an access point of a stored network that is
+ * LINK_ROAM_MARGIN_DB stronger; with a single access point in range the
+ * weak link is kept.
+ *
+ * This function must be called repeatedly inside the main loop(), after
+ * wifiLoop().
+ */
+void linkMonitorLoop();
+
+/**
+ * @brief Returns a sample, newest first.
+ *
+ * @param index 0 = most recent
+ * @return nullptr if index >= linkHistoryCount()
+ */
+const LinkSample *linkHistoryEntry(size_t index);
+
+/**
+ * @brief Number of samples in the ring.
+ */
+size_t linkHistoryCount();
+
+/**
+ * @brief Disconnect reason counters in use.
+ *
+ * @param count Set to the number of entries
+ */
+const LinkReasonCount *linkReasons(size_t &count);
+
+/**
+ * @brief Counters since boot.
+ */
+const LinkStats &linkStats();
+
+/**
+ * @brief Converts a disconnect reason code to its string representation.
+ *
+ * @return Name of the common 802.11 and SDK codes, "Unknown" otherwise
+ */
+String linkReasonToString(uint8_t reason);
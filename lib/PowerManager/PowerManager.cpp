@@ -0,0 +1,183 @@
+#include "PowerManager.h"
+#include <AtScheduler.h>
+#include <Clock.h>
+#include <DeviceController.h>
+#include <ESP8266WiFi.h>
+#include <HttpQueue.h>
+#include <KvStore.h>
+
+#include <Debug.h>
+
+/* Loops counted before the histogram is halved */
+#define POWER_LOOPS_HALVE 0x80000000UL
+
+static const PowerProfileInfo profiles[PowerProfileCount] = {
+    {WIFI_NONE_SLEEP, 0, 0, 70, 70},   // Performance
+    {WIFI_MODEM_SLEEP, 0, 5, 70, 15},  // Balanced
+    {WIFI_LIGHT_SLEEP, 3, 50, 70, 3},  // LowPower
+};
+
+static uint8_t profile = PowerBalanced;
+static PowerStats stats;
+static unsigned long lastLoop = 0;
+
+static void resetStats() {
+  stats = {};
+  stats.sinceMs = millis();
+  lastLoop = 0;
+}
+
+static void applyProfile() {
+  const PowerProfileInfo &info = profiles[profile];
+
+  WiFi.setSleepMode((WiFiSleepType_t)info.sleepType, info.listenInterval);
+  resetStats();
+
+  debugPrintln(F("[POWER]"), "Profile " + powerProfileToString(profile));
+}
+
+void powerInit() {
+  uint32_t stored;
+  if (kvGetU32(KvKeyPowerProfile, stored) && stored < PowerProfileCount)
+    profile = stored;
+
+  applyProfile();
+}
+
+bool powerSetProfile(uint8_t value) {
+  if (value >= PowerProfileCount)
+    return false;
+
+  if (value != profile && !kvSetU32(KvKeyPowerProfile, value))
+    return false;
+
+  profile = value;
+  applyProfile();
+  return true;
+}
+
+/**
+ * @brief Shortens the idle delay so that no local deadline is passed.
+ */
+static uint32_t idleBudget(uint32_t idleMs) {
+  if (httpQueuePending() > 0)
+    return 0;
+
+  for (uint8_t pin = 0; pin <= 16 && idleMs > 0; pin++) {
+    uint32_t remaining = devicePulseRemaining(pin);
+    if (remaining > 0 && remaining < idleMs)
+      idleMs = remaining;
+  }
+
+  if (atPendingCount() == 0)
+    return idleMs;
+
+  uint64_t now = clockNowMs();
+  for (size_t i = 0; i < AT_MAX_JOBS && idleMs > 0; i++) {
+    const AtJob *job = atSlot(i);
+    if (job->state != AtPending)
+      continue;
+
+    if (job->deadlineMs <= now)
+      return 0;
+    if (job->deadlineMs - now < idleMs)
+      idleMs = job->deadlineMs - now;
+  }
+  return idleMs;
+}
+
+static void recordGap(uint32_t gapMs) {
+  uint8_t bucket = 0;
+  while (gapMs > 0 && bucket < POWER_GAP_BUCKETS - 1) {
+    gapMs >>= 1;
+    bucket++;
+  }
+
+  if (stats.loops >= POWER_LOOPS_HALVE) {
+    stats.loops /= 2;
+    for (uint8_t i = 0; i < POWER_GAP_BUCKETS; i++)
+      stats.gapHist[i] /= 2;
+  }
+
+  stats.loops++;
+  stats.gapHist[bucket]++;
+}
+
+void powerLoop() {
+  unsigned long now = millis();
+
+  if (lastLoop != 0) {
+    uint32_t gap = now - lastLoop;
+    recordGap(gap);
+    if (gap > stats.maxGapMs)
+      stats.maxGapMs = gap;
+  }
+  lastLoop = now;
+
+  uint32_t idleMs = idleBudget(profiles[profile].idleMs);
+  if (idleMs == 0)
+    return;
+
+  // delay() lets the SDK put the modem (or the whole chip) to sleep
+  delay(idleMs);
+  stats.idleMs += idleMs;
+}
+
+uint8_t powerProfile() { return profile; }
+
+const PowerProfileInfo *powerProfileInfo(uint8_t value) {
+  if (value >= PowerProfileCount)
+    return nullptr;
+
+  return &profiles[value];
+}
+
+const PowerStats &powerStats() { return stats; }
+
+uint32_t powerGapPercentile(uint8_t percent) {
+  if (stats.loops == 0)
+    return 0;
+
+  uint64_t target = ((uint64_t)stats.loops * percent + 99) / 100;
+  uint64_t seen = 0;
+
+  for (uint8_t b = 0; b < POWER_GAP_BUCKETS - 1; b++) {
+    seen += stats.gapHist[b];
+    if (seen >= target)
+      return 1UL << b;
+  }
+  return stats.maxGapMs;
+}
+
+uint16_t powerEstimatedMa() {
+  const PowerProfileInfo &info = profiles[profile];
+  uint32_t elapsed = millis() - stats.sinceMs;
+
+  if (elapsed == 0 || stats.idleMs > elapsed)
+    return info.activeMa;
+
+  uint64_t charge = (uint64_t)info.activeMa * (elapsed - stats.idleMs) +
+                    (uint64_t)info.idleMa * stats.idleMs;
+  return charge / elapsed;
+}
+
+String powerProfileToString(uint8_t value) {
+  switch (value) {
+  case PowerPerformance:
+    return "Performance";
+  case PowerBalanced:
+    return "Balanced";
+  case PowerLowPower:
+    return "LowPower";
+  default:
+    return "Unknown";
+  }
+}
+
+uint8_t powerProfileFromString(const String &name) {
+  for (uint8_t p = 0; p < PowerProfileCount; p++) {
+    if (name.equalsIgnoreCase(powerProfileToString(p)))
+      return p;
+  }
+  return PowerProfileCount;
+}
@@ -0,0 +1,132 @@
+#pragma once
+
+#include <Arduino.h>
+
+/**
+ * @brief Number of loop gap histogram buckets: bucket 0 counts gaps under
+ * 1 ms, bucket b gaps under 2^b ms, the last one everything longer.
+ */
+#define POWER_GAP_BUCKETS 12
+
+/**
+ * @brief Power profile.
+ *
+ * | Profile     | WiFi sleep | Listen interval | Idle delay |
+ * | ----------- | ---------- | --------------- | ---------- |
+ * | Performance | none       | -               | 0 ms       |
+ * | Balanced    | modem      | AP DTIM         | 5 ms       |
+ * | LowPower    | light      | 3 DTIM          | 50 ms      |
+ *
+ * The idle delay is shortened so that it never passes the deadline of a
+ * one-shot job or the end of a pulse, and skipped while outbound HTTP
+ * requests are queued. Light sleep pauses the CPU between beacons: PWM
+ * outputs are not driven while it sleeps.
+ */
+enum PowerProfile {
+  PowerPerformance = 0,
+  PowerBalanced,
+  PowerLowPower,
+  PowerProfileCount
+};
+
+/**
+ * @brief Settings and nominal current draw of a profile.
+ *
+ * Currents are estimates for the ESP8266 module (datasheet figures),
+ * not measurements: the radio is fully on while awake, and the idle
+ * figure is the average over the sleep pattern of the profile.
+ */
+struct PowerProfileInfo {
+  uint8_t sleepType;      // WiFiSleepType_t
+  uint8_t listenInterval; // DTIM periods between wake-ups, 0 = AP DTIM
+  uint16_t idleMs;        // delay() at the end of an idle loop
+  uint16_t activeMa;      // estimated draw while the loop runs
+  uint16_t idleMa;        // estimated draw during the idle delay
+};
+
+/**
+ * @brief Loop measurements since the profile was applied.
+ *
+ * The loop gap is the time between two passes of loop(): a request or a
+ * local event waits at most this long before it is served (the radio
+ * wake-up latency of the sleep modes comes on top of it and can only be
+ * measured from a client).
+ */
+struct PowerStats {
+  uint32_t loops;
+  uint32_t gapHist[POWER_GAP_BUCKETS];
+  uint32_t maxGapMs;
+  uint32_t idleMs;  // time spent in the idle delay
+  uint32_t sinceMs; // millis() when the profile was applied
+};
+
+/**
+ * @brief Loads the stored profile (default Balanced) and applies it.
+ * Call after wifiInit() and before wifiStart().
+ */
+void powerInit();
+
+/**
+ * @brief Measures the loop gap and sleeps for the idle delay of the
+ * profile.
+ *
+ * This function must be called at the end of the main loop().
+ */
+void powerLoop();
+
+/**
+ * @brief Applies and stores a profile, and resets the measurements.
+ *
+ * The sleep type takes effect at once; the listen interval is used from
+ * the next connection.
+ *
+ * @return false if the profile is invalid or could not be stored
+ */
+bool powerSetProfile(uint8_t profile);
+
+/**
+ * @brief Current PowerProfile.
+ */
+uint8_t powerProfile();
+
+/**
+ * @brief Settings of a profile.
+ *
+ * @return nullptr if the profile is invalid
+ */
+const PowerProfileInfo *powerProfileInfo(uint8_t profile);
+
+/**
+ * @brief Measurements since the profile was applied.
+ */
+const PowerStats &powerStats();
+
+/**
+ * @brief Loop gap percentile, rounded up to its histogram bucket.
+ *
+ * @param percent 1..100
+ * @return Upper bound of the bucket in milliseconds, 0 without samples
+ */
+uint32_t powerGapPercentile(uint8_t percent);
+
+/**
+ * @brief Average current estimated from the profile figures and the share
+ * of time spent in the idle delay.
+ *
+ * @return Milliamperes
+ */
+uint16_t powerEstimatedMa();
+
+/**
+ * @brief Converts a PowerProfile value to its string representation.
+ *
+ * @return "Performance", "Balanced", "LowPower" or "Unknown"
+ */
+String powerProfileToString(uint8_t profile);
+
+/**
+ * @brief Parses a profile name (as returned by powerProfileToString()).
+ *
+ * @return PowerProfileCount if the name is unknown
+ */
+uint8_t powerProfileFromString(const String &name);
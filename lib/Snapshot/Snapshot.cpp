@@ -0,0 +1,491 @@
+#include "Snapshot.h"
+
+#include <BinaryStorage.h>
+#include <Clock.h>
+#include <CronScheduler.h>
+#include <Debug.h>
+#include <DeviceController.h>
+#include <KvStore.h>
+#include <Solar.h>
+#include <coredecls.h>
+
+#define SNAPSHOT_MAGIC 0x50534E44 // "DNSP"
+#define SNAPSHOT_STAGING_PATH "/snapshot_upload.bin"
+
+struct SnapshotHeader {
+  uint32_t magic;
+  uint16_t version;
+  uint16_t reserved;
+};
+
+struct SnapRecordHeader {
+  uint8_t type;
+  uint8_t reserved;
+  uint16_t length; // payload bytes
+};
+
+struct SnapCronRecord {
+  uint16_t index;
+  uint16_t reserved;
+  CronJob job;
+};
+
+struct SnapFlagsRecord {
+  uint8_t serialDebug;
+  uint8_t reserved[3];
+};
+
+struct SnapSolarRecord {
+  float latitude;
+  float longitude;
+};
+
+/* Largest payload of a known record type */
+#define SNAPSHOT_RECORD_MAX sizeof(SnapCronRecord)
+
+static_assert(SNAPSHOT_RECORD_MAX >= CLOCK_TZ_MAX_LEN,
+              "record buffer must hold a timezone");
+
+/* Largest valid document: every record present once per pin / slot */
+static const size_t SNAPSHOT_MAX_SIZE =
+    sizeof(SnapshotHeader) +
+    MAX_GPIO_PINS * (sizeof(SnapRecordHeader) + sizeof(GpioConfig)) +
+    MAX_CRON_JOBS * (sizeof(SnapRecordHeader) + sizeof(SnapCronRecord)) +
+    sizeof(SnapRecordHeader) + sizeof(SnapFlagsRecord) +
+    sizeof(SnapRecordHeader) + CLOCK_TZ_MAX_LEN + sizeof(SnapRecordHeader) +
+    sizeof(SnapSolarRecord) + sizeof(SnapRecordHeader) + sizeof(uint32_t);
+
+/* Export output buffer */
+static SnapshotWriter outWriter = nullptr;
+static uint8_t outBuf[SNAPSHOT_CHUNK_SIZE];
+static size_t outLen = 0;
+static size_t outTotal = 0;
+static uint32_t outCrc = 0;
+
+/* Import: staged upload and a buffered reader over it */
+static size_t stagedSize = 0;
+static bool staging = false;
+
+static uint8_t readBuf[SNAPSHOT_READ_SIZE];
+static size_t readBufStart = 0;
+static size_t readBufLen = 0;
+static size_t readOffset = 0;
+static uint32_t readCrc = 0;
+
+static uint8_t recordBuf[SNAPSHOT_RECORD_MAX];
+
+/* Settings collected from the document before they are applied */
+static GpioConfig importPins[MAX_GPIO_PINS];
+static uint8_t importPinCount = 0;
+static uint32_t importPinMask = 0;
+static int32_t importLastJob = -1;
+static uint16_t importJobCount = 0;
+static char importTz[CLOCK_TZ_MAX_LEN];
+static SnapSolarRecord importSolar;
+static SnapFlagsRecord importFlags;
+static bool hasTz = false;
+static bool hasSolar = false;
+static bool hasFlags = false;
+
+/* -------------------------------------------------------------------------- */
+/* Export                                                                     */
+/* -------------------------------------------------------------------------- */
+
+/**
+ * @brief Adds bytes to the output, handing every full buffer to the writer.
+ */
+static void emit(const void *data, size_t length) {
+  const uint8_t *p = (const uint8_t *)data;
+
+  outCrc = crc32(p, length, outCrc);
+  outTotal += length;
+
+  while (length > 0) {
+    size_t n = SNAPSHOT_CHUNK_SIZE - outLen;
+    if (n > length)
+      n = length;
+
+    memcpy(outBuf + outLen, p, n);
+    outLen += n;
+    p += n;
+    length -= n;
+
+    if (outLen == SNAPSHOT_CHUNK_SIZE) {
+      outWriter(outBuf, outLen);
+      outLen = 0;
+    }
+  }
+}
+
+static void emitRecord(uint8_t type, const void *data, uint16_t length) {
+  SnapRecordHeader hdr = {type, 0, length};
+  emit(&hdr, sizeof(hdr));
+  emit(data, length);
+}
+
+size_t snapshotExport(SnapshotWriter write) {
+  if (!write)
+    return 0;
+
+  outWriter = write;
+  outLen = 0;
+  outTotal = 0;
+  outCrc = 0xFFFFFFFF;
+
+  SnapshotHeader hdr = {SNAPSHOT_MAGIC, SNAPSHOT_VERSION, 0};
+  emit(&hdr, sizeof(hdr));
+
+  // Pins
+  GpioConfig *pins = deviceGetAll();
+  for (size_t i = 0; i < MAX_GPIO_PINS; i++) {
+    if (pins[i].mode != PinMode::Disabled)
+      emitRecord(SnapPin, &pins[i], sizeof(GpioConfig));
+  }
+
+  // Cron jobs, one record read at a time
+  SnapCronRecord rec;
+  for (uint16_t i = 0; i < MAX_CRON_JOBS; i++) {
+    if (!cronGet(i, rec.job) || (!rec.job.active && rec.job.cron[0] == '\0'))
+      continue;
+
+    // Runtime state, not configuration
+    rec.job.lastExecEpoch = 0;
+    rec.index = i;
+    rec.reserved = 0;
+    emitRecord(SnapCronJob, &rec, sizeof(rec));
+  }
+
+  // Flags (authentication is never exported)
+  SnapFlagsRecord flags = {};
+  flags.serialDebug = debugEnabled();
+  emitRecord(SnapFlags, &flags, sizeof(flags));
+
+  const char *tz = clockTimezone();
+  emitRecord(SnapTimezone, tz, strlen(tz));
+
+  if (solarHasLocation()) {
+    SnapSolarRecord solar = {solarLatitude(), solarLongitude()};
+    emitRecord(SnapSolar, &solar, sizeof(solar));
+  }
+
+  // The CRC covers everything up to the end record payload
+  SnapRecordHeader end = {SnapEnd, 0, sizeof(uint32_t)};
+  emit(&end, sizeof(end));
+  uint32_t crc = outCrc;
+  emit(&crc, sizeof(crc));
+
+  if (outLen > 0)
+    outWriter(outBuf, outLen);
+
+  debugPrintln(F("[SNAPSHOT]"), "Exported " + String(outTotal) + " bytes");
+  return outTotal;
+}
+
+/* -------------------------------------------------------------------------- */
+/* Import                                                                     */
+/* -------------------------------------------------------------------------- */
+
+void snapshotImportAbort() {
+  staging = false;
+  stagedSize = 0;
+  storageRemove(SNAPSHOT_STAGING_PATH);
+}
+
+bool snapshotImportBegin() {
+  snapshotImportAbort();
+  staging = true;
+  return true;
+}
+
+SnapshotResult snapshotImportWrite(const uint8_t *data, size_t length) {
+  if (!staging)
+    return SnapshotStorageError;
+
+  if (stagedSize + length > SNAPSHOT_MAX_SIZE)
+    return SnapshotTooLarge;
+
+  if (!storageAppend(SNAPSHOT_STAGING_PATH, data, length))
+    return SnapshotStorageError;
+
+  stagedSize += length;
+  return SnapshotOk;
+}
+
+/**
+ * @brief Reads the next bytes of the staged document.
+ *
+ * @return false at the end of the document or on a read error
+ */
+static bool readBytes(void *dst, size_t length) {
+  uint8_t *p = (uint8_t *)dst;
+
+  if (readOffset + length > stagedSize)
+    return false;
+
+  while (length > 0) {
+    if (readOffset >= readBufStart + readBufLen) {
+      readBufStart = readOffset;
+      readBufLen = stagedSize - readOffset;
+      if (readBufLen > SNAPSHOT_READ_SIZE)
+        readBufLen = SNAPSHOT_READ_SIZE;
+
+      if (!storageReadAt(SNAPSHOT_STAGING_PATH, readBufStart, readBuf,
+                         readBufLen))
+        return false;
+    }
+
+    size_t avail = readBufStart + readBufLen - readOffset;
+    size_t n = avail < length ? avail : length;
+
+    memcpy(p, readBuf + (readOffset - readBufStart), n);
+    readCrc = crc32(p, n, readCrc);
+    readOffset += n;
+    p += n;
+    length -= n;
+  }
+  return true;
+}
+
+static bool pinValid(const GpioConfig &c) {
+  if (c.pin == A0)
+    return c.mode == PinMode::Analog;
+
+  if (!gpioIsValid(c.pin))
+    return false;
+
+  switch (c.mode) {
+  case PinMode::Input:
+  case PinMode::Output:
+    return true;
+  case PinMode::Pwm:
+    return gpioSupportsPWM(c.pin) && c.state >= 0 && c.state <= 1023;
+  case PinMode::InputPullup:
+    return gpioSupportsPullup(c.pin);
+  default:
+    return false;
+  }
+}
+
+static bool cronJobValid(const CronJob &job) {
+  if (!memchr(job.cron, '\0', sizeof(job.cron)) ||
+      job.action > PulsePinState || job.misfirePolicy > MisfireRunAll)
+    return false;
+
+  if (job.action == HttpRequest && !memchr(job.url, '\0', sizeof(job.url)))
+    return false;
+
+  if ((job.action == SetPinState || job.action == TogglePinState ||
+       job.action == PulsePinState) &&
+      !gpioIsValid(job.pin))
+    return false;
+
+  CronSchedule sched;
+  return !job.active || (cronCompile(job.cron, sched) && cronCanFire(sched));
+}
+
+/**
+ * @brief Handles one record of a known type.
+ *
+ * In the validation pass settings are checked and collected; in the
+ * apply pass cron jobs are streamed into the new job table.
+ */
+static SnapshotResult handleRecord(const SnapRecordHeader &hdr, bool apply) {
+  switch (hdr.type) {
+  case SnapPin: {
+    if (hdr.length != sizeof(GpioConfig) || !readBytes(recordBuf, hdr.length))
+      return SnapshotInvalid;
+
+    GpioConfig c;
+    memcpy(&c, recordBuf, sizeof(c));
+
+    if (!pinValid(c) || (importPinMask & (1UL << c.pin)))
+      return SnapshotInvalid;
+
+    importPinMask |= 1UL << c.pin;
+    importPins[importPinCount++] = c;
+    return SnapshotOk;
+  }
+
+  case SnapCronJob: {
+    if (hdr.length != sizeof(SnapCronRecord) ||
+        !readBytes(recordBuf, hdr.length))
+      return SnapshotInvalid;
+
+    SnapCronRecord rec;
+    memcpy(&rec, recordBuf, sizeof(rec));
+
+    if (rec.index >= MAX_CRON_JOBS || (int32_t)rec.index <= importLastJob)
+      return SnapshotInvalid;
+    importLastJob = rec.index;
+    importJobCount++;
+
+    if (apply)
+      return cronImportJob(rec.index, rec.job) ? SnapshotOk
+                                               : SnapshotStorageError;
+
+    return cronJobValid(rec.job) ? SnapshotOk : SnapshotInvalid;
+  }
+
+  case SnapFlags:
+    if (hdr.length != sizeof(SnapFlagsRecord) ||
+        !readBytes(&importFlags, hdr.length))
+      return SnapshotInvalid;
+
+    hasFlags = true;
+    return SnapshotOk;
+
+  case SnapTimezone:
+    if (hdr.length == 0 || hdr.length >= CLOCK_TZ_MAX_LEN ||
+        !readBytes(importTz, hdr.length))
+      return SnapshotInvalid;
+
+    importTz[hdr.length] = '\0';
+    hasTz = strlen(importTz) == hdr.length;
+    return hasTz ? SnapshotOk : SnapshotInvalid;
+
+  case SnapSolar:
+    if (hdr.length != sizeof(SnapSolarRecord) ||
+        !readBytes(&importSolar, hdr.length))
+      return SnapshotInvalid;
+
+    if (!(importSolar.latitude >= -90 && importSolar.latitude <= 90 &&
+          importSolar.longitude >= -180 && importSolar.longitude <= 180))
+      return SnapshotInvalid;
+
+    hasSolar = true;
+    return SnapshotOk;
+
+  default:
+    // Newer record type: skip it
+    for (size_t left = hdr.length; left > 0;) {
+      size_t n = left < sizeof(recordBuf) ? left : sizeof(recordBuf);
+      if (!readBytes(recordBuf, n))
+        return SnapshotInvalid;
+      left -= n;
+    }
+    return SnapshotOk;
+  }
+}
+
+/**
+ * @brief Reads the whole staged document once.
+ */
+static SnapshotResult walk(bool apply) {
+  readOffset = 0;
+  readBufStart = 0;
+  readBufLen = 0;
+  readCrc = 0xFFFFFFFF;
+
+  importPinCount = 0;
+  importPinMask = 0;
+  importLastJob = -1;
+  importJobCount = 0;
+  hasTz = hasSolar = hasFlags = false;
+
+  SnapshotHeader hdr;
+  if (!readBytes(&hdr, sizeof(hdr)) || hdr.magic != SNAPSHOT_MAGIC ||
+      hdr.version != SNAPSHOT_VERSION)
+    return SnapshotInvalid;
+
+  SnapRecordHeader rec;
+  while (readBytes(&rec, sizeof(rec))) {
+    if (rec.type == SnapEnd) {
+      uint32_t expected = readCrc;
+      uint32_t crc;
+
+      if (rec.length != sizeof(crc) || !readBytes(&crc, sizeof(crc)) ||
+          readOffset != stagedSize)
+        return SnapshotInvalid;
+
+      return crc == expected ? SnapshotOk : SnapshotBadCrc;
+    }
+
+    SnapshotResult result = handleRecord(rec, apply);
+    if (result != SnapshotOk)
+      return result;
+  }
+
+  // Truncated: no end record
+  return SnapshotInvalid;
+}
+
+/**
+ * @brief Applies the collected settings, one commit per backing file.
+ */
+static SnapshotResult applySettings() {
+  // Timezone, solar location and flags share the key-value store
+  if (hasTz || hasSolar || hasFlags) {
+    kvBegin();
+
+    if ((hasTz && !clockSetTimezone(importTz)) ||
+        (hasSolar &&
+         !solarSetLocation(importSolar.latitude, importSolar.longitude)) ||
+        (hasFlags && !debugSaveEnabled(importFlags.serialDebug != 0))) {
+      kvAbort();
+      return SnapshotInvalid;
+    }
+
+    if (!kvCommit())
+      return SnapshotStorageError;
+  }
+
+  if (!deviceReplaceAll(importPins, importPinCount))
+    return SnapshotStorageError;
+
+  if (!cronImportCommit())
+    return SnapshotStorageError;
+
+  // Schedules depend on the timezone and the solar location
+  cronReschedule();
+
+  return SnapshotOk;
+}
+
+SnapshotResult snapshotImportCommit(SnapshotSummary &summary) {
+  if (!staging)
+    return SnapshotInvalid;
+
+  // Validation pass: nothing is changed unless the whole document is good
+  SnapshotResult result = walk(false);
+
+  // Apply pass: cron jobs go straight from the document to the new table
+  if (result == SnapshotOk)
+    result = cronImportBegin() ? walk(true) : SnapshotStorageError;
+
+  if (result == SnapshotOk)
+    result = applySettings();
+
+  // No-op once the new job table is in place
+  if (result != SnapshotOk)
+    cronImportAbort();
+
+  summary.pins = importPinCount;
+  summary.cronJobs = importJobCount;
+  summary.timezone = hasTz;
+  summary.solar = hasSolar;
+  summary.flags = hasFlags;
+
+  debugPrintln(F("[SNAPSHOT]"), "Import of " + String(stagedSize) +
+                                    " bytes: " +
+                                    snapshotResultToString(result));
+
+  snapshotImportAbort();
+  return result;
+}
+
+String snapshotResultToString(uint8_t result) {
+  switch (result) {
+  case SnapshotOk:
+    return "Ok";
+  case SnapshotTooLarge:
+    return "TooLarge";
+  case SnapshotInvalid:
+    return "Invalid";
+  case SnapshotBadCrc:
+    return "BadCrc";
+  case SnapshotStorageError:
+    return "StorageError";
+  default:
+    return "Unknown";
+  }
+}
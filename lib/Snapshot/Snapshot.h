@@ -0,0 +1,129 @@
+#pragma once
+
+#include <Arduino.h>
+
+/**
+ * @brief Snapshot format version. Bumped whenever the layout of a record
+ * changes (records embed GpioConfig and CronJob as stored on flash).
+ */
+#define SNAPSHOT_VERSION 1
+
+/**
+ * @brief Bytes buffered before the export hands data to its writer.
+ */
+#define SNAPSHOT_CHUNK_SIZE 256
+
+/**
+ * @brief Bytes read from the staged upload per storage access.
+ */
+#define SNAPSHOT_READ_SIZE 256
+
+/**
+ * @brief Record types.
+ *
+ * A snapshot is a header followed by records of
+ * `{uint8 type, uint8 reserved, uint16 length}` plus `length` bytes, and
+ * ends with a SnapEnd record holding the CRC32 of everything before its
+ * payload. Unknown record types are skipped on import.
+ *
+ * - SnapPin: GpioConfig of a pin that is not Disabled
+ * - SnapCronJob: uint16 slot index, 2 reserved bytes, CronJob
+ * - SnapFlags: uint8 serial debug, 3 reserved bytes
+ * - SnapTimezone: POSIX TZ string (not terminated)
+ * - SnapSolar: latitude, longitude (2 x float)
+ * - SnapEnd: uint32 CRC32
+ */
+enum SnapshotRecordType : uint8_t {
+  SnapPin = 1,
+  SnapCronJob,
+  SnapFlags,
+  SnapTimezone,
+  SnapSolar,
+  SnapEnd = 0xFF,
+};
+
+/**
+ * @brief Outcome of an import.
+ */
+enum SnapshotResult {
+  SnapshotOk = 0,
+  SnapshotTooLarge,
+  SnapshotInvalid,
+  SnapshotBadCrc,
+  SnapshotStorageError,
+};
+
+/**
+ * @brief What an import applied.
+ */
+struct SnapshotSummary {
+  uint8_t pins;      // pins configured (others are disabled)
+  uint16_t cronJobs; // jobs in the new table
+  bool timezone;
+  bool solar;
+  bool flags;
+};
+
+/**
+ * @brief Receives the exported snapshot piece by piece.
+ */
+typedef void (*SnapshotWriter)(const uint8_t *data, size_t length);
+
+/**
+ * @brief Streams the device configuration: pins, cron jobs, flags,
+ * timezone and solar location.
+ *
+ * Cron jobs are read from flash one at a time and the output goes through
+ * a SNAPSHOT_CHUNK_SIZE buffer, so the RAM used does not depend on the
+ * number of jobs. Authentication settings are never exported.
+ *
+ * @param write Called with every filled buffer and with the final one
+ * @return Total bytes written
+ */
+size_t snapshotExport(SnapshotWriter write);
+
+/**
+ * @brief Starts receiving a snapshot into a staging file.
+ *
+ * @return false if the staging file could not be created
+ */
+bool snapshotImportBegin();
+
+/**
+ * @brief Appends received bytes to the staging file.
+ *
+ * @return SnapshotTooLarge once the upload exceeds the largest valid
+ * snapshot, SnapshotStorageError if the write failed
+ */
+SnapshotResult snapshotImportWrite(const uint8_t *data, size_t length);
+
+/**
+ * @brief Validates the staged snapshot and applies it.
+ *
+ * The whole document (structure, CRC, every pin, job and setting) is
+ * checked before anything is changed. It is then applied with one storage
+ * commit per backing file: timezone, solar location and flags in one
+ * key-value batch, the pin table in one snapshot write and the cron table
+ * as one renamed file. Pins and cron jobs are
+ * replaced as a whole; timezone, solar location and flags are only
+ * changed when present.
+ *
+ * The staging file is removed in every case.
+ *
+ * @param summary What was applied (valid when SnapshotOk is returned)
+ */
+SnapshotResult snapshotImportCommit(SnapshotSummary &summary);
+
+/**
+ * @brief Discards a staged snapshot.
+ */
+void snapshotImportAbort();
+
+/**
+ * @brief Converts a SnapshotResult value to its string representation.
+ *
+ * @param result The SnapshotResult value
+ * @return "Ok", "TooLarge", "Invalid", "BadCrc", "StorageError" or
+ * "Unknown"
+ */
+String snapshotResultToString(uint8_t result);
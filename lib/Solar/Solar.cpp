@@ -0,0 +1,184 @@
+#include "Solar.h"
+#include <math.h>
+
+#include <BinaryStorage.h>
+#include <Debug.h>
+#include <KvStore.h>
+
+/* Location file of older firmware, migrated to KvKeySolarLocation */
+#define SOLAR_LEGACY_PATH "/solar.bin"
+#define SOLAR_FILE_MAGIC 0x534F4C52 // "SOLR"
+
+/* Sun altitude at rise/set: refraction plus the solar radius */
+#define SOLAR_HORIZON_DEG -0.833
+
+/* Days between 1970-01-01 and 2000-01-01 (J2000 epoch date) */
+#define SOLAR_J2000_DAY 10957
+
+/* Unix epoch of J2000.0 (2000-01-01 12:00 UTC) */
+#define SOLAR_J2000_EPOCH 946728000.0
+
+struct SolarLocation {
+  uint32_t magic; // SOLAR_FILE_MAGIC once a location is set
+  float latitude;
+  float longitude;
+};
+
+/* Stored value of KvKeySolarLocation */
+struct SolarCoords {
+  float latitude;
+  float longitude;
+};
+
+/**
+ * @brief Event times of one date.
+ */
+struct SolarDay {
+  int32_t day; // local date (days since 1970), -1 = empty
+  uint32_t sunrise;
+  uint32_t sunset;
+  bool hasSunrise;
+  bool hasSunset;
+};
+
+static SolarLocation location = {0, 0, 0};
+static uint32_t locationVersion = 0;
+
+/* Two entries: the date being scheduled and the next one */
+static SolarDay cache[2] = {{-1, 0, 0, false, false},
+                            {-1, 0, 0, false, false}};
+
+static double deg2rad(double d) { return d * M_PI / 180.0; }
+static double rad2deg(double r) { return r * 180.0 / M_PI; }
+
+/**
+ * @brief Computes sunrise and sunset of a date (sunrise equation).
+ *
+ * Double precision is used so that the day count since J2000 keeps
+ * sub-second resolution; it runs once per date.
+ */
+static void solarCompute(int32_t localDay, SolarDay &out) {
+  double lat = location.latitude;
+  double lon = location.longitude;
+
+  out.day = localDay;
+  out.hasSunrise = false;
+  out.hasSunset = false;
+
+  // Mean solar noon (days since J2000.0)
+  double n = (double)(localDay - SOLAR_J2000_DAY) + 0.0008;
+  double jStar = n - lon / 360.0;
+
+  // Solar mean anomaly, equation of the center, ecliptic longitude
+  double m = fmod(357.5291 + 0.98560028 * jStar, 360.0);
+  double mr = deg2rad(m);
+  double c = 1.9148 * sin(mr) + 0.02 * sin(2 * mr) + 0.0003 * sin(3 * mr);
+  double lambda = deg2rad(fmod(m + c + 180.0 + 102.9372, 360.0));
+
+  // Solar transit and declination
+  double transit = jStar + 0.0053 * sin(mr) - 0.0069 * sin(2 * lambda);
+  double sinDecl = sin(lambda) * sin(deg2rad(23.4397));
+  double cosDecl = cos(asin(sinDecl));
+
+  // Hour angle of the event
+  double cosOmega = (sin(deg2rad(SOLAR_HORIZON_DEG)) -
+                     sin(deg2rad(lat)) * sinDecl) /
+                    (cos(deg2rad(lat)) * cosDecl);
+
+  // Sun always below (> 1) or above (< -1) the horizon
+  if (cosOmega > 1.0 || cosOmega < -1.0)
+    return;
+
+  double omega = rad2deg(acos(cosOmega)) / 360.0;
+
+  out.sunrise = (uint32_t)(SOLAR_J2000_EPOCH + (transit - omega) * 86400.0);
+  out.sunset = (uint32_t)(SOLAR_J2000_EPOCH + (transit + omega) * 86400.0);
+  out.hasSunrise = true;
+  out.hasSunset = true;
+}
+
+/**
+ * @brief Drops all cached event times.
+ */
+static void solarClearCache() {
+  cache[0].day = -1;
+  cache[1].day = -1;
+}
+
+bool solarInit() {
+  SolarCoords coords;
+  SolarLocation legacy;
+
+  if (kvGet(KvKeySolarLocation, KvBlob, &coords, sizeof(coords))) {
+    location = {SOLAR_FILE_MAGIC, coords.latitude, coords.longitude};
+  } else if (storageRead(SOLAR_LEGACY_PATH, (uint8_t *)&legacy,
+                         sizeof(legacy)) &&
+             legacy.magic == SOLAR_FILE_MAGIC &&
+             solarSetLocation(legacy.latitude, legacy.longitude)) {
+    // Moved into the config store
+    storageRemove(SOLAR_LEGACY_PATH);
+  } else {
+    debugPrintln(F("[SOLAR]"), F("No location configured"));
+    return false;
+  }
+
+  solarClearCache();
+
+  debugPrintln(F("[SOLAR]"), "Location " + String(location.latitude, 4) +
+                                 ", " + String(location.longitude, 4));
+  return true;
+}
+
+bool solarSetLocation(float latitude, float longitude) {
+  if (!(latitude >= -90.0f && latitude <= 90.0f) ||
+      !(longitude >= -180.0f && longitude <= 180.0f))
+    return false;
+
+  SolarCoords coords = {latitude, longitude};
+  if (!kvSet(KvKeySolarLocation, KvBlob, &coords, sizeof(coords)))
+    return false;
+
+  location = {SOLAR_FILE_MAGIC, latitude, longitude};
+  locationVersion++;
+  solarClearCache();
+  return true;
+}
+
+bool solarHasLocation() { return location.magic == SOLAR_FILE_MAGIC; }
+
+uint32_t solarLocationVersion() { return locationVersion; }
+
+float solarLatitude() { return location.latitude; }
+
+float solarLongitude() { return location.longitude; }
+
+bool solarEventTime(int32_t localDay, uint8_t event, uint32_t &epoch) {
+  if (!solarHasLocation() || localDay < 0)
+    return false;
+
+  SolarDay &entry = cache[localDay & 1];
+  if (entry.day != localDay)
+    solarCompute(localDay, entry);
+
+  switch (event) {
+  case SolarSunrise:
+    epoch = entry.sunrise;
+    return entry.hasSunrise;
+  case SolarSunset:
+    epoch = entry.sunset;
+    return entry.hasSunset;
+  default:
+    return false;
+  }
+}
+
+String solarEventToString(uint8_t event) {
+  switch (event) {
+  case SolarSunrise:
+    return "sunrise";
+  case SolarSunset:
+    return "sunset";
+  default:
+    return "none";
+  }
+}
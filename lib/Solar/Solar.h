@@ -0,0 +1,77 @@
+#pragma once
+
+#include <Arduino.h>
+
+/**
+ * @brief Solar events a cron job can be anchored to.
+ *
+ * - SolarNone: Not a solar schedule
+ * - SolarSunrise: Upper limb of the sun rises above the horizon
+ * - SolarSunset: Upper limb of the sun sets below the horizon
+ */
+enum SolarEvent { SolarNone = 0, SolarSunrise, SolarSunset };
+
+/**
+ * @brief Initializes the solar calculator.
+ *
+ * Loads the configured location from storage. Until a location is set,
+ * no solar event time is available.
+ *
+ * @return true if a stored location was loaded
+ */
+bool solarInit();
+
+/**
+ * @brief Sets and persists the observer location.
+ *
+ * Cached event times are discarded.
+ *
+ * @param latitude Degrees, north positive (-90 to 90)
+ * @param longitude Degrees, east positive (-180 to 180)
+ * @return false if the coordinates are out of range or could not be stored
+ */
+bool solarSetLocation(float latitude, float longitude);
+
+/**
+ * @brief Whether a location has been configured.
+ */
+bool solarHasLocation();
+
+/**
+ * @brief Number of location changes since boot.
+ *
+ * Lets the scheduler notice a new location, whoever set it.
+ */
+uint32_t solarLocationVersion();
+
+/**
+ * @brief Configured latitude in degrees.
+ */
+float solarLatitude();
+
+/**
+ * @brief Configured longitude in degrees.
+ */
+float solarLongitude();
+
+/**
+ * @brief Returns the time of a solar event on a given local date.
+ *
+ * Sunrise and sunset of a date are computed together, once, and cached;
+ * repeated queries for the same date do no astronomy math.
+ *
+ * @param localDay Local calendar date as days since 1970-01-01
+ * @param event SolarSunrise or SolarSunset
+ * @param epoch UTC epoch of the event
+ * @return false if no location is set or the event does not happen on
+ * that date (polar day or night)
+ */
+bool solarEventTime(int32_t localDay, uint8_t event, uint32_t &epoch);
+
+/**
+ * @brief Converts a SolarEvent value to its string representation.
+ *
+ * @param event The SolarEvent value
+ * @return "sunrise", "sunset" or "none"
+ */
+String solarEventToString(uint8_t event);
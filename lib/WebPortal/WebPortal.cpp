@@ -1,5 +1,6 @@
 #include "WebPortal.h"
 #include "EepromConfig.h"
+#include <BinaryStorage.h>
 
 #include <Debug.h>
 
@@ -100,6 +101,7 @@ bool portalStart() {
                 "</body></html>");
 
     delay(1500);
+    storageFlush();
     ESP.restart();
   });
 
@@ -1,15 +1,106 @@
 #include "WifiManager.h"
 #include <ESP8266WiFi.h>
+#include <KvStore.h>
+#include <coredecls.h>
 
 #include <Debug.h>
 
+/**
+ * @brief Last good link, stored under KvKeyWifiLink.
+ */
+struct WifiLinkCache {
+  uint32_t ssidHash; // CRC32 of the SSID the entry belongs to
+  uint8_t bssid[6];
+  uint8_t channel;
+  uint8_t reserved;
+  uint32_t ip; // last DHCP lease
+  uint32_t mask;
+  uint32_t gateway;
+  uint32_t dns;
+};
+
+/**
+ * @brief Network added through the API, stored under
+ * KvKeyWifiNetwork + slot.
+ */
+struct WifiNetworkRecord {
+  char ssid[WIFI_SSID_MAX + 1];
+  char pass[WIFI_PASS_MAX + 1];
+};
+
+/**
+ * @brief Join counters of one network, stored (all networks in one value)
+ * under KvKeyWifiNetStats.
+ */
+struct WifiNetStat {
+  uint32_t ssidHash;
+  uint8_t successes;
+  uint8_t failStreak;
+  uint8_t reserved[2];
+};
+
+/**
+ * @brief A stored network found by the scan.
+ */
+struct WifiCandidate {
+  uint8_t index; // into networks[]
+  int16_t score;
+  uint8_t bssid[6];
+  uint8_t channel;
+};
+
+/**
+ * @brief Step of a connect attempt.
+ *
+ * - PhaseCached: Joining the cached access point
+ * - PhaseScan: Asynchronous scan running
+ * - PhaseJoin: Joining a ranked candidate on its BSSID and channel
+ * - PhaseDirect: Joining the primary network with the SDK's own scan
+ */
+enum WifiPhase { PhaseCached = 0, PhaseScan, PhaseJoin, PhaseDirect };
+
+static WifiConnectInfo connectInfo;
+
+/* Stored networks, index 0 = primary (slot -1: EEPROM) */
+static WifiNetwork networks[WIFI_MAX_NETWORKS];
+static char passwords[WIFI_MAX_NETWORKS][WIFI_PASS_MAX + 1];
+static uint32_t hashes[WIFI_MAX_NETWORKS];
+static int8_t slots[WIFI_MAX_NETWORKS];
+static uint8_t networkCount = 0;
+static bool statsDirty = false;
+
+static uint8_t state = WifiIdle;
+static uint8_t phase = PhaseCached;
+static unsigned long attemptStart = 0; // start of the current attempt
+static unsigned long phaseStart = 0;   // start of the current phase
+static uint32_t backoffMs = 0;
+static uint8_t joining = 0; // network being joined
+static bool everConnected = false;
+static bool firstAttempt = true;
+static bool skipCache = false; // next attempt scans (wifiReconnect)
+
+/* Ranked candidates of the last scan */
+static WifiCandidate candidates[WIFI_MAX_NETWORKS];
+static uint8_t candidateCount = 0;
+static uint8_t candidateNext = 0;
+static bool directPending = false; // primary still to try without BSSID
+
+/* Link cache read at the start of each attempt */
+static WifiLinkCache cache;
+static bool cached = false;
+
 /**
  * Initializes the WiFi module in Station (STA) mode
  * and forces a clean disconnection from any previous network.
  */
 bool wifiInit() {
+  // Credentials live in EEPROM: keep the SDK from rewriting its flash copy
+  WiFi.persistent(false);
   WiFi.mode(WIFI_STA);
 
+  // Reconnects are driven by wifiLoop()
+  WiFi.setAutoReconnect(false);
+
   // Force disconnection from any previous network
   WiFi.disconnect();
   delay(100);
@@ -19,35 +110,482 @@ bool wifiInit() {
 }
 
 /**
- * Attempts to connect to a WiFi network and waits
- * until the connection is established or a timeout occurs.
+ * @brief Whether the last reset kept the network state fresh (software
+ * restart, watchdog or exception, as opposed to power-on or deep sleep).
+ */
+static bool softReset() {
+  switch (ESP.getResetInfoPtr()->reason) {
+  case REASON_WDT_RST:
+  case REASON_EXCEPTION_RST:
+  case REASON_SOFT_WDT_RST:
+  case REASON_SOFT_RESTART:
+    return true;
+  default:
+    return false;
+  }
+}
+
+static void applyIp(uint32_t ip, uint32_t mask, uint32_t gateway,
+                    uint32_t dns) {
+  WiFi.config(IPAddress(ip), IPAddress(gateway), IPAddress(mask),
+              IPAddress(dns));
+}
+
+static int findNetwork(const char *ssid) {
+  for (uint8_t i = 0; i < networkCount; i++) {
+    if (strcmp(networks[i].ssid, ssid) == 0)
+      return i;
+  }
+  return -1;
+}
+
+/**
+ * @brief Sets network `index` (counters cleared).
+ */
+static void setNetwork(uint8_t index, const char *ssid, const char *pass,
+                       int8_t slot) {
+  WifiNetwork &net = networks[index];
+  memset(&net, 0, sizeof(net));
+  strncpy(net.ssid, ssid, WIFI_SSID_MAX);
+  strncpy(passwords[index], pass, WIFI_PASS_MAX);
+  passwords[index][WIFI_PASS_MAX] = '\0';
+
+  hashes[index] = crc32(net.ssid, strlen(net.ssid));
+  slots[index] = slot;
+}
+
+/**
+ * @brief Loads the networks added through the API and the counters.
+ */
+static void loadNetworks() {
+  networkCount = 1;
+
+  for (int8_t slot = 0; slot < WIFI_MAX_NETWORKS - 1; slot++) {
+    WifiNetworkRecord rec;
+    if (!kvGet(KvKeyWifiNetwork + slot, KvBlob, &rec, sizeof(rec)))
+      continue;
+
+    rec.ssid[WIFI_SSID_MAX] = '\0';
+    rec.pass[WIFI_PASS_MAX] = '\0';
+    if (rec.ssid[0] == '\0' || findNetwork(rec.ssid) >= 0)
+      continue;
+
+    setNetwork(networkCount++, rec.ssid, rec.pass, slot);
+  }
+
+  WifiNetStat stored[WIFI_MAX_NETWORKS];
+  if (!kvGet(KvKeyWifiNetStats, KvBlob, stored, sizeof(stored)))
+    return;
+
+  for (uint8_t i = 0; i < networkCount; i++) {
+    for (uint8_t j = 0; j < WIFI_MAX_NETWORKS; j++) {
+      if (stored[j].ssidHash == hashes[i]) {
+        networks[i].successes = stored[j].successes;
+        networks[i].failStreak = stored[j].failStreak;
+        break;
+      }
+    }
+  }
+}
+
+/**
+ * @brief Stores the join counters if they changed (at most once per
+ * attempt; the fail streak saturates, so an outage stops writing).
+ */
+static void saveStats() {
+  if (!statsDirty)
+    return;
+
+  WifiNetStat stats[WIFI_MAX_NETWORKS] = {};
+  for (uint8_t i = 0; i < networkCount; i++) {
+    stats[i].ssidHash = hashes[i];
+    stats[i].successes = networks[i].successes;
+    stats[i].failStreak = networks[i].failStreak;
+  }
+
+  if (kvSet(KvKeyWifiNetStats, KvBlob, stats, sizeof(stats)))
+    statsDirty = false;
+}
+
+static void recordJoin(uint8_t index, bool ok) {
+  WifiNetwork &net = networks[index];
+
+  if (ok) {
+    if (net.successes < UINT8_MAX) {
+      net.successes++;
+      statsDirty = true;
+    }
+    if (net.failStreak != 0) {
+      net.failStreak = 0;
+      statsDirty = true;
+    }
+  } else if (net.failStreak < WIFI_FAIL_STREAK_MAX) {
+    net.failStreak++;
+    statsDirty = true;
+  }
+}
+
+/**
+ * @brief Stores the current link if it differs from the cached one.
+ */
+static void saveLinkCache() {
+  WifiLinkCache link = {};
+  link.ssidHash = hashes[joining];
+  link.channel = WiFi.channel();
+
+  const uint8_t *bssid = WiFi.BSSID();
+  if (bssid)
+    memcpy(link.bssid, bssid, sizeof(link.bssid));
+
+  if (connectInfo.ipMode == WifiIpDhcp) {
+    link.ip = WiFi.localIP();
+    link.mask = WiFi.subnetMask();
+    link.gateway = WiFi.gatewayIP();
+    link.dns = WiFi.dnsIP();
+  } else if (cached && cache.ssidHash == link.ssidHash) {
+    // No new lease: keep the last one
+    link.ip = cache.ip;
+    link.mask = cache.mask;
+    link.gateway = cache.gateway;
+    link.dns = cache.dns;
+  }
+
+  if (cached && memcmp(&cache, &link, sizeof(link)) == 0)
+    return;
+
+  if (kvSet(KvKeyWifiLink, KvBlob, &link, sizeof(link))) {
+    cache = link;
+    cached = true;
+    debugPrintln(F("[WiFi]"), "Cached access point " + WiFi.BSSIDstr() +
+                                  ", channel " + String(link.channel));
+  }
+}
+
+/**
+ * @brief Joins a stored network, on a given access point when `bssid` is
+ * set. The static IP applies to the primary network only.
+ */
+static void joinNetwork(uint8_t index, uint8_t channel, const uint8_t *bssid,
+                        bool reuseLease) {
+  joining = index;
+  phaseStart = millis();
+  connectInfo.ipMode = WifiIpDhcp;
+
+  WifiStaticIp staticIp;
+  if (index == 0 && wifiGetStaticIp(staticIp)) {
+    applyIp(staticIp.ip, staticIp.mask, staticIp.gateway, staticIp.dns);
+    connectInfo.ipMode = WifiIpStatic;
+  } else if (reuseLease) {
+    applyIp(cache.ip, cache.mask, cache.gateway, cache.dns);
+    connectInfo.ipMode = WifiIpLease;
+  } else {
+    applyIp(0, 0, 0, 0);
+  }
+
+  const char *ssid = networks[index].ssid;
+
+  if (bssid) {
+    debugPrintf(F("[WiFi]"), "Connecting to %s on channel %u", ssid,
+                (unsigned)channel);
+    WiFi.begin(ssid, passwords[index], channel, bssid);
+  } else {
+    debugPrintf(F("[WiFi]"), "Connecting to WiFi network: %s", ssid);
+    WiFi.begin(ssid, passwords[index]);
+  }
+}
+
+/**
+ * @brief Starts an asynchronous scan to rank the stored networks.
+ */
+static void startScan() {
+  WiFi.disconnect();
+  WiFi.scanNetworks(true);
+
+  phase = PhaseScan;
+  phaseStart = millis();
+}
+
+/**
+ * @brief Keeps the strongest access point of every stored network found
+ * and sorts them by score.
  */
-bool wifiConnect(const String &ssid, const String &pass) {
+static void rankCandidates(int found) {
+  candidateCount = 0;
+  candidateNext = 0;
+
+  for (uint8_t i = 0; i < networkCount; i++)
+    networks[i].lastRssi = 0;
+
+  for (int r = 0; r < found; r++) {
+    int index = findNetwork(WiFi.SSID(r).c_str());
+    if (index < 0)
+      continue;
+
+    int32_t rssi = WiFi.RSSI(r);
+    WifiNetwork &net = networks[index];
+
+    // Several access points per SSID: keep the strongest
+    if (net.lastRssi != 0 && rssi <= net.lastRssi)
+      continue;
+
+    int16_t bonus = net.successes < WIFI_SUCCESS_BONUS_MAX
+                        ? net.successes
+                        : WIFI_SUCCESS_BONUS_MAX;
+
+    uint8_t c = 0;
+    while (c < candidateCount && candidates[c].index != index)
+      c++;
+    if (c == candidateCount)
+      candidateCount++;
+
+    net.lastRssi = rssi < -127 ? -127 : rssi;
+    candidates[c].index = index;
+    candidates[c].score =
+        rssi + bonus - WIFI_FAIL_PENALTY_DB * (int16_t)net.failStreak;
+    candidates[c].channel = WiFi.channel(r);
+
+    const uint8_t *bssid = WiFi.BSSID(r);
+    if (bssid)
+      memcpy(candidates[c].bssid, bssid, sizeof(candidates[c].bssid));
+  }
+
+  // Insertion sort, best score first
+  for (uint8_t i = 1; i < candidateCount; i++) {
+    WifiCandidate item = candidates[i];
+    uint8_t j = i;
+    while (j > 0 && candidates[j - 1].score < item.score) {
+      candidates[j] = candidates[j - 1];
+      j--;
+    }
+    candidates[j] = item;
+  }
+
+  // A hidden primary network does not show up: try it without a BSSID
+  directPending = networks[0].lastRssi == 0;
+
+  connectInfo.candidates = candidateCount;
+}
+
+/**
+ * @brief Schedules the next attempt with exponential backoff.
+ */
+static void attemptFailed() {
+  WiFi.disconnect();
+  saveStats();
+
+  if (connectInfo.failures < UINT16_MAX)
+    connectInfo.failures++;
+
+  uint8_t shift = connectInfo.failures > 16 ? 16 : connectInfo.failures - 1;
+  uint32_t delayMs = (uint32_t)WIFI_BACKOFF_MIN_MS << shift;
+  backoffMs = delayMs > WIFI_BACKOFF_MAX_MS ? WIFI_BACKOFF_MAX_MS : delayMs;
+
+  state = WifiBackoff;
+  phaseStart = millis();
+
+  debugPrintf(F("[WiFi]"), "Connection attempt %u failed, retry in %lu ms",
+              (unsigned)connectInfo.failures, (unsigned long)backoffMs);
+}
+
+/**
+ * @brief Joins the next ranked candidate, then the primary network
+ * without a BSSID if the scan missed it.
+ */
+static void joinNextCandidate() {
+  if (candidateNext < candidateCount) {
+    const WifiCandidate &c = candidates[candidateNext++];
+    phase = PhaseJoin;
+    joinNetwork(c.index, c.channel, c.bssid, false);
+    return;
+  }
+
+  if (directPending) {
+    directPending = false;
+    phase = PhaseDirect;
+    joinNetwork(0, 0, nullptr, false);
+    return;
+  }
+
+  attemptFailed();
+}
+
+/**
+ * @brief Begins a connect attempt: cached access point first when known,
+ * otherwise a scan.
+ */
+static void startAttempt() {
+  attemptStart = millis();
+  state = WifiConnecting;
+
+  connectInfo.path = WifiPathNone;
+  connectInfo.ipMode = WifiIpDhcp;
+  connectInfo.fastFailed = false;
+  connectInfo.scanMs = 0;
+  connectInfo.candidates = 0;
+
+  cached = kvGet(KvKeyWifiLink, KvBlob, &cache, sizeof(cache)) &&
+           cache.channel >= 1 && cache.channel <= 14;
+
+  int index = -1;
+  for (uint8_t i = 0; cached && i < networkCount; i++) {
+    if (hashes[i] == cache.ssidHash)
+      index = i;
+  }
+
+  // The lease is only trusted right after a soft reboot
+  bool reuseLease = WIFI_REUSE_LEASE && firstAttempt && index >= 0 &&
+                    cache.ip != 0 && softReset();
+  firstAttempt = false;
+
+  if (index >= 0 && !skipCache) {
+    phase = PhaseCached;
+    joinNetwork(index, cache.channel, cache.bssid, reuseLease);
+  } else {
+    startScan();
+  }
+  skipCache = false;
+}
+
+static void attemptConnected() {
+  state = WifiConnected;
+  everConnected = true;
+
+  connectInfo.path = phase == PhaseCached ? WifiPathFast : WifiPathScan;
+  connectInfo.connectMs = millis() - attemptStart;
+  connectInfo.connectAt = millis();
+  connectInfo.failures = 0;
+
+  debugPrintln(F("[WiFi]"),
+               "WiFi connected to " + String(networks[joining].ssid) + " (" +
+                   wifiConnectPathToString(connectInfo.path) + ", " +
+                   wifiIpModeToString(connectInfo.ipMode) + ") in " +
+                   String(connectInfo.connectMs) +
+                   " ms. IP address: " + WiFi.localIP().toString());
+
+  recordJoin(joining, true);
+  saveStats();
+  saveLinkCache();
+}
+
+bool wifiStart(const String &ssid, const String &pass) {
   if (ssid.length() == 0)
     return false;
 
-  debugPrintln(F("[WiFi]"), "Connecting to WiFi network: " + ssid);
+  setNetwork(0, ssid.c_str(), pass.c_str(), -1);
+  loadNetworks();
+
+  debugPrintln(F("[WiFi]"), String(networkCount) + " stored network(s)");
+
+  connectInfo = {};
+  startAttempt();
+  return true;
+}
+
+void wifiStop() {
+  if (state == WifiIdle)
+    return;
+
+  state = WifiIdle;
+  WiFi.scanDelete();
+  WiFi.disconnect();
+  debugPrintln(F("[WiFi]"), F("WiFi stopped."));
+}
+
+bool wifiReconnect() {
+  if (state == WifiIdle)
+    return false;
+
+  debugPrintln(F("[WiFi]"), F("Reconnecting with a scan."));
 
-  WiFi.begin(ssid.c_str(), pass.c_str());
+  skipCache = true;
+  startAttempt();
+  return true;
+}
 
-  unsigned long start = millis();
-  const unsigned long timeout = 15000; // 15 seconds timeout
+/**
+ * @brief Advances a join (cached, ranked or direct).
+ */
+static void joinLoop() {
+  wl_status_t status = WiFi.status();
 
-  // Wait until connected or timeout expires
-  while (WiFi.status() != WL_CONNECTED && millis() - start < timeout) {
-    delay(250);
-    debugPrint(F("."));
+  if (status == WL_CONNECTED) {
+    attemptConnected();
+    return;
   }
-  debugPrintln(F("[WiFi]"), String(""));
 
-  if (WiFi.status() == WL_CONNECTED) {
-    debugPrintln(F("[WiFi]"), "WiFi connected successfully. IP address: " +
-                                  WiFi.localIP().toString());
-    return true;
+  unsigned long timeout =
+      phase == PhaseDirect ? WIFI_SCAN_TIMEOUT_MS : WIFI_FAST_TIMEOUT_MS;
+
+  if (status != WL_WRONG_PASSWORD && millis() - phaseStart < timeout)
+    return;
+
+  recordJoin(joining, false);
+
+  if (phase == PhaseCached) {
+    debugPrintln(F("[WiFi]"), F("Cached access point not reached, "
+                                "scanning."));
+    connectInfo.fastFailed = true;
+    startScan();
+    return;
   }
 
-  debugPrintln(F("[WiFi]"), F("WiFi connection failed."));
-  return false;
+  WiFi.disconnect();
+  joinNextCandidate();
+}
+
+/**
+ * @brief Ranks the stored networks once the scan is complete.
+ */
+static void scanLoop() {
+  int8_t found = WiFi.scanComplete();
+
+  if (found == WIFI_SCAN_RUNNING &&
+      millis() - phaseStart < WIFI_SCAN_TIMEOUT_MS)
+    return;
+
+  connectInfo.scanMs = millis() - phaseStart;
+  rankCandidates(found > 0 ? found : 0);
+  WiFi.scanDelete();
+
+  debugPrintf(F("[WiFi]"), "Scan done in %lu ms: %u stored network(s)",
+              (unsigned long)connectInfo.scanMs, (unsigned)candidateCount);
+
+  joinNextCandidate();
+}
+
+void wifiLoop() {
+  switch (state) {
+  case WifiConnecting:
+    if (phase == PhaseScan)
+      scanLoop();
+    else
+      joinLoop();
+    break;
+
+  case WifiConnected:
+    if (WiFi.status() != WL_CONNECTED) {
+      connectInfo.disconnects++;
+      debugPrintln(F("[WiFi]"), F("WiFi link lost, reconnecting."));
+      startAttempt();
+    }
+    break;
+
+  case WifiBackoff:
+    if (millis() - phaseStart >= backoffMs)
+      startAttempt();
+    break;
+
+  default:
+    break;
+  }
+}
+
+uint8_t wifiState() { return state; }
+
+bool wifiPortalWanted() {
+  return WIFI_PORTAL_AFTER_FAILURES > 0 && !everConnected &&
+         state != WifiIdle &&
+         connectInfo.failures >= WIFI_PORTAL_AFTER_FAILURES;
 }
 
 /**
@@ -64,3 +602,131 @@ String wifiGetIP() {
 
   return WiFi.localIP().toString();
 }
+
+const WifiConnectInfo &wifiConnectInfo() { return connectInfo; }
+
+size_t wifiNetworkCount() { return networkCount; }
+
+const WifiNetwork *wifiNetwork(size_t index) {
+  if (index >= networkCount)
+    return nullptr;
+
+  return &networks[index];
+}
+
+bool wifiAddNetwork(const String &ssid, const String &pass) {
+  if (ssid.length() == 0 || ssid.length() > WIFI_SSID_MAX ||
+      pass.length() > WIFI_PASS_MAX || networkCount == 0)
+    return false;
+
+  int index = findNetwork(ssid.c_str());
+  if (index == 0)
+    return false;
+
+  int8_t slot = 0;
+  if (index > 0) {
+    slot = slots[index];
+  } else {
+    if (networkCount >= WIFI_MAX_NETWORKS)
+      return false;
+
+    // First free key-value slot
+    for (uint8_t i = 1; i < networkCount; i++) {
+      if (slots[i] == slot) {
+        slot++;
+        i = 0;
+      }
+    }
+    index = networkCount;
+  }
+
+  WifiNetworkRecord rec = {};
+  strncpy(rec.ssid, ssid.c_str(), WIFI_SSID_MAX);
+  strncpy(rec.pass, pass.c_str(), WIFI_PASS_MAX);
+
+  if (!kvSet(KvKeyWifiNetwork + slot, KvBlob, &rec, sizeof(rec)))
+    return false;
+
+  setNetwork(index, rec.ssid, rec.pass, slot);
+  if (index == networkCount)
+    networkCount++;
+
+  statsDirty = true;
+  saveStats();
+
+  debugPrintln(F("[WiFi]"), "Stored network " + ssid);
+  return true;
+}
+
+bool wifiRemoveNetwork(const String &ssid) {
+  int index = findNetwork(ssid.c_str());
+  if (index <= 0)
+    return false;
+
+  if (!kvRemove(KvKeyWifiNetwork + slots[index]))
+    return false;
+
+  for (uint8_t i = index; i + 1 < networkCount; i++) {
+    networks[i] = networks[i + 1];
+    memcpy(passwords[i], passwords[i + 1], sizeof(passwords[i]));
+    hashes[i] = hashes[i + 1];
+    slots[i] = slots[i + 1];
+  }
+  networkCount--;
+
+  statsDirty = true;
+  saveStats();
+
+  // Ranked candidates refer to the old indexes
+  if (state == WifiConnecting)
+    startAttempt();
+
+  debugPrintln(F("[WiFi]"), "Removed network " + ssid);
+  return true;
+}
+
+bool wifiSetStaticIp(const WifiStaticIp *cfg) {
+  if (!cfg)
+    return kvRemove(KvKeyWifiStaticIp);
+
+  return kvSet(KvKeyWifiStaticIp, KvBlob, cfg, sizeof(WifiStaticIp));
+}
+
+bool wifiGetStaticIp(WifiStaticIp &out) {
+  return kvGet(KvKeyWifiStaticIp, KvBlob, &out, sizeof(out)) && out.ip != 0;
+}
+
+String wifiConnectPathToString(uint8_t path) {
+  switch (path) {
+  case WifiPathFast:
+    return "Fast";
+  case WifiPathScan:
+    return "Scan";
+  default:
+    return "None";
+  }
+}
+
+String wifiIpModeToString(uint8_t mode) {
+  switch (mode) {
+  case WifiIpLease:
+    return "Lease";
+  case WifiIpStatic:
+    return "Static";
+  default:
+    return "Dhcp";
+  }
+}
+
+String wifiStateToString(uint8_t value) {
+  switch (value) {
+  case WifiConnecting:
+    return "Connecting";
+  case WifiConnected:
+    return "Connected";
+  case WifiBackoff:
+    return "Backoff";
+  default:
+    return "Idle";
+  }
+}
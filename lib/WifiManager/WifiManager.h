@@ -2,27 +2,195 @@
 
 #include <Arduino.h>
 
+/**
+ * @brief Time (in milliseconds) allowed for a direct connect to the cached
+ * access point before falling back to a full scan.
+ */
+#define WIFI_FAST_TIMEOUT_MS 5000
+
+/**
+ * @brief Time (in milliseconds) allowed for a connect with a full scan.
+ */
+#define WIFI_SCAN_TIMEOUT_MS 15000
+
+/**
+ * @brief Stored networks: the primary one (EEPROM, set by the captive
+ * portal) plus up to WIFI_MAX_NETWORKS - 1 added through the API.
+ */
+#define WIFI_MAX_NETWORKS 6
+
+#define WIFI_SSID_MAX 32
+#define WIFI_PASS_MAX 64
+
+/**
+ * @brief Ranking of the networks found by a scan: RSSI (dBm), plus
+ * 1 dB per past successful join (up to WIFI_SUCCESS_BONUS_MAX), minus
+ * WIFI_FAIL_PENALTY_DB per consecutive failed join (up to
+ * WIFI_FAIL_STREAK_MAX).
+ */
+#define WIFI_SUCCESS_BONUS_MAX 10
+#define WIFI_FAIL_PENALTY_DB 10
+#define WIFI_FAIL_STREAK_MAX 3
+
+/**
+ * @brief Delay before the first retry after a failed attempt, in
+ * milliseconds. It doubles with every consecutive failure.
+ */
+#define WIFI_BACKOFF_MIN_MS 1000
+
+/**
+ * @brief Upper bound of the retry delay, in milliseconds.
+ */
+#define WIFI_BACKOFF_MAX_MS 60000
+
+/**
+ * @brief Consecutive failed attempts, before the first connection since
+ * boot, after which the captive portal is wanted. 0 (the default) never
+ * enters the portal: the device keeps retrying with backoff and local
+ * features keep running.
+ */
+#ifndef WIFI_PORTAL_AFTER_FAILURES
+#define WIFI_PORTAL_AFTER_FAILURES 0
+#endif
+
+/**
+ * @brief Set to 0 to never reuse the cached DHCP lease.
+ *
+ * The lease is only reused after a software reset (restart, watchdog,
+ * exception), when it was in use seconds earlier. The address then stays
+ * static until the next reboot; every power-on goes through DHCP.
+ */
+#ifndef WIFI_REUSE_LEASE
+#define WIFI_REUSE_LEASE 1
+#endif
+
+/**
+ * @brief How the last connection was established.
+ *
+ * - WifiPathNone: Not connected
+ * - WifiPathFast: Directly to the cached BSSID and channel (no scan)
+ * - WifiPathScan: After a scan ranking the stored networks
+ */
+enum WifiConnectPath { WifiPathNone = 0, WifiPathFast, WifiPathScan };
+
+/**
+ * @brief Where the IP configuration came from.
+ *
+ * - WifiIpDhcp: DHCP
+ * - WifiIpLease: Cached DHCP lease reused without DHCP (soft reboot)
+ * - WifiIpStatic: Configured static address
+ */
+enum WifiIpMode { WifiIpDhcp = 0, WifiIpLease, WifiIpStatic };
+
+/**
+ * @brief Connection state machine, driven by wifiLoop().
+ *
+ * - WifiIdle: No credentials, or stopped
+ * - WifiConnecting: Attempt in progress (cached access point, then scan
+ *   and ranked networks)
+ * - WifiConnected: Link up
+ * - WifiBackoff: Waiting before the next attempt
+ */
+enum WifiState { WifiIdle = 0, WifiConnecting, WifiConnected, WifiBackoff };
+
+/**
+ * @brief Static IP configuration (addresses in IPAddress uint32_t form).
+ */
+struct WifiStaticIp {
+  uint32_t ip;
+  uint32_t mask;
+  uint32_t gateway;
+  uint32_t dns;
+};
+
+/**
+ * @brief Outcome of the last connection and reconnect counters.
+ */
+struct WifiConnectInfo {
+  uint8_t path;         // WifiConnectPath
+  uint8_t ipMode;       // WifiIpMode
+  bool fastFailed;      // the cached access point was tried and not reached
+  uint32_t connectMs;   // duration of the attempt that connected
+  uint32_t scanMs;      // duration of its scan, 0 if none
+  uint8_t candidates;   // stored networks seen by the scan
+  uint32_t connectAt;   // millis() when the link came up
+  uint16_t failures;    // consecutive failed attempts
+  uint32_t disconnects; // links lost since boot
+};
+
+/**
+ * @brief A stored network (the password is not exposed).
+ */
+struct WifiNetwork {
+  char ssid[WIFI_SSID_MAX + 1];
+  uint8_t successes;  // successful joins, saturating at 255
+  uint8_t failStreak; // consecutive failed joins, up to WIFI_FAIL_STREAK_MAX
+  int8_t lastRssi;    // RSSI in the last scan, 0 if not seen
+};
+
 /**
  * @brief Initializes the WiFi module in Station (STA) mode.
  *
  * This function configures the device to operate as a WiFi client
- * and resets any previous network connection state.
+ * and resets any previous network connection state. The SDK's own copy of
+ * the credentials is no longer written to flash on every connect.
  *
  * @return true if the initialization completed successfully
  */
 bool wifiInit();
 
 /**
- * @brief Connects to a WiFi network using the provided credentials.
+ * @brief Sets the primary network, loads the other stored networks and
+ * starts connecting; returns immediately.
  *
- * The function attempts to establish a connection and blocks
- * until the connection is successful or a timeout is reached.
+ * The connection is driven by wifiLoop(). Each attempt first joins the
+ * cached access point (BSSID and channel of the last link) without a
+ * scan. If that fails, one scan ranks the stored networks in range (see
+ * WIFI_FAIL_PENALTY_DB) and they are joined in order, each on the BSSID
+ * and channel found by the scan; the primary network is finally tried
+ * without a BSSID if the scan did not see it (hidden SSID). A configured
+ * static IP applies to the primary network; on the first attempt after a
+ * soft reboot, the cached DHCP lease is reused. Failed attempts are
+ * retried after WIFI_BACKOFF_MIN_MS, doubling up to WIFI_BACKOFF_MAX_MS;
+ * a lost link is reconnected at once.
  *
- * @param ssid WiFi network name
- * @param pass WiFi network password
- * @return true if the connection is established successfully, false otherwise
+ * @param ssid Primary network name
+ * @param pass Primary network password
+ * @return false if the SSID is empty
+ */
+bool wifiStart(const String &ssid, const String &pass);
+
+/**
+ * @brief Stops the state machine and disconnects the station.
  */
-bool wifiConnect(const String &ssid, const String &pass);
+void wifiStop();
+
+/**
+ * @brief Drops the link and reconnects with a scan, ignoring the cached
+ * access point, so that the best ranked one is joined.
+ *
+ * @return false if the state machine is stopped
+ */
+bool wifiReconnect();
+
+/**
+ * @brief Advances the connection state machine.
+ *
+ * This function must be called repeatedly inside the main loop(); it never
+ * blocks.
+ */
+void wifiLoop();
+
+/**
+ * @brief Current WifiState.
+ */
+uint8_t wifiState();
+
+/**
+ * @brief Whether the captive portal should be started, according to
+ * WIFI_PORTAL_AFTER_FAILURES.
+ */
+bool wifiPortalWanted();
 
 /**
  * @brief Checks whether the device is currently connected to a WiFi network.
@@ -39,3 +207,76 @@ bool wifiIsConnected();
  * @return Local IP address in string format, or empty string if not connected
  */
 String wifiGetIP();
+
+/**
+ * @brief Outcome of the last connection and reconnect counters.
+ */
+const WifiConnectInfo &wifiConnectInfo();
+
+/**
+ * @brief Number of stored networks (the primary one included).
+ */
+size_t wifiNetworkCount();
+
+/**
+ * @brief Returns a stored network.
+ *
+ * @param index 0 = primary
+ * @return nullptr if index >= wifiNetworkCount()
+ */
+const WifiNetwork *wifiNetwork(size_t index);
+
+/**
+ * @brief Adds a network to the list, or changes the password of a stored
+ * one. Used from the next attempt.
+ *
+ * @return false if the SSID is the primary one, the name or password is
+ * too long, the list is full or the network could not be stored
+ */
+bool wifiAddNetwork(const String &ssid, const String &pass);
+
+/**
+ * @brief Removes a network added with wifiAddNetwork().
+ *
+ * @return false if it is not stored (the primary one is changed through
+ * the captive portal)
+ */
+bool wifiRemoveNetwork(const String &ssid);
+
+/**
+ * @brief Sets or clears the static IP configuration.
+ *
+ * Takes effect at the next connection.
+ *
+ * @param cfg Static configuration, or nullptr to use DHCP
+ * @return false if the configuration could not be stored
+ */
+bool wifiSetStaticIp(const WifiStaticIp *cfg);
+
+/**
+ * @brief Reads the static IP configuration.
+ *
+ * @return false if none is set (DHCP)
+ */
+bool wifiGetStaticIp(WifiStaticIp &out);
+
+/**
+ * @brief Converts a WifiConnectPath value to its string representation.
+ *
+ * @return "None", "Fast" or "Scan"
+ */
+String wifiConnectPathToString(uint8_t path);
+
+/**
+ * @brief Converts a WifiIpMode value to its string representation.
+ *
+ * @return "Dhcp", "Lease" or "Static"
+ */
+String wifiIpModeToString(uint8_t mode);
+
+/**
+ * @brief Converts a WifiState value to its string representation.
+ *
+ * @return "Idle", "Connecting", "Connected" or "Backoff"
+ */
+String wifiStateToString(uint8_t state);
@@ -4,13 +4,13 @@
  *
  * This file handles:
  *  - Boot process and WiFi credential loading
- *  - WiFi connection and fallback captive portal
+ *  - Non-blocking WiFi connection and captive portal policy
  *  - JSON configuration loading
- *  - Initialization of REST API endpoints
+ *  - Initialization of REST API endpoints once the link is up
  *  - Registration of a configuration-change callback
  *
- * The application becomes fully operational only after the bootstrap
- * sequence completes, preventing premature hardware updates.
+ * Local features (outputs, cron, one-shot jobs) run as soon as the
+ * bootstrap sequence completes, whether or not WiFi is connected.
  *
  * @author Enzo Tasca
  * @date 2025
@@ -20,12 +20,20 @@
 #include <ArduinoJson.h>
 
 #include "ApiManager.h"
+#include "AtScheduler.h"
 #include "Auth.h"
 #include "BinaryStorage.h"
+#include "Clock.h"
 #include "CronScheduler.h"
 #include "Debug.h"
 #include "DeviceController.h"
+#include "Discovery.h"
 #include "EepromConfig.h"
+#include "HttpQueue.h"
+#include "KvStore.h"
+#include "LinkMonitor.h"
+#include "PowerManager.h"
+#include "Solar.h"
 #include "WebPortal.h"
 #include "WifiManager.h"
 
@@ -40,68 +48,119 @@ JsonDocument config;
  * and can now notify hardware on config updates */
 bool systemBootstrapped = false;
 
+/* The REST API shares port 80 with the portal: started on the first link */
+static bool apiStarted = false;
+
+/**
+ * Earliest boot hook of the ESP8266 core, run before C++ static
+ * initialization and long before setup(): outputs are driven back to their
+ * state before a soft reboot from RTC memory, without waiting for the
+ * filesystem.
+ */
+extern "C" void preinit() { deviceEarlyRestore(); }
+
 void setup() {
   Serial.begin(115200);
   Serial.println();
   Serial.println("=== Device booting ===");
 
-  /* Initialize EEPROM (WiFi credentials & Flags) */
+  /* Initialize EEPROM (WiFi credentials) */
   eepromInit();
-  debugInit();
   checkHardwareReset();
 
   /* Initialize persistent storage FS */
   storageInit();
 
+  /* Configuration key-value store */
+  kvInit();
+
+  /* Serial debug flag (kept in the key-value store) */
+  debugInit();
+
   /* Initialize WiFi internals */
   wifiInit();
 
+  /* Link health: RSSI history, disconnect reasons, reconnect times */
+  linkMonitorInit();
+
+  /* Power profile: WiFi sleep mode and loop idle delay */
+  powerInit();
+
   /* Initialize Device Controller */
   deviceInit();
 
-  /* Load WiFi credentials from EEPROM */
+  /* Load WiFi credentials from EEPROM; wifiLoop() brings the link up */
   if (loadWifiCredentials(WIFI_SSID, WIFI_PASS)) {
     debugPrintln(F("[BOOT]"), "Stored WiFi credentials found: " + WIFI_SSID);
-
-    if (!wifiConnect(WIFI_SSID, WIFI_PASS)) {
-      debugPrintln(F("[BOOT]"),
-                   F("WiFi connection failed → starting captive portal."));
-      portalStart();
-    } else {
-      debugPrintln(F("[BOOT]"), F("WiFi connected successfully!"));
-    }
+    wifiStart(WIFI_SSID, WIFI_PASS);
   } else {
     debugPrintln(F("[BOOT]"),
                  F("No WiFi credentials → starting captive portal."));
     portalStart();
   }
 
+  /* Time sync (SNTP, non-blocking) */
+  clockInit();
+
   /* Auth config for ApiMenager */
   authInit();
 
-  /* Rest API initialization */
-  apiInit();
+  /* Solar location for sunrise/sunset jobs */
+  solarInit();
 
   /* Cron init */
   cronSchedulerInit();
 
+  /* One-shot jobs at absolute times */
+  atSchedulerInit();
+
   systemBootstrapped = true;
   debugPrintln(F("[BOOT]"), F("=== System bootstrap complete ==="));
 }
 
 void loop() {
-  /* If WiFi is not configured yet, run the captive portal */
+  /* WiFi state machine (connect, backoff, reconnect) */
+  wifiLoop();
+  linkMonitorLoop();
+
   if (portalActive()) {
+    /* Configuration portal (no credentials, or WIFI_PORTAL_AFTER_FAILURES) */
     portalLoop();
-    return;
+  } else if (wifiPortalWanted()) {
+    debugPrintln(F("[WiFi]"),
+                 F("WiFi connection failed → starting captive portal."));
+    wifiStop();
+    portalStart();
+  } else {
+    /* Rest API, started with the first link */
+    if (!apiStarted && wifiIsConnected())
+      apiStarted = apiInit();
+
+    if (apiStarted)
+      apiLoop();
   }
 
-  /* REST API handler */
-  apiLoop();
+  /* mDNS advertisement (started with the first link) and state version */
+  discoveryLoop();
 
   /* GPIO - read digital and analog inputs */
   deviceLoop();
 
+  /* Clock - apply SNTP sync samples */
+  clockLoop();
+
+  /* One-shot jobs (millisecond deadlines) */
+  atSchedulerLoop();
+
   /* Cron scheduler */
   cronSchedulerLoop();
+
+  /* Outbound HTTP requests (cron HttpRequest actions) */
+  httpQueueLoop();
+
+  /* Deferred flash writes (cron last-exec mirror) */
+  storageLoop();
+
+  /* Idle delay of the power profile (lets the radio sleep) */
+  powerLoop();
 }
@@ -0,0 +1,188 @@
+/*
+ * Cost of the GPIO journal against the full-table rewrite it replaced:
+ * - per pin change: bytes written and file operations (opens, renames,
+ *   removes), with the compaction every GPIO_JOURNAL_MAX_RECORDS records
+ *   amortized in
+ * - per boot: deviceInit() (snapshot + journal replay) by journal length,
+ *   against reading the full table
+ *
+ * Byte and operation counts come from the filesystem stub and carry over
+ * to the device; times are host CPU time and only compare the two.
+ */
+#include <BinaryStorage.h>
+#include <DeviceController.h>
+#include <Host.h>
+
+#include <chrono>
+
+/* Table file of the full-rewrite scheme */
+static const char *const TABLE_PATH = "/gpio_table.bin";
+
+static const uint8_t PINS[] = {4, 5, 12, 13, 14};
+static const int CHANGES = 1024;
+static const int BOOT_REPEAT = 200;
+
+static GpioConfig expected[MAX_GPIO_PINS];
+
+struct Cost {
+  double bytes;
+  double ops; // opens + renames + removes
+  double us;
+};
+
+static double elapsedUs(std::chrono::steady_clock::time_point since) {
+  return std::chrono::duration<double, std::micro>(
+             std::chrono::steady_clock::now() - since)
+      .count();
+}
+
+static Cost costOf(const HostFsStats &s, double us, int count) {
+  Cost c;
+  c.bytes = (double)s.bytesWritten / count;
+  c.ops = (double)(s.opens + s.renames + s.removes) / count;
+  c.us = us / count;
+  return c;
+}
+
+static GpioConfig change(int i) {
+  GpioConfig cfg;
+  cfg.pin = PINS[i % sizeof(PINS)];
+  cfg.mode = PinMode::Output;
+  cfg.state = (i / sizeof(PINS)) & 1;
+  return cfg;
+}
+
+/**
+ * @brief Fresh filesystem with the outputs configured and compacted.
+ */
+static void setUp() {
+  hostFsReset();
+  hostPowerCycle();
+  HOST_CHECK(storageInit());
+  HOST_CHECK(deviceInit());
+
+  GpioConfig table[MAX_GPIO_PINS];
+  memcpy(table, deviceGetAll(), sizeof(table));
+  for (uint8_t pin : PINS)
+    table[pin] = {pin, PinMode::Output, LOW};
+  HOST_CHECK(deviceReplaceAll(table, MAX_GPIO_PINS));
+  memcpy(expected, deviceGetAll(), sizeof(expected));
+}
+
+static Cost journalChangeCost() {
+  setUp();
+  hostFsClearStats();
+
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < CHANGES; i++) {
+    GpioConfig cfg = change(i);
+    HOST_CHECK(deviceSet(cfg));
+  }
+  return costOf(hostFsStats(), elapsedUs(start), CHANGES);
+}
+
+static Cost rewriteChangeCost() {
+  setUp();
+  GpioConfig table[MAX_GPIO_PINS];
+  memcpy(table, deviceGetAll(), sizeof(table));
+  hostFsClearStats();
+
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < CHANGES; i++) {
+    GpioConfig cfg = change(i);
+    table[cfg.pin] = cfg;
+    HOST_CHECK(storageWrite(TABLE_PATH, (uint8_t *)table, sizeof(table)));
+  }
+  return costOf(hostFsStats(), elapsedUs(start), CHANGES);
+}
+
+/**
+ * @brief Bytes written by the change that triggers a compaction.
+ */
+static uint32_t compactionBytes() {
+  setUp();
+
+  for (int i = 0; i < CHANGES; i++) {
+    hostFsClearStats();
+    GpioConfig cfg = change(i);
+    HOST_CHECK(deviceSet(cfg));
+    if (hostFsStats().renames > 0)
+      return hostFsStats().bytesWritten;
+  }
+  return 0;
+}
+
+/**
+ * @brief Cold boot (RTC memory lost) with `records` journal records.
+ */
+static Cost bootCost(int records, uint32_t &bytesRead) {
+  setUp();
+  for (int i = 0; i < records; i++) {
+    GpioConfig cfg = change(i);
+    HOST_CHECK(deviceSet(cfg));
+    expected[cfg.pin] = cfg;
+  }
+
+  hostFsClearStats();
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < BOOT_REPEAT; i++) {
+    hostPowerCycle();
+    HOST_CHECK(deviceInit());
+  }
+  double us = elapsedUs(start);
+  bytesRead = hostFsStats().bytesRead / BOOT_REPEAT;
+
+  // Replay must rebuild the state from before the reboot
+  HOST_CHECK(memcmp(deviceGetAll(), expected, sizeof(expected)) == 0);
+  // ... without rewriting anything
+  HOST_CHECK(hostFsStats().bytesWritten == 0);
+
+  return costOf(hostFsStats(), us, BOOT_REPEAT);
+}
+
+static Cost tableReadCost(uint32_t &bytesRead) {
+  GpioConfig table[MAX_GPIO_PINS];
+  HOST_CHECK(storageWrite(TABLE_PATH, (uint8_t *)table, sizeof(table)));
+  hostFsClearStats();
+
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < BOOT_REPEAT; i++)
+    HOST_CHECK(storageRead(TABLE_PATH, (uint8_t *)table, sizeof(table)));
+  double us = elapsedUs(start);
+  bytesRead = hostFsStats().bytesRead / BOOT_REPEAT;
+
+  return costOf(hostFsStats(), us, BOOT_REPEAT);
+}
+
+int main() {
+  Cost journal = journalChangeCost();
+  Cost rewrite = rewriteChangeCost();
+  uint32_t compaction = compactionBytes();
+
+  printf("Per pin change (%d changes, compaction every %d records)\n",
+         CHANGES, GPIO_JOURNAL_MAX_RECORDS);
+  printf("  %-22s %10s %10s %10s\n", "", "bytes", "file ops", "host us");
+  printf("  %-22s %10.1f %10.2f %10.2f\n", "journal + compaction",
+         journal.bytes, journal.ops, journal.us);
+  printf("  %-22s %10.1f %10.2f %10.2f\n", "full-table rewrite",
+         rewrite.bytes, rewrite.ops, rewrite.us);
+  printf("  one compaction writes %u bytes\n", compaction);
+
+  printf("Cold boot: deviceInit() by journal length\n");
+  printf("  %-22s %10s %10s %10s\n", "records", "bytes read", "file ops",
+         "host us");
+  for (int records : {0, 16, 32, 64, 96, GPIO_JOURNAL_MAX_RECORDS - 1}) {
+    uint32_t bytesRead;
+    Cost c = bootCost(records, bytesRead);
+    printf("  %-22d %10u %10.2f %10.2f\n", records, bytesRead, c.ops, c.us);
+  }
+
+  uint32_t bytesRead;
+  Cost table = tableReadCost(bytesRead);
+  printf("  %-22s %10u %10.2f %10.2f\n", "full-table read", bytesRead,
+         table.ops, table.us);
+
+  HOST_CHECK(journal.bytes < rewrite.bytes);
+  printf("journal: OK\n");
+  return 0;
+}
@@ -0,0 +1,174 @@
+#pragma once
+
+/*
+ * Host implementation of the part of the Arduino/ESP8266 core API used by
+ * the modules under test. Time is simulated (see Host.h) so tests are
+ * deterministic; pins only record their last value.
+ */
+
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <time.h>
+
+#include <string>
+
+typedef uint8_t byte;
+
+class __FlashStringHelper;
+#define F(x) (reinterpret_cast<const __FlashStringHelper *>(x))
+#define PSTR(x) (x)
+#define PROGMEM
+#define IRAM_ATTR
+#define ICACHE_RAM_ATTR
+
+#define HIGH 1
+#define LOW 0
+#define INPUT 0
+#define OUTPUT 1
+#define INPUT_PULLUP 2
+#define A0 17
+
+class String {
+public:
+  String(const char *s = "") : s(s ? s : "") {}
+  String(const __FlashStringHelper *s)
+      : String(reinterpret_cast<const char *>(s)) {}
+  String(const std::string &s) : s(s) {}
+  explicit String(char c) : s(1, c) {}
+  String(int v) : s(std::to_string(v)) {}
+  String(unsigned int v) : s(std::to_string(v)) {}
+  String(long v) : s(std::to_string(v)) {}
+  String(unsigned long v) : s(std::to_string(v)) {}
+  String(long long v) : s(std::to_string(v)) {}
+  String(unsigned long long v) : s(std::to_string(v)) {}
+  String(double v, unsigned char decimals = 2) {
+    char buf[32];
+    snprintf(buf, sizeof(buf), "%.*f", decimals, v);
+    s = buf;
+  }
+
+  const char *c_str() const { return s.c_str(); }
+  const char *begin() const { return s.c_str(); }
+  const char *end() const { return s.c_str() + s.size(); }
+  unsigned int length() const { return s.size(); }
+  bool isEmpty() const { return s.empty(); }
+  bool reserve(unsigned int size) {
+    s.reserve(size);
+    return true;
+  }
+  long toInt() const { return atol(s.c_str()); }
+  bool startsWith(const String &prefix) const {
+    return s.compare(0, prefix.s.size(), prefix.s) == 0;
+  }
+  int indexOf(char c, unsigned int from = 0) const {
+    size_t pos = s.find(c, from);
+    return pos == std::string::npos ? -1 : (int)pos;
+  }
+  String substring(unsigned int from) const {
+    return from < s.size() ? String(s.substr(from)) : String();
+  }
+  String substring(unsigned int from, unsigned int to) const {
+    return from < to && from < s.size() ? String(s.substr(from, to - from))
+                                        : String();
+  }
+  void trim() {
+    size_t b = s.find_first_not_of(" \t\r\n");
+    size_t e = s.find_last_not_of(" \t\r\n");
+    s = b == std::string::npos ? "" : s.substr(b, e - b + 1);
+  }
+  void toLowerCase() {
+    for (char &c : s)
+      c = tolower((unsigned char)c);
+  }
+  void toUpperCase() {
+    for (char &c : s)
+      c = toupper((unsigned char)c);
+  }
+
+  char operator[](unsigned int i) const { return i < s.size() ? s[i] : 0; }
+  String &operator+=(const String &o) {
+    s += o.s;
+    return *this;
+  }
+  bool operator==(const String &o) const { return s == o.s; }
+  bool operator!=(const String &o) const { return s != o.s; }
+
+  friend String operator+(const String &a, const String &b) {
+    return String(a.s + b.s);
+  }
+
+private:
+  std::string s;
+};
+
+class Print {
+public:
+  virtual ~Print() {}
+  virtual size_t write(uint8_t c) = 0;
+  virtual size_t write(const uint8_t *buf, size_t len) {
+    size_t n = 0;
+    while (n < len && write(buf[n]))
+      n++;
+    return n;
+  }
+};
+
+class Stream : public Print {
+public:
+  virtual int available() = 0;
+  virtual int read() = 0;
+  virtual void setTimeout(unsigned long) {}
+};
+
+size_t strlcpy(char *dst, const char *src, size_t size);
+
+inline bool isDigit(char c) { return c >= '0' && c <= '9'; }
+
+/* Simulated time, advanced by the tests (see Host.h) */
+unsigned long millis();
+unsigned long micros();
+uint64_t micros64();
+void delay(unsigned long ms);
+void yield();
+
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t value);
+int digitalRead(uint8_t pin);
+void analogWrite(uint8_t pin, int value);
+int analogRead(uint8_t pin);
+
+/**
+ * @brief GPIO set (GPOS) and clear (GPOC) registers: writing a mask
+ * drives the pins of its set bits.
+ */
+struct HostGpioRegister {
+  uint8_t value;
+  HostGpioRegister &operator=(uint32_t mask);
+};
+
+extern HostGpioRegister GPOS;
+extern HostGpioRegister GPOC;
+
+inline void noInterrupts() {}
+inline void interrupts() {}
+
+void configTime(const char *tz, const char *server1,
+                const char *server2 = nullptr, const char *server3 = nullptr);
+
+/**
+ * @brief ESP object: RTC user memory survives a simulated reset (not a
+ * power cut), restart() aborts the test.
+ */
+class EspClass {
+public:
+  bool rtcUserMemoryRead(uint32_t offset, uint32_t *data, size_t size);
+  bool rtcUserMemoryWrite(uint32_t offset, uint32_t *data, size_t size);
+  void restart();
+};
+
+extern EspClass ESP;
@@ -0,0 +1,3 @@
+#pragma once
+
+// DeviceController.h includes it; no JSON is used by the host tests
@@ -0,0 +1,18 @@
+#pragma once
+
+#include <Arduino.h>
+#include <IPAddress.h>
+#include <WiFiClient.h>
+
+typedef enum { WL_IDLE_STATUS = 0, WL_CONNECTED = 3 } wl_status_t;
+
+/**
+ * @brief Station state and name resolution (see Host.h for the hooks).
+ */
+class ESP8266WiFiClass {
+public:
+  wl_status_t status();
+  int hostByName(const char *host, IPAddress &ip, uint32_t timeoutMs);
+};
+
+extern ESP8266WiFiClass WiFi;
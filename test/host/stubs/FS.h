@@ -0,0 +1,67 @@
+#pragma once
+
+/*
+ * In-memory filesystem with the fs::FS / fs::File interface of the
+ * ESP8266 core. Every byte written is stored immediately, so a power cut
+ * (see hostCutPowerAfter()) can stop a write at any byte; rename and
+ * remove are atomic, as in LittleFS.
+ */
+
+#include <Arduino.h>
+
+#include <memory>
+
+namespace fs {
+
+enum SeekMode { SeekSet = 0, SeekCur = 1, SeekEnd = 2 };
+
+struct FileHandle;
+
+class File : public Stream {
+public:
+  File() {}
+  explicit File(std::shared_ptr<FileHandle> handle) : handle(handle) {}
+
+  operator bool() const;
+  size_t write(uint8_t c) override;
+  size_t write(const uint8_t *buf, size_t len) override;
+  int available() override;
+  int read() override;
+  size_t read(uint8_t *buf, size_t len);
+  bool seek(uint32_t pos, SeekMode mode = SeekSet);
+  size_t position() const;
+  size_t size() const;
+  void close();
+
+private:
+  std::shared_ptr<FileHandle> handle;
+};
+
+struct FSInfo {
+  size_t totalBytes;
+  size_t usedBytes;
+  size_t blockSize;
+  size_t pageSize;
+  size_t maxOpenFiles;
+  size_t maxPathLength;
+};
+
+class FS {
+public:
+  bool begin();
+  File open(const char *path, const char *mode);
+  bool exists(const char *path);
+  bool remove(const char *path);
+  bool rename(const char *from, const char *to);
+  bool info(FSInfo &info);
+};
+
+} // namespace fs
+
+using fs::File;
+using fs::FS;
+using fs::FSInfo;
+using fs::SeekCur;
+using fs::SeekEnd;
+using fs::SeekMode;
+using fs::SeekSet;
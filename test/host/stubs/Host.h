@@ -0,0 +1,98 @@
+#pragma once
+
+/*
+ * Test hooks of the host stubs (not part of the Arduino API).
+ */
+
+#include <Arduino.h>
+#include <IPAddress.h>
+
+/**
+ * @brief Filesystem counters since the last hostFsReset().
+ */
+struct HostFsStats {
+  uint32_t opens;
+  uint32_t writeCalls;
+  uint32_t bytesWritten;
+  uint32_t bytesRead;
+  uint32_t renames;
+  uint32_t removes;
+  uint32_t steps; // durable changes: file creations, bytes, renames, removes
+};
+
+/**
+ * @brief Advances the simulated monotonic clock (millis(), micros()).
+ */
+void hostAdvanceUs(uint64_t us);
+void hostAdvanceMs(uint64_t ms);
+
+/**
+ * @brief Simulates an SNTP sync: sets the wall clock returned by
+ * gettimeofday() and invokes the settimeofday_cb() callback.
+ */
+void hostSntpSync(int64_t epoch);
+
+/**
+ * @brief Erases every file, clears the counters and restores power.
+ */
+void hostFsReset();
+
+/**
+ * @brief Filesystem counters.
+ */
+const HostFsStats &hostFsStats();
+
+/**
+ * @brief Clears the filesystem counters (files are kept).
+ */
+void hostFsClearStats();
+
+/**
+ * @brief Cuts the power after `steps` more durable changes (see
+ * HostFsStats::steps). From then on every filesystem call fails.
+ */
+void hostCutPowerAfter(uint32_t steps);
+
+/**
+ * @brief Whether a scheduled power cut has happened.
+ */
+bool hostPowerIsCut();
+
+/**
+ * @brief Restores power: open files are lost, the file contents stay.
+ * RTC memory is cleared, as after a real power loss.
+ */
+void hostPowerCycle();
+
+/**
+ * @brief WiFi station state reported by WiFi.status() (connected by
+ * default).
+ */
+void hostWifiSetConnected(bool connected);
+
+/**
+ * @brief Adds a name to the table answered by WiFi.hostByName(); other
+ * names fail to resolve.
+ */
+void hostDnsAdd(const char *host, IPAddress ip);
+
+/**
+ * @brief Number of WiFi.hostByName() calls.
+ */
+uint32_t hostDnsLookups();
+
+/**
+ * @brief Last value written to a pin (digitalWrite/analogWrite).
+ */
+int hostPinValue(uint8_t pin);
+
+/**
+ * @brief Aborts the test with the failed condition and its location.
+ */
+#define HOST_CHECK(cond)                                                       \
+  do {                                                                         \
+    if (!(cond)) {                                                             \
+      fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+      exit(1);                                                                 \
+    }                                                                          \
+  } while (0)
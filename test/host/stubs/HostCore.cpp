@@ -0,0 +1,360 @@
+#include "Host.h"
+#include <LittleFS.h>
+#include <coredecls.h>
+
+#include <map>
+#include <vector>
+
+EspClass ESP;
+fs::FS LittleFS;
+
+/* Simulated clocks */
+static uint64_t monoUs = 0;
+static int64_t wallUs = 0;
+static std::function<void(bool)> timeSetCb;
+
+static int pinValues[A0 + 1];
+static uint32_t rtcMemory[128];
+
+void hostAdvanceUs(uint64_t us) { monoUs += us; }
+
+void hostAdvanceMs(uint64_t ms) { monoUs += ms * 1000; }
+
+void hostSntpSync(int64_t epoch) {
+  wallUs = epoch * 1000000;
+  if (timeSetCb)
+    timeSetCb(true);
+}
+
+unsigned long millis() { return (unsigned long)(monoUs / 1000); }
+
+unsigned long micros() { return (unsigned long)monoUs; }
+
+uint64_t micros64() { return monoUs; }
+
+void delay(unsigned long ms) { hostAdvanceMs(ms); }
+
+void yield() {}
+
+/* Linked with -Wl,--wrap=gettimeofday: the wall clock of the modules */
+extern "C" int __wrap_gettimeofday(struct timeval *tv, void *) {
+  tv->tv_sec = (time_t)(wallUs / 1000000);
+  tv->tv_usec = (suseconds_t)(wallUs % 1000000);
+  return 0;
+}
+
+void settimeofday_cb(std::function<void(bool)> cb) { timeSetCb = cb; }
+
+void configTime(const char *tz, const char *, const char *, const char *) {
+  setenv("TZ", tz, 1);
+  tzset();
+}
+
+uint32_t crc32(const void *data, size_t length, uint32_t crc) {
+  const uint8_t *p = (const uint8_t *)data;
+  while (length--) {
+    uint8_t c = *p++;
+    for (uint32_t i = 0x80; i > 0; i >>= 1) {
+      bool bit = crc & 0x80000000;
+      if (c & i)
+        bit = !bit;
+      crc <<= 1;
+      if (bit)
+        crc ^= 0x04c11db7;
+    }
+  }
+  return crc;
+}
+
+size_t strlcpy(char *dst, const char *src, size_t size) {
+  size_t len = strlen(src);
+  if (size > 0) {
+    size_t n = len < size - 1 ? len : size - 1;
+    memcpy(dst, src, n);
+    dst[n] = '\0';
+  }
+  return len;
+}
+
+void pinMode(uint8_t, uint8_t) {}
+
+void digitalWrite(uint8_t pin, uint8_t value) {
+  if (pin <= A0)
+    pinValues[pin] = value;
+}
+
+int digitalRead(uint8_t pin) { return pin <= A0 ? pinValues[pin] : 0; }
+
+void analogWrite(uint8_t pin, int value) {
+  if (pin <= A0)
+    pinValues[pin] = value;
+}
+
+int analogRead(uint8_t pin) { return pin <= A0 ? pinValues[pin] : 0; }
+
+int hostPinValue(uint8_t pin) { return digitalRead(pin); }
+
+HostGpioRegister GPOS = {HIGH};
+HostGpioRegister GPOC = {LOW};
+
+HostGpioRegister &HostGpioRegister::operator=(uint32_t mask) {
+  for (uint8_t pin = 0; pin < 16; pin++) {
+    if (mask & (1UL << pin))
+      pinValues[pin] = value;
+  }
+  return *this;
+}
+
+bool EspClass::rtcUserMemoryRead(uint32_t offset, uint32_t *data,
+                                 size_t size) {
+  if (offset * 4 + size > sizeof(rtcMemory))
+    return false;
+  memcpy(data, (uint8_t *)rtcMemory + offset * 4, size);
+  return true;
+}
+
+bool EspClass::rtcUserMemoryWrite(uint32_t offset, uint32_t *data,
+                                  size_t size) {
+  if (offset * 4 + size > sizeof(rtcMemory))
+    return false;
+  memcpy((uint8_t *)rtcMemory + offset * 4, data, size);
+  return true;
+}
+
+void EspClass::restart() {
+  fprintf(stderr, "ESP.restart() called\n");
+  exit(1);
+}
+
+/*
+ * Filesystem: path -> content. Open files share the content through a
+ * handle; a file removed or renamed while open keeps its handle valid
+ * but detached, as LittleFS does.
+ */
+namespace fs {
+
+struct FileHandle {
+  std::string path;
+  size_t pos;
+  bool canRead;
+  bool canWrite;
+  bool append;
+  bool open;
+  uint32_t boot; // handles do not survive a power cycle
+};
+
+} // namespace fs
+
+static std::map<std::string, std::vector<uint8_t>> files;
+static HostFsStats fsStats;
+
+/* Power-cut injection */
+static bool powerCut = false;
+static int64_t stepBudget = -1; // -1 = no cut scheduled
+static uint32_t bootCount = 0;
+
+void hostFsReset() {
+  files.clear();
+  fsStats = HostFsStats();
+  powerCut = false;
+  stepBudget = -1;
+  bootCount++;
+}
+
+const HostFsStats &hostFsStats() { return fsStats; }
+
+void hostFsClearStats() { fsStats = HostFsStats(); }
+
+void hostCutPowerAfter(uint32_t steps) { stepBudget = steps; }
+
+bool hostPowerIsCut() { return powerCut; }
+
+void hostPowerCycle() {
+  powerCut = false;
+  stepBudget = -1;
+  bootCount++;
+  memset(rtcMemory, 0, sizeof(rtcMemory));
+}
+
+/**
+ * @brief Accounts one durable change; false once the power is cut.
+ */
+static bool step() {
+  if (powerCut)
+    return false;
+  if (stepBudget == 0) {
+    powerCut = true;
+    return false;
+  }
+  if (stepBudget > 0)
+    stepBudget--;
+  fsStats.steps++;
+  return true;
+}
+
+/* Content of an open file, nullptr once it is gone */
+static std::vector<uint8_t> *content(const fs::FileHandle &h) {
+  if (!h.open || h.boot != bootCount || powerCut)
+    return nullptr;
+  auto it = files.find(h.path);
+  return it == files.end() ? nullptr : &it->second;
+}
+
+namespace fs {
+
+bool FS::begin() { return true; }
+
+File FS::open(const char *path, const char *mode) {
+  std::string m(mode);
+  bool exists = files.count(path) > 0;
+
+  if (powerCut || ((m == "r" || m == "r+") && !exists))
+    return File();
+
+  // Creating or truncating a file is a change of its own
+  if ((m[0] == 'w' || !exists) && !step())
+    return File();
+
+  fsStats.opens++;
+
+  auto h = std::make_shared<FileHandle>();
+  h->path = path;
+  h->pos = 0;
+  h->canRead = m[0] == 'r' || m.size() > 1;
+  h->canWrite = m != "r";
+  h->append = m[0] == 'a';
+  h->open = true;
+  h->boot = bootCount;
+
+  if (m[0] == 'w')
+    files[path].clear();
+  else if (!exists)
+    files[path];
+
+  if (h->append)
+    h->pos = files[path].size();
+  return File(h);
+}
+
+bool FS::exists(const char *path) {
+  return !powerCut && files.count(path) > 0;
+}
+
+bool FS::remove(const char *path) {
+  if (powerCut || files.count(path) == 0 || !step())
+    return false;
+  files.erase(path);
+  fsStats.removes++;
+  return true;
+}
+
+bool FS::rename(const char *from, const char *to) {
+  auto it = files.find(from);
+  if (powerCut || it == files.end() || !step())
+    return false;
+
+  std::vector<uint8_t> data;
+  data.swap(it->second);
+  files.erase(it);
+  files[to].swap(data);
+  fsStats.renames++;
+  return true;
+}
+
+bool FS::info(FSInfo &info) {
+  size_t used = 0;
+  for (const auto &f : files)
+    used += f.second.size();
+
+  info = FSInfo();
+  info.totalBytes = 1024000;
+  info.usedBytes = used;
+  info.blockSize = 8192;
+  info.pageSize = 256;
+  info.maxOpenFiles = 5;
+  info.maxPathLength = 32;
+  return true;
+}
+
+File::operator bool() const { return handle && handle->open; }
+
+size_t File::write(uint8_t c) { return write(&c, 1); }
+
+size_t File::write(const uint8_t *buf, size_t len) {
+  std::vector<uint8_t> *data = handle ? content(*handle) : nullptr;
+  if (!data || !handle->canWrite)
+    return 0;
+
+  if (handle->append)
+    handle->pos = data->size();
+
+  // Byte by byte, so a power cut can stop the write anywhere
+  size_t n = 0;
+  while (n < len && step()) {
+    if (handle->pos == data->size())
+      data->push_back(buf[n]);
+    else
+      (*data)[handle->pos] = buf[n];
+    handle->pos++;
+    n++;
+  }
+
+  fsStats.writeCalls++;
+  fsStats.bytesWritten += n;
+  return n;
+}
+
+int File::available() {
+  std::vector<uint8_t> *data = handle ? content(*handle) : nullptr;
+  return data && handle->pos < data->size() ? data->size() - handle->pos : 0;
+}
+
+int File::read() {
+  uint8_t c;
+  return read(&c, 1) == 1 ? c : -1;
+}
+
+size_t File::read(uint8_t *buf, size_t len) {
+  std::vector<uint8_t> *data = handle ? content(*handle) : nullptr;
+  if (!data || !handle->canRead || handle->pos >= data->size())
+    return 0;
+
+  size_t n = data->size() - handle->pos;
+  if (n > len)
+    n = len;
+  memcpy(buf, data->data() + handle->pos, n);
+  handle->pos += n;
+
+  fsStats.bytesRead += n;
+  return n;
+}
+
+bool File::seek(uint32_t pos, SeekMode mode) {
+  std::vector<uint8_t> *data = handle ? content(*handle) : nullptr;
+  if (!data)
+    return false;
+
+  int64_t base = mode == SeekSet   ? 0
+                 : mode == SeekCur ? (int64_t)handle->pos
+                                   : (int64_t)data->size();
+  int64_t target = base + (int64_t)pos;
+  if (target < 0 || target > (int64_t)data->size())
+    return false;
+
+  handle->pos = (size_t)target;
+  return true;
+}
+
+size_t File::position() const { return handle ? handle->pos : 0; }
+
+size_t File::size() const {
+  std::vector<uint8_t> *data = handle ? content(*handle) : nullptr;
+  return data ? data->size() : 0;
+}
+
+void File::close() {
+  if (handle)
+    handle->open = false;
+}
+
+} // namespace fs
@@ -0,0 +1,73 @@
+#include <Debug.h>
+
+#include <stdarg.h>
+
+/*
+ * Debug output of the modules under test, printed to stderr when the
+ * HOST_DEBUG environment variable is set.
+ */
+static bool enabled = getenv("HOST_DEBUG") != nullptr;
+
+void debugInit() {}
+
+bool debugEnabled() { return enabled; }
+
+void debugSetEnabled(bool value) { enabled = value; }
+
+bool debugSaveEnabled(bool value) {
+  enabled = value;
+  return true;
+}
+
+void debugPrint(const String &message) {
+  if (enabled)
+    fputs(message.c_str(), stderr);
+}
+
+void debugPrint(const __FlashStringHelper *message) {
+  debugPrint(String(message));
+}
+
+void debugPrintln(const String &tag, const String &message) {
+  if (enabled)
+    fprintf(stderr, "%s %s\n", tag.c_str(), message.c_str());
+}
+
+void debugPrintln(const __FlashStringHelper *tag,
+                  const __FlashStringHelper *message) {
+  debugPrintln(String(tag), String(message));
+}
+
+void debugPrintln(const __FlashStringHelper *tag, const String &message) {
+  debugPrintln(String(tag), message);
+}
+
+void debugPrintln(const String &message) {
+  if (enabled)
+    fprintf(stderr, "%s\n", message.c_str());
+}
+
+void debugPrintln(const __FlashStringHelper *message) {
+  debugPrintln(String(message));
+}
+
+void debugPrintf(const char *format, ...) {
+  if (!enabled)
+    return;
+  va_list args;
+  va_start(args, format);
+  vfprintf(stderr, format, args);
+  va_end(args);
+  fputc('\n', stderr);
+}
+
+void debugPrintf(const __FlashStringHelper *tag, const char *format, ...) {
+  if (!enabled)
+    return;
+  fprintf(stderr, "%s ", reinterpret_cast<const char *>(tag));
+  va_list args;
+  va_start(args, format);
+  vfprintf(stderr, format, args);
+  va_end(args);
+  fputc('\n', stderr);
+}
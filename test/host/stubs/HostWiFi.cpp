@@ -0,0 +1,112 @@
+#include "Host.h"
+#include <ESP8266WiFi.h>
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <map>
+
+ESP8266WiFiClass WiFi;
+
+static bool wifiConnected = true;
+static std::map<std::string, IPAddress> dnsTable;
+static uint32_t dnsLookups = 0;
+
+void hostWifiSetConnected(bool connected) { wifiConnected = connected; }
+
+void hostDnsAdd(const char *host, IPAddress ip) { dnsTable[host] = ip; }
+
+uint32_t hostDnsLookups() { return dnsLookups; }
+
+wl_status_t ESP8266WiFiClass::status() {
+  return wifiConnected ? WL_CONNECTED : WL_IDLE_STATUS;
+}
+
+int ESP8266WiFiClass::hostByName(const char *host, IPAddress &ip,
+                                 uint32_t) {
+  dnsLookups++;
+  auto it = dnsTable.find(host);
+  if (it == dnsTable.end())
+    return 0;
+  ip = it->second;
+  return 1;
+}
+
+int WiFiClient::connect(IPAddress ip, uint16_t port) {
+  stop();
+
+  fd = socket(AF_INET, SOCK_STREAM, 0);
+  if (fd < 0)
+    return 0;
+
+  sockaddr_in addr = {};
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(port);
+  addr.sin_addr.s_addr = (uint32_t)ip;
+
+  if (::connect(fd, (sockaddr *)&addr, sizeof(addr)) != 0) {
+    stop();
+    return 0;
+  }
+
+  fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+  return 1;
+}
+
+size_t WiFiClient::write(uint8_t c) { return write(&c, 1); }
+
+size_t WiFiClient::write(const uint8_t *buf, size_t len) {
+  if (fd < 0)
+    return 0;
+  ssize_t n = send(fd, buf, len, MSG_NOSIGNAL);
+  return n > 0 ? (size_t)n : 0;
+}
+
+int WiFiClient::available() {
+  int n = 0;
+  if (fd < 0 || ioctl(fd, FIONREAD, &n) != 0)
+    return 0;
+  return n;
+}
+
+int WiFiClient::read() {
+  uint8_t c;
+  return read(&c, 1) == 1 ? c : -1;
+}
+
+int WiFiClient::read(uint8_t *buf, size_t len) {
+  if (fd < 0)
+    return -1;
+  ssize_t n = recv(fd, buf, len, MSG_DONTWAIT);
+  return n > 0 ? (int)n : -1;
+}
+
+uint8_t WiFiClient::connected() {
+  if (fd < 0)
+    return 0;
+  if (available() > 0)
+    return 1;
+
+  // Zero bytes from a peek: the peer closed the connection
+  uint8_t c;
+  ssize_t n = recv(fd, &c, 1, MSG_PEEK | MSG_DONTWAIT);
+  return n > 0 || (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK));
+}
+
+void WiFiClient::stop() {
+  if (fd >= 0)
+    close(fd);
+  fd = -1;
+}
+
+void WiFiClient::setNoDelay(bool noDelay) {
+  int on = noDelay;
+  if (fd >= 0)
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+}
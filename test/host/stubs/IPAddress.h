@@ -0,0 +1,18 @@
+#pragma once
+
+#include <stdint.h>
+
+/**
+ * @brief IPv4 address, stored in network byte order as in the core.
+ */
+class IPAddress {
+public:
+  IPAddress() : addr(0) {}
+  IPAddress(uint8_t a, uint8_t b, uint8_t c, uint8_t d)
+      : addr(a | (b << 8) | (c << 16) | ((uint32_t)d << 24)) {}
+
+  operator uint32_t() const { return addr; }
+
+private:
+  uint32_t addr;
+};
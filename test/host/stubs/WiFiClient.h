@@ -0,0 +1,28 @@
+#pragma once
+
+#include <Arduino.h>
+#include <IPAddress.h>
+
+/**
+ * @brief TCP client on a POSIX socket (non-blocking once connected).
+ */
+class WiFiClient : public Stream {
+public:
+  WiFiClient() {}
+  WiFiClient(const WiFiClient &) = delete;
+  WiFiClient &operator=(const WiFiClient &) = delete;
+  ~WiFiClient() { stop(); }
+
+  int connect(IPAddress ip, uint16_t port);
+  size_t write(uint8_t c) override;
+  size_t write(const uint8_t *buf, size_t len) override;
+  int available() override;
+  int read() override;
+  int read(uint8_t *buf, size_t len);
+  uint8_t connected();
+  void stop();
+  void setNoDelay(bool noDelay);
+
+private:
+  int fd = -1;
+};
@@ -0,0 +1,15 @@
+#pragma once
+
+#include <Arduino.h>
+
+#include <functional>
+
+/**
+ * @brief Same algorithm as the core's crc32() (MSB first, no final XOR).
+ */
+uint32_t crc32(const void *data, size_t length, uint32_t crc = 0xffffffff);
+
+/**
+ * @brief Registers the callback invoked by hostSntpSync() (see Host.h).
+ */
+void settimeofday_cb(std::function<void(bool)> cb);
@@ -0,0 +1,500 @@
+/*
+ * cronCompile() / cronNextFire() against a brute-force reference that
+ * walks every minute and matches the expression text field by field.
+ *
+ * Reference semantics (those of the scheduler):
+ * - day of month and day of week must both match
+ * - a local time skipped by a DST change does not fire that day
+ * - a local time repeated by a DST change fires once, at its first
+ *   occurrence after the search start
+ *
+ * Also drives cronSchedulerLoop() for the solar retry back-off and the
+ * deferred flush of the last-exec mirror.
+ */
+#include <BinaryStorage.h>
+#include <Clock.h>
+#include <CronLog.h>
+#include <CronScheduler.h>
+#include <DeviceController.h>
+#include <Host.h>
+#include <HttpQueue.h>
+#include <KvStore.h>
+#include <Solar.h>
+
+#include <chrono>
+#include <sstream>
+#include <vector>
+
+/* Modules the scheduler links against; next-fire searches never call them */
+void cronLogInit() {}
+void cronLogLoop() {}
+void cronLogFlush() {}
+void cronLogRecord(uint16_t, uint8_t, uint32_t, uint32_t, uint8_t) {}
+void cronLogResetJob(uint16_t) {}
+bool devicePulse(uint8_t, int, uint32_t) { return false; }
+GpioConfig *deviceGet(uint8_t) { return nullptr; }
+bool deviceSet(GpioConfig &) { return false; }
+uint32_t httpEnqueue(HttpQueueMethod, const char *, const char *, int16_t) {
+  return 0;
+}
+
+/* Solar module: a location without any event (polar night) by default */
+static bool solarLocation = false;
+static uint32_t solarVersion = 0;
+static uint32_t solarLookups = 0;
+static uint32_t solarEvent = 0; // fixed event time, 0 = none
+
+bool solarHasLocation() { return solarLocation; }
+uint32_t solarLocationVersion() { return solarVersion; }
+bool solarEventTime(int32_t, uint8_t, uint32_t &epoch) {
+  solarLookups++;
+  epoch = solarEvent;
+  return solarLocation && solarEvent != 0;
+}
+
+/* Clock anchor: the offset table covers 2025 and 2026, other years go
+ * through the localtime_r()/mktime() fallback */
+static const int64_t ANCHOR_EPOCH = 1748736000; // 2025-06-01 00:00 UTC
+
+/* Reference searches give up after this long (covers leap day to leap
+ * day); chains stop once they walked CHAIN_MINUTES */
+static const int64_t REF_HORIZON_SEC = (4 * 366 + 1) * 86400LL;
+static const uint64_t CHAIN_MINUTES = 366 * 1440;
+
+static const char *const TIMEZONES[] = {
+    "UTC0",
+    CLOCK_DEFAULT_TZ,
+    "EST5EDT,M3.2.0,M11.1.0",
+    "<+1030>-10:30<+11>-11,M10.1.0,M4.1.0", // 30 minute DST shift
+};
+
+static const char *const EXPRESSIONS[] = {
+    "* * * * *",    "*/15 * * * *",   "0 * * * *",     "30 2 * * *",
+    "0 9 * * 1-5",  "0 0 29 2 *",     "0 12 31 * *",   "59 23 31 12 *",
+    "30 8 1-7 * 1", "0 0 13 * 5",     "0 0 1 */3 *",   "5,35 1-3 * 3,10 0",
+    "0 22 * * 7",   "45 23 28-31 * *",
+};
+
+/* Search starts: month ends, leap days and DST days, plus random ones */
+static const int64_t FIXED_STARTS[] = {
+    1709164770, // 2024-02-28 23:59:30
+    1735689599, // 2024-12-31 23:59:59
+    1743249600, // 2025-03-29 12:00
+    1761393600, // 2025-10-25 12:00
+    1774656000, // 2026-03-28 00:00
+    1824897600, // 2027-10-30 12:00
+    1835352000, // 2028-02-28 12:00
+};
+static const int RANDOM_STARTS = 12;
+static const int FIRES_PER_START = 6;
+
+struct Counters {
+  uint32_t searches = 0;
+  double cronSec = 0;
+  uint64_t refMinutes = 0;
+  double refSec = 0;
+};
+
+static Counters counters;
+
+/* One list item of a field: values a..b every `step` */
+struct RefItem {
+  int a, b, step;
+};
+
+typedef std::vector<RefItem> RefField;
+
+/**
+ * @brief Parses one field ("*", "a", "a-b", lists and "/step") without
+ * the scheduler's parser.
+ */
+static RefField refParseField(const std::string &text, int lo, int hi) {
+  std::stringstream items(text);
+  std::string item;
+  RefField field;
+
+  while (std::getline(items, item, ',')) {
+    RefItem r;
+    r.step = 1;
+    size_t slash = item.find('/');
+    if (slash != std::string::npos) {
+      r.step = atoi(item.c_str() + slash + 1);
+      item = item.substr(0, slash);
+    }
+
+    size_t dash = item.find('-');
+    if (item == "*") {
+      r.a = lo;
+      r.b = hi;
+    } else if (dash != std::string::npos) {
+      r.a = atoi(item.c_str());
+      r.b = atoi(item.c_str() + dash + 1);
+    } else {
+      r.a = atoi(item.c_str());
+      r.b = slash != std::string::npos ? hi : r.a;
+    }
+    field.push_back(r);
+  }
+  return field;
+}
+
+static bool refFieldMatches(const RefField &field, int value) {
+  for (const RefItem &r : field) {
+    if (value >= r.a && value <= r.b && (value - r.a) % r.step == 0)
+      return true;
+  }
+  return false;
+}
+
+/* Fields in cron order: minute, hour, day of month, month, day of week */
+struct RefSchedule {
+  RefField fields[5];
+  mutable int64_t day = -1; // local day of dayMatches
+  mutable bool dayMatches = false;
+};
+
+static RefSchedule refParse(const char *expr) {
+  static const int lo[5] = {0, 0, 1, 1, 0};
+  static const int hi[5] = {59, 23, 31, 12, 7};
+
+  std::stringstream in(expr);
+  std::string text;
+  RefSchedule sched;
+  for (int i = 0; i < 5 && in >> text; i++)
+    sched.fields[i] = refParseField(text, lo[i], hi[i]);
+  return sched;
+}
+
+static bool refMatches(const RefSchedule &s, int64_t local) {
+  const RefField *f = s.fields;
+  int64_t day = local / 86400;
+
+  // The date fields only change at local midnight
+  if (day != s.day) {
+    time_t t = (time_t)(day * 86400);
+    struct tm lt;
+    gmtime_r(&t, &lt);
+
+    bool dow = refFieldMatches(f[4], lt.tm_wday) ||
+               (lt.tm_wday == 0 && refFieldMatches(f[4], 7));
+    s.day = day;
+    s.dayMatches = refFieldMatches(f[2], lt.tm_mday) &&
+                   refFieldMatches(f[3], lt.tm_mon + 1) && dow;
+  }
+
+  int secOfDay = (int)(local - day * 86400);
+  return s.dayMatches && refFieldMatches(f[1], secOfDay / 3600) &&
+         refFieldMatches(f[0], secOfDay / 60 % 60);
+}
+
+/**
+ * @brief UTC offset of the C library at `utc` (cached per quarter hour,
+ * the granularity of every zone's transitions).
+ */
+static int32_t refOffset(int64_t utc) {
+  static int64_t cachedSlot = -1;
+  static int32_t cachedOffset = 0;
+
+  int64_t slot = utc / 900;
+  if (slot != cachedSlot) {
+    time_t t = (time_t)(slot * 900);
+    struct tm lt;
+    localtime_r(&t, &lt);
+    cachedSlot = slot;
+    cachedOffset = (int32_t)lt.tm_gmtoff;
+  }
+  return cachedOffset;
+}
+
+/**
+ * @brief Next fire time by walking every UTC minute after `after`.
+ */
+static uint32_t refNextFire(const RefSchedule &f, uint32_t after) {
+  int64_t t = ((int64_t)after / 60 + 1) * 60;
+  int64_t limit = t + REF_HORIZON_SEC;
+  int64_t maxLocal = t - 60 + refOffset(t - 60);
+
+  for (; t < limit; t += 60) {
+    counters.refMinutes++;
+    int64_t local = t + refOffset(t);
+
+    // Repeated local minute: already passed in this search
+    if (local <= maxLocal)
+      continue;
+
+    maxLocal = local;
+    if (refMatches(f, local))
+      return (uint32_t)t;
+  }
+  return 0;
+}
+
+static std::string formatUtc(uint32_t epoch) {
+  time_t t = (time_t)epoch;
+  struct tm utc;
+  gmtime_r(&t, &utc);
+  char buf[32];
+  strftime(buf, sizeof(buf), "%Y-%m-%d %H:%M UTC", &utc);
+  return buf;
+}
+
+static void setTimezone(const char *tz) {
+  HOST_CHECK(clockSetTimezone(tz));
+  cronReschedule();
+}
+
+/**
+ * @brief Follows a chain of fire times from `start` and compares every
+ * one with the reference.
+ */
+static bool checkChain(const char *tz, const char *expr, uint32_t start) {
+  CronSchedule sched;
+  HOST_CHECK(cronCompile(expr, sched));
+  RefSchedule ref = refParse(expr);
+
+  uint64_t walked = counters.refMinutes;
+  uint32_t t = start;
+  for (int i = 0; i < FIRES_PER_START; i++) {
+    if (counters.refMinutes - walked > CHAIN_MINUTES)
+      break;
+
+    auto t0 = std::chrono::steady_clock::now();
+    uint32_t got = cronNextFire(sched, t);
+    auto t1 = std::chrono::steady_clock::now();
+    uint32_t want = refNextFire(ref, t);
+    auto t2 = std::chrono::steady_clock::now();
+
+    counters.searches++;
+    counters.cronSec += std::chrono::duration<double>(t1 - t0).count();
+    counters.refSec += std::chrono::duration<double>(t2 - t1).count();
+
+    // Beyond the reference horizon only "none found" can be compared
+    if (want == 0 && (got == 0 || got - t > REF_HORIZON_SEC))
+      return true;
+
+    if (got != want) {
+      fprintf(stderr, "FAIL tz=%s \"%s\" after %s: got %s, want %s\n", tz,
+              expr, formatUtc(t).c_str(),
+              got ? formatUtc(got).c_str() : "none",
+              want ? formatUtc(want).c_str() : "none");
+      return false;
+    }
+    t = got;
+  }
+  return true;
+}
+
+/**
+ * @brief A few cases spelled out, so a failure is easy to read.
+ */
+static void checkExplicitCases() {
+  CronSchedule sched;
+  setTimezone(CLOCK_DEFAULT_TZ);
+
+  // 02:30 does not exist on 2025-03-30: next run is on the 31st
+  HOST_CHECK(cronCompile("30 2 * * *", sched));
+  HOST_CHECK(cronNextFire(sched, 1743249600) == 1743381000);
+  // 02:30 occurs twice on 2025-10-26: fires once, at 02:30 CEST
+  HOST_CHECK(cronNextFire(sched, 1761393600) == 1761438600);
+  HOST_CHECK(cronNextFire(sched, 1761438600) == 1761528600);
+
+  setTimezone("UTC0");
+
+  // Leap day: 2024-02-29, then 2028-02-29
+  HOST_CHECK(cronCompile("0 0 29 2 *", sched));
+  HOST_CHECK(cronNextFire(sched, 1704067200) == 1709164800);
+  HOST_CHECK(cronNextFire(sched, 1709164800) == 1835395200);
+
+  // Day of month and day of week both apply: Friday 2024-09-13
+  HOST_CHECK(cronCompile("0 0 13 * 5", sched));
+  HOST_CHECK(cronNextFire(sched, 1704067200) == 1726185600);
+
+  // No date matches
+  HOST_CHECK(cronCompile("0 0 30 2 *", sched));
+  HOST_CHECK(cronNextFire(sched, 1704067200) == 0);
+  HOST_CHECK(refNextFire(refParse("0 0 30 2 *"), 1704067200) == 0);
+  HOST_CHECK(!cronCanFire(sched));
+  HOST_CHECK(cronCompile("0 0 31 4 *", sched));
+  HOST_CHECK(cronNextFire(sched, 1704067200) == 0);
+  HOST_CHECK(refNextFire(refParse("0 0 31 4 *"), 1704067200) == 0);
+  HOST_CHECK(!cronCanFire(sched));
+  HOST_CHECK(cronCompile("0 0 29 2 *", sched) && cronCanFire(sched));
+  HOST_CHECK(cronCompile("0 0 13 2 5", sched) && cronCanFire(sched));
+
+  HOST_CHECK(!cronCompile("0 0 32 * *", sched));
+  HOST_CHECK(!cronCompile("60 * * * *", sched));
+  HOST_CHECK(!cronCompile("* * * *", sched));
+}
+
+/**
+ * @brief Runs the scheduler for `seconds` ticks of one second.
+ */
+static void runTicks(uint32_t seconds) {
+  for (uint32_t i = 0; i < seconds; i++) {
+    hostAdvanceMs(1000);
+    cronSchedulerLoop();
+  }
+}
+
+/**
+ * @brief A solar job without an event to fire on is not searched on
+ * every tick: not at all without a location, then once per hour, and
+ * again as soon as the location changes.
+ */
+static void checkSolarBackoff() {
+  setTimezone("UTC0");
+  cronSchedulerInit(); // false on a fresh filesystem (no table yet)
+
+  CronJob job{};
+  job.active = true;
+  strlcpy(job.cron, "@sunset", sizeof(job.cron));
+  job.action = SetPinState;
+  HOST_CHECK(setCronJob(0, job));
+
+  runTicks(60);
+  HOST_CHECK(solarLookups == 0);
+
+  // Location set, but the sun never sets: one full walk
+  solarLocation = true;
+  solarVersion++;
+  runTicks(1);
+  uint32_t walk = solarLookups;
+  HOST_CHECK(walk > 300);
+
+  runTicks(3590);
+  HOST_CHECK(solarLookups == walk);
+  runTicks(20);
+  HOST_CHECK(solarLookups == 2 * walk);
+
+  // New location with events: searched on the next tick
+  solarEvent = clockNow() + 7200;
+  solarVersion++;
+  runTicks(1);
+  HOST_CHECK(solarLookups > 2 * walk && solarLookups < 2 * walk + 5);
+
+  uint32_t found = solarLookups;
+  runTicks(600);
+  HOST_CHECK(solarLookups == found);
+
+  HOST_CHECK(cronClearAll());
+}
+
+/*
+ * The last-exec mirror is flushed through storageDefer(): a burst of job
+ * updates costs one write, each minute of executions one more, and
+ * storageFlush() (the reboot path) writes what is still pending.
+ */
+static uint32_t mirrorEntry(uint16_t index) {
+  uint32_t epoch = 0;
+  storageReadAt("/cron_exec.bin", index * sizeof(uint32_t),
+                (uint8_t *)&epoch, sizeof(epoch));
+  return epoch;
+}
+
+static void runTicksWithStorage(uint32_t seconds) {
+  for (uint32_t i = 0; i < seconds; i++) {
+    hostAdvanceMs(1000);
+    cronSchedulerLoop();
+    storageLoop();
+  }
+}
+
+static void checkExecDefer() {
+  setTimezone("UTC0");
+  HOST_CHECK(cronClearAll());
+  storageFlush();
+  StorageDeferStats before = storageDeferStats();
+
+  // Four updates in a burst: one pending flush
+  CronJob job{};
+  job.active = true;
+  strlcpy(job.cron, "* * * * *", sizeof(job.cron));
+  job.action = SetPinState;
+  for (uint16_t i = 0; i < 4; i++)
+    HOST_CHECK(setCronJob(i, job));
+
+  HOST_CHECK(storagePending() == 1);
+  HOST_CHECK(mirrorEntry(0) == 0);
+  HOST_CHECK(storageDeferStats().avoided - before.avoided == 3);
+
+  // Quiet period over: one write with every entry
+  hostAdvanceMs(STORAGE_FLUSH_QUIET_MS);
+  storageLoop();
+  HOST_CHECK(storagePending() == 0);
+  HOST_CHECK(storageDeferStats().written - before.written == 1);
+  HOST_CHECK(mirrorEntry(3) != 0);
+
+  // Ten minutes of executions: the four jobs share one write a minute
+  uint32_t start = clockNow();
+  runTicksWithStorage(600);
+  uint32_t minutes = clockNow() / 60 - start / 60;
+  const StorageDeferStats &after = storageDeferStats();
+  HOST_CHECK(after.requested - before.requested == 4 + minutes);
+  HOST_CHECK(after.written - before.written ==
+             1 + minutes - storagePending());
+  HOST_CHECK(after.avoided - before.avoided == 3);
+  HOST_CHECK(after.failed == before.failed);
+  storageFlush();
+
+  CronJob stored;
+  HOST_CHECK(cronGet(2, stored));
+  HOST_CHECK(mirrorEntry(2) == stored.lastExecEpoch);
+
+  // Reboot path: a pending change is written at once
+  job.active = false;
+  HOST_CHECK(setCronJob(3, job));
+  HOST_CHECK(storagePending() == 1);
+  HOST_CHECK(storageFlush());
+  HOST_CHECK(storagePending() == 0);
+
+  printf("exec mirror: %u flushes requested, %u written, %u avoided\n",
+         after.requested - before.requested, after.written - before.written,
+         after.avoided - before.avoided);
+
+  HOST_CHECK(cronClearAll());
+}
+
+int main() {
+  hostFsReset();
+  HOST_CHECK(storageInit());
+  HOST_CHECK(kvInit());
+  HOST_CHECK(clockInit());
+
+  hostSntpSync(ANCHOR_EPOCH);
+  clockLoop();
+  HOST_CHECK(clockNow() == ANCHOR_EPOCH);
+
+  checkExplicitCases();
+  checkSolarBackoff();
+  checkExecDefer();
+
+  std::vector<int64_t> starts(std::begin(FIXED_STARTS),
+                              std::end(FIXED_STARTS));
+  uint32_t seed = 12345;
+  for (int i = 0; i < RANDOM_STARTS; i++) {
+    // 2024-01-01 .. 2028-12-31
+    seed = seed * 1103515245 + 12345;
+    starts.push_back(1704067200 + (int64_t)(seed % 157766400));
+  }
+
+  bool ok = true;
+  for (const char *tz : TIMEZONES) {
+    setTimezone(tz);
+    for (const char *expr : EXPRESSIONS) {
+      for (int64_t start : starts)
+        ok = checkChain(tz, expr, (uint32_t)start) && ok;
+    }
+  }
+
+  printf("cron: %u next-fire searches, %.2f us each (%.0f/s)\n",
+         counters.searches, counters.cronSec * 1e6 / counters.searches,
+         counters.searches / counters.cronSec);
+  printf("reference: %llu minutes walked, %.0f minutes/s\n",
+         (unsigned long long)counters.refMinutes,
+         counters.refMinutes / counters.refSec);
+
+  if (!ok)
+    return 1;
+  printf("cron: OK\n");
+  return 0;
+}
@@ -0,0 +1,270 @@
+/*
+ * HttpQueue against a loopback HTTP server: httpQueueLoop() is driven
+ * over real sockets (see stubs/HostWiFi.cpp) while the simulated clock
+ * advances, covering a full queue, keep-alive reuse, chunked and
+ * length-less responses, the read timeout, connect and DNS failures, the
+ * resolved-address cache and the retry after a stale keep-alive.
+ *
+ * Names resolve through the stub table (hostDnsAdd()), so each
+ * WiFi.hostByName() call is counted.
+ */
+#include <HttpQueue.h>
+#include <Host.h>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <mutex>
+#include <thread>
+
+static const char *const HOST = "stub.test";
+static const char *const GONE_HOST = "gone.test";
+static const size_t LEN_BODY = 300; // more than one read chunk
+
+static uint16_t serverPort = 0;
+static uint16_t closedPort = 0;
+static std::atomic<int> connections(0);
+static std::mutex postMutex;
+static std::string lastPost;
+
+static void sendAll(int fd, const std::string &data) {
+  send(fd, data.data(), data.size(), MSG_NOSIGNAL);
+}
+
+/**
+ * @brief Serves one connection until the client closes it (or /nolen).
+ */
+static void serve(int fd) {
+  std::string in;
+  char buf[512];
+  int served = 0;
+
+  for (;;) {
+    size_t end = in.find("\r\n\r\n");
+    if (end == std::string::npos) {
+      ssize_t n = recv(fd, buf, sizeof(buf), 0);
+      if (n <= 0)
+        break;
+      in.append(buf, n);
+      continue;
+    }
+
+    std::string head = in.substr(0, end);
+    size_t bodyLen = 0;
+    size_t cl = head.find("Content-Length: ");
+    if (cl != std::string::npos)
+      bodyLen = atoi(head.c_str() + cl + 16);
+
+    while (in.size() < end + 4 + bodyLen) {
+      ssize_t n = recv(fd, buf, sizeof(buf), 0);
+      if (n <= 0)
+        goto done;
+      in.append(buf, n);
+    }
+
+    std::string path = head.substr(head.find(' ') + 1);
+    path = path.substr(0, path.find(' '));
+    std::string body = in.substr(end + 4, bodyLen);
+    in.erase(0, end + 4 + bodyLen);
+
+    if (path == "/stale" && served > 0) {
+      // Idle keep-alive closed by the server as the request arrives
+      break;
+    } else if (path == "/len" || path == "/stale") {
+      sendAll(fd, "HTTP/1.1 200 OK\r\nContent-Length: " +
+                      std::to_string(LEN_BODY) + "\r\n\r\n" +
+                      std::string(LEN_BODY, 'x'));
+    } else if (path == "/chunked") {
+      // Connection stays open: the client has to drop it
+      sendAll(fd, "HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\n\r\n"
+                  "2\r\nok\r\n0\r\n\r\n");
+    } else if (path == "/nolen") {
+      sendAll(fd, "HTTP/1.1 200 OK\r\nContent-Type: text/plain\r\n\r\nok");
+      break;
+    } else if (path == "/slow") {
+      // Never answers
+    } else if (path == "/post") {
+      {
+        std::lock_guard<std::mutex> lock(postMutex);
+        lastPost = body;
+      }
+      sendAll(fd, "HTTP/1.1 201 Created\r\nContent-Length: 0\r\n\r\n");
+    } else {
+      sendAll(fd, "HTTP/1.1 404 Not Found\r\nContent-Length: 9\r\n\r\n"
+                  "not found");
+    }
+    served++;
+  }
+
+done:
+  close(fd);
+}
+
+/**
+ * @brief Listens on an ephemeral loopback port; returns the port.
+ */
+static uint16_t listenLoopback(int &fd) {
+  fd = socket(AF_INET, SOCK_STREAM, 0);
+  HOST_CHECK(fd >= 0);
+
+  sockaddr_in addr = {};
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  socklen_t len = sizeof(addr);
+  HOST_CHECK(bind(fd, (sockaddr *)&addr, len) == 0);
+  HOST_CHECK(listen(fd, 8) == 0);
+  HOST_CHECK(getsockname(fd, (sockaddr *)&addr, &len) == 0);
+  return ntohs(addr.sin_port);
+}
+
+static void startServer() {
+  int fd;
+  serverPort = listenLoopback(fd);
+
+  std::thread([fd]() {
+    for (;;) {
+      int c = accept(fd, nullptr, nullptr);
+      if (c < 0)
+        continue;
+      connections++;
+      std::thread(serve, c).detach();
+    }
+  }).detach();
+
+  // A port nobody listens on (connect is refused)
+  int closedFd;
+  closedPort = listenLoopback(closedFd);
+  close(closedFd);
+}
+
+static std::string url(const char *host, uint16_t port, const char *path) {
+  return "http://" + std::string(host) + ":" + std::to_string(port) + path;
+}
+
+/**
+ * @brief Runs the loop until the queue is empty, advancing the simulated
+ * clock by `stepMs` per call.
+ */
+static void drain(uint32_t stepMs = 1) {
+  for (int i = 0; httpQueuePending() > 0; i++) {
+    HOST_CHECK(i < 100000);
+    httpQueueLoop();
+    usleep(200);
+    hostAdvanceMs(stepMs);
+  }
+}
+
+/**
+ * @brief Sends one request and returns its result.
+ */
+static HttpResult run(const std::string &target, uint32_t stepMs = 1,
+                      HttpQueueMethod method = HttpGet,
+                      const char *body = nullptr) {
+  uint32_t id = httpEnqueue(method, target.c_str(), body);
+  HOST_CHECK(id > 0);
+  drain(stepMs);
+
+  const HttpResult *r = httpQueueResult(0);
+  HOST_CHECK(r && r->id == id);
+  return *r;
+}
+
+int main() {
+  startServer();
+  hostDnsAdd(HOST, IPAddress(127, 0, 0, 1));
+  hostDnsAdd(GONE_HOST, IPAddress(127, 0, 0, 1));
+  const HttpQueueStats &stats = httpQueueStats();
+
+  // Full queue: the fifth request is dropped
+  std::string len = url(HOST, serverPort, "/len");
+  for (int i = 0; i < HTTP_QUEUE_SIZE; i++)
+    HOST_CHECK(httpEnqueue(HttpGet, len.c_str(), nullptr) > 0);
+  HOST_CHECK(httpEnqueue(HttpGet, len.c_str(), nullptr) == 0);
+  HOST_CHECK(stats.dropped == 1);
+
+  // ... the others share one connection and one lookup
+  drain();
+  for (int i = 0; i < HTTP_QUEUE_SIZE; i++) {
+    const HttpResult *r = httpQueueResult(i);
+    HOST_CHECK(r->error == HttpOk && r->status == 200);
+    HOST_CHECK(r->reused == (i < HTTP_QUEUE_SIZE - 1));
+  }
+  HOST_CHECK(connections == 1);
+  HOST_CHECK(stats.reused == HTTP_QUEUE_SIZE - 1);
+  HOST_CHECK(stats.dnsLookups == 1 && hostDnsLookups() == 1);
+
+  // Chunked: completes at the headers and drops the connection
+  HttpResult r = run(url(HOST, serverPort, "/chunked"));
+  HOST_CHECK(r.error == HttpOk && r.status == 200 && r.reused);
+
+  // No length: same, on a new connection to the cached address
+  r = run(url(HOST, serverPort, "/nolen"));
+  HOST_CHECK(r.error == HttpOk && r.status == 200 && !r.reused);
+  HOST_CHECK(connections == 2);
+
+  r = run(url(HOST, serverPort, "/missing"));
+  HOST_CHECK(r.error == HttpOk && r.status == 404 && !r.reused);
+  HOST_CHECK(stats.failed == 1);
+  HOST_CHECK(connections == 3);
+
+  // Kept alive after the 404, the body arrives intact
+  const char *json = "{\"pin\":4,\"state\":1}";
+  r = run(url(HOST, serverPort, "/post"), 1, HttpPost, json);
+  HOST_CHECK(r.error == HttpOk && r.status == 201 && r.reused);
+  {
+    std::lock_guard<std::mutex> lock(postMutex);
+    HOST_CHECK(lastPost == json);
+  }
+  HOST_CHECK(stats.dnsLookups == 1);
+
+  // Kept-alive connection closed under the request: sent again, once
+  run(len);
+  int before = connections;
+  r = run(url(HOST, serverPort, "/stale"));
+  HOST_CHECK(r.error == HttpOk && r.status == 200 && !r.reused);
+  HOST_CHECK(connections == before + 1);
+  HOST_CHECK(stats.retried == 1);
+
+  // No answer: read timeout, measured on the simulated clock
+  r = run(url(HOST, serverPort, "/slow"), 100);
+  HOST_CHECK(r.error == HttpErrTimeout && r.status == 0);
+  HOST_CHECK(r.latencyMs > HTTP_READ_TIMEOUT_MS);
+  HOST_CHECK(stats.failed == 2);
+
+  // Refused connect: the address is dropped and looked up again
+  r = run(url(GONE_HOST, closedPort, "/len"));
+  HOST_CHECK(r.error == HttpErrConnect);
+  HOST_CHECK(stats.dnsLookups == 2);
+  r = run(url(GONE_HOST, closedPort, "/len"));
+  HOST_CHECK(r.error == HttpErrConnect);
+  HOST_CHECK(stats.dnsLookups == 3);
+
+  r = run(url("unknown.test", serverPort, "/len"));
+  HOST_CHECK(r.error == HttpErrDns);
+  HOST_CHECK(stats.dnsLookups == 4);
+
+  // Still cached, until the entry expires
+  r = run(len);
+  HOST_CHECK(r.error == HttpOk && !r.reused);
+  HOST_CHECK(stats.dnsLookups == 4);
+  hostAdvanceMs(HTTP_DNS_TTL_MS);
+  r = run(len);
+  HOST_CHECK(r.error == HttpOk && !r.reused);
+  HOST_CHECK(stats.dnsLookups == 5);
+  HOST_CHECK(hostDnsLookups() == stats.dnsLookups);
+
+  hostWifiSetConnected(false);
+  r = run(len);
+  HOST_CHECK(r.error == HttpErrNoWifi);
+  hostWifiSetConnected(true);
+
+  printf("%u requests, %d connections, %u reused, %u retried, %u DNS "
+         "lookups\n",
+         stats.completed, connections.load(), stats.reused, stats.retried,
+         stats.dnsLookups);
+  printf("http queue: OK\n");
+  return 0;
+}
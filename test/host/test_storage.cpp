@@ -0,0 +1,160 @@
+/*
+ * Power-cut fault injection for storageWrite(). Power fails after every
+ * possible number of durable changes of a write: creating the temporary
+ * file, each byte written to it, and the rename. After the reboot,
+ * storageRead() must return either the previous or the new payload, and
+ * the next write must succeed.
+ *
+ * The simulated flash keeps every byte as soon as it is written, which is
+ * harsher than LittleFS (file data is only committed on close).
+ */
+#include <BinaryStorage.h>
+#include <Host.h>
+#include <LittleFS.h>
+
+#include <vector>
+
+static const char *const PATH = "/state.bin";
+
+typedef std::vector<uint8_t> Payload;
+
+static uint32_t cutsTested = 0;
+
+static Payload makePayload(size_t length, uint8_t seed) {
+  Payload p(length);
+  for (size_t i = 0; i < length; i++)
+    p[i] = (uint8_t)(seed + i * 31);
+  return p;
+}
+
+static bool write(const Payload &p) {
+  return storageWrite(PATH, p.data(), p.size());
+}
+
+/**
+ * @brief Reads the stored payload; empty if nothing valid is stored.
+ */
+static Payload read(size_t length) {
+  Payload p(length);
+  if (!storageRead(PATH, p.data(), length))
+    p.clear();
+  return p;
+}
+
+/**
+ * @brief Changes made by one uninterrupted write of `next` over `setup`.
+ */
+template <typename Setup>
+static uint32_t stepsOfWrite(Setup setup, const Payload &next) {
+  hostFsReset();
+  setup();
+  hostFsClearStats();
+  HOST_CHECK(write(next));
+  return hostFsStats().steps;
+}
+
+/**
+ * @brief Cuts the power at every step of writing `next` over the state
+ * built by `setup`. The read after the reboot must return `before` or
+ * `next` (an empty `before` means "nothing stored").
+ */
+template <typename Setup>
+static void checkCuts(const char *name, Setup setup, const Payload &before,
+                      const Payload &next) {
+  uint32_t total = stepsOfWrite(setup, next);
+
+  for (uint32_t cut = 0; cut < total; cut++) {
+    hostFsReset();
+    setup();
+    hostCutPowerAfter(cut);
+
+    HOST_CHECK(!write(next));
+    HOST_CHECK(hostPowerIsCut());
+    hostPowerCycle();
+
+    Payload got = read(next.size());
+    if (got != before && got != next) {
+      fprintf(stderr, "FAIL %s: cut after %u of %u steps\n", name, cut,
+              total);
+      exit(1);
+    }
+
+    // The leftover temporary file must not get in the way
+    Payload after = makePayload(next.size(), 0x5a);
+    HOST_CHECK(write(after));
+    HOST_CHECK(read(after.size()) == after);
+    cutsTested++;
+  }
+
+  printf("%s: %u bytes, %u cut points\n", name, (unsigned)next.size(),
+         total);
+}
+
+/**
+ * @brief A second interrupted write after an interrupted one: the read
+ * must never go back past what the first reboot returned.
+ */
+static void checkDoubleCuts(size_t length) {
+  Payload oldP = makePayload(length, 1);
+  Payload first = makePayload(length, 2);
+  Payload second = makePayload(length, 3);
+
+  auto setup = [&]() { HOST_CHECK(write(oldP)); };
+  uint32_t total = stepsOfWrite(setup, first);
+
+  for (uint32_t cut1 = 0; cut1 < total; cut1++) {
+    for (uint32_t cut2 = 0; cut2 < total; cut2++) {
+      hostFsReset();
+      setup();
+
+      hostCutPowerAfter(cut1);
+      write(first);
+      hostPowerCycle();
+      Payload seen = read(length);
+      HOST_CHECK(seen == oldP || seen == first);
+
+      hostCutPowerAfter(cut2);
+      write(second);
+      hostPowerCycle();
+      Payload got = read(length);
+      if (got != seen && got != second) {
+        fprintf(stderr, "FAIL double cut after %u then %u steps: %s\n",
+                cut1, cut2, got == oldP ? "rolled back" : "lost");
+        exit(1);
+      }
+      cutsTested++;
+    }
+  }
+
+  printf("double cut: %u bytes, %u x %u cut points\n", (unsigned)length,
+         total, total);
+}
+
+int main() {
+  HOST_CHECK(storageInit());
+
+  for (size_t length : {1, 16, 300}) {
+    Payload oldP = makePayload(length, 1);
+    Payload newP = makePayload(length, 2);
+
+    checkCuts(
+        "replace", [&]() { HOST_CHECK(write(oldP)); }, oldP, newP);
+    checkCuts(
+        "first write", []() {}, Payload(), newP);
+
+    // Unframed file of older firmware
+    checkCuts(
+        "legacy file",
+        [&]() {
+          File f = LittleFS.open(PATH, "w");
+          f.write(oldP.data(), oldP.size());
+          f.close();
+        },
+        oldP, newP);
+  }
+
+  checkDoubleCuts(16);
+
+  printf("storage: OK (%u power cuts)\n", cutsTested);
+  return 0;
+}